@@ -0,0 +1,293 @@
+#include "button.h"
+
+#include "config.h"
+#include "journal.h"
+#include "logger.h"
+#include "power.h"
+#include "presets.h"
+#include "state.h"
+#include "udp.h"
+
+#include <atomic>
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// How long the button must stay stable for an edge to count.
+static const uint32_t DEBOUNCE_MS = 30;
+// How long to wait after a short press for another one.
+static const uint32_t MULTI_PRESS_MS = 350;
+static const uint32_t LONG_PRESS_MS = 1000;
+static const uint32_t HOLD_MS = 10000;
+// How often the timer runs while the button is pressed, to blink and catch the hold.
+static const uint32_t PRESSED_TICK_MS = 10;
+static const uint32_t BLINK_PERIOD_MS = 250;
+
+static const size_t QUEUE_SIZE = 8;
+
+// timer1 counts at 80 MHz / 256, whatever the CPU frequency.
+static uint32_t IRAM_ATTR msToTicks(uint32_t ms)
+{
+    return (ms * 625) / 2;
+}
+
+// Written by the timer only.
+ButtonEvent buttonQueue[QUEUE_SIZE];
+std::atomic<uint8_t> buttonQueueHead{0};
+std::atomic<uint8_t> buttonQueueTail{0};
+
+// Only touched in interrupts, which don't nest.
+bool buttonPressed = false;
+bool holdReported = false;
+uint8_t pressCount = 0;
+uint32_t pressStart = 0;
+uint32_t releaseTime = 0;
+// When the edges the timer is waiting to settle started.
+uint32_t edgeTime = 0;
+bool edgeSettling = false;
+
+volatile StatusLedPattern statusLedPattern = StatusLedPattern_Off;
+
+ButtonHandler buttonHandlers[ButtonGesture_Count] = {};
+
+static void IRAM_ATTR pushEvent(ButtonGesture gesture, uint8_t count, uint32_t duration, uint32_t at)
+{
+    const uint8_t head = buttonQueueHead.load(std::memory_order_relaxed);
+
+    // Drop the event if the loop is that far behind.
+    if (static_cast<uint8_t>(head - buttonQueueTail.load(std::memory_order_acquire)) >= QUEUE_SIZE)
+    {
+        return;
+    }
+
+    ButtonEvent &event = buttonQueue[head % QUEUE_SIZE];
+    event.gesture = gesture;
+    event.count = count;
+    event.duration = duration;
+    event.at = at;
+
+    buttonQueueHead.store(head + 1, std::memory_order_release);
+}
+
+// The status led blinks faster and faster until the hold registers.
+static uint32_t IRAM_ATTR heldBlinkPeriod(uint32_t held)
+{
+    if (held < 2000)
+    {
+        return 500;
+    }
+
+    if (held < 4000)
+    {
+        return 250;
+    }
+
+    if (held < 6000)
+    {
+        return 125;
+    }
+
+    if (held < 8000)
+    {
+        return 67;
+    }
+
+    return 30;
+}
+
+static void IRAM_ATTR onButtonTimer()
+{
+    const uint32_t now = millis();
+    const bool pressed = (digitalRead(BUTTON_PIN) == LOW);
+    const uint32_t edge = edgeSettling ? edgeTime : now;
+    uint32_t next = 0;
+
+    edgeSettling = false;
+
+    if (pressed != buttonPressed)
+    {
+        buttonPressed = pressed;
+
+        if (pressed)
+        {
+            pressStart = now;
+            holdReported = false;
+            pushEvent(ButtonGesture_Down, 0, 0, edge);
+        }
+        else
+        {
+            const uint32_t duration = now - pressStart;
+            pushEvent(ButtonGesture_Up, 0, duration, edge);
+
+            if (holdReported)
+            {
+                // The hold already fired.
+            }
+            else if (duration < LONG_PRESS_MS)
+            {
+                pressCount++;
+                releaseTime = now;
+            }
+            else
+            {
+                pressCount = 0;
+                pushEvent(ButtonGesture_LongPress, 1, duration, now);
+            }
+        }
+    }
+
+    if (buttonPressed)
+    {
+        const uint32_t held = now - pressStart;
+
+        if (!holdReported && (held >= HOLD_MS))
+        {
+            holdReported = true;
+            pressCount = 0;
+            pushEvent(ButtonGesture_Hold, 1, held, now);
+        }
+
+        digitalWrite(EXTERNAL_LED_PIN, (((held / heldBlinkPeriod(held)) % 2) == 0) ? LOW : HIGH);
+        next = PRESSED_TICK_MS;
+    }
+    else
+    {
+        if (pressCount > 0)
+        {
+            const uint32_t elapsed = now - releaseTime;
+
+            if (elapsed >= MULTI_PRESS_MS)
+            {
+                pushEvent(ButtonGesture_Press, pressCount, 0, now);
+                pressCount = 0;
+            }
+            else
+            {
+                next = MULTI_PRESS_MS - elapsed;
+            }
+        }
+
+        switch (statusLedPattern)
+        {
+        case StatusLedPattern_On:
+            digitalWrite(EXTERNAL_LED_PIN, HIGH);
+            break;
+        case StatusLedPattern_Blink:
+            digitalWrite(EXTERNAL_LED_PIN, (((now / BLINK_PERIOD_MS) % 2) == 0) ? LOW : HIGH);
+
+            if ((next == 0) || (next > BLINK_PERIOD_MS))
+            {
+                next = BLINK_PERIOD_MS - (now % BLINK_PERIOD_MS);
+            }
+            break;
+        default:
+            digitalWrite(EXTERNAL_LED_PIN, LOW);
+            break;
+        }
+    }
+
+    // The timer is one-shot: it stays off until an edge or a pattern change, unless needed.
+    if (next > 0)
+    {
+        timer1_write(msToTicks(next));
+    }
+}
+
+static void IRAM_ATTR onButtonEdge()
+{
+    if (!edgeSettling)
+    {
+        edgeSettling = true;
+        edgeTime = millis();
+    }
+
+    // Restarting the timer on every edge makes it fire once the bouncing stopped.
+    timer1_write(msToTicks(DEBOUNCE_MS));
+}
+
+static void onPress(const ButtonEvent &event)
+{
+    if (event.count == 1)
+    {
+        if (!config.button_cycles_presets || !presets.cycle())
+        {
+            submitToGroup(state.cycleUpdate());
+        }
+    }
+    else if (event.count == 2)
+    {
+        if (!presets.cycle())
+        {
+            logger.info("No preset to cycle through.");
+        }
+    }
+}
+
+static void onHold(const ButtonEvent &event)
+{
+    logger.warning("Button held for %ums: clearing configuration and restarting.", event.duration);
+    logger.flush();
+    config.Clear();
+    ESP.restart();
+}
+
+void setButtonHandler(ButtonGesture gesture, ButtonHandler handler)
+{
+    if (gesture < ButtonGesture_Count)
+    {
+        buttonHandlers[gesture] = handler;
+    }
+}
+
+void setStatusLed(StatusLedPattern pattern)
+{
+    statusLedPattern = pattern;
+
+    // Let the timer apply it right away.
+    noInterrupts();
+    timer1_write(msToTicks(1));
+    interrupts();
+}
+
+void setupButton()
+{
+    pinMode(EXTERNAL_LED_PIN, OUTPUT);
+    pinMode(BUTTON_PIN, INPUT);
+
+    setButtonHandler(ButtonGesture_Press, onPress);
+    setButtonHandler(ButtonGesture_Hold, onHold);
+
+    timer1_isr_init();
+    timer1_attachInterrupt(onButtonTimer);
+    timer1_enable(TIM_DIV256, TIM_EDGE, TIM_SINGLE);
+
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), onButtonEdge, CHANGE);
+}
+
+void buttonLoop()
+{
+    uint8_t tail = buttonQueueTail.load(std::memory_order_relaxed);
+    const uint8_t head = buttonQueueHead.load(std::memory_order_acquire);
+
+    while (tail != head)
+    {
+        const ButtonEvent event = buttonQueue[tail % QUEUE_SIZE];
+        buttonQueueTail.store(++tail, std::memory_order_release);
+
+        powerNoteActivityAt(event.at);
+
+#if ENABLE_JOURNAL
+        if ((event.gesture == ButtonGesture_Down) || (event.gesture == ButtonGesture_Up))
+        {
+            journal.recordButton(event.gesture == ButtonGesture_Down);
+        }
+#endif
+
+        const ButtonHandler handler = buttonHandlers[event.gesture];
+
+        if (handler)
+        {
+            handler(event);
+        }
+    }
+}
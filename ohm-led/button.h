@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+// The button and the status led, handled in interrupts.
+//
+// A GPIO interrupt catches the edges, and a one-shot hardware timer (timer1)
+// samples the button once it settled, recognizes the gestures and blinks the
+// status led. Gestures go through a lock-free queue to `buttonLoop()`, which
+// dispatches them to their handlers without ever reading the pin.
+//
+// This takes timer1, which `analogWrite()`, `tone()` and `Servo` would need.
+enum ButtonGesture
+{
+    // The button went down or up, once debounced.
+    ButtonGesture_Down = 0,
+    ButtonGesture_Up,
+    // One or more short presses in a row. `count` tells how many.
+    ButtonGesture_Press,
+    // Released after `LONG_PRESS_MS`, but before the hold registered.
+    ButtonGesture_LongPress,
+    // Still pressed after `HOLD_MS`.
+    ButtonGesture_Hold,
+    ButtonGesture_Count,
+};
+
+struct ButtonEvent
+{
+    ButtonGesture gesture;
+    uint8_t count;
+    // How long the button was pressed, in milliseconds.
+    uint32_t duration;
+    // When it happened, in `millis()`: for `ButtonGesture_Down` and `ButtonGesture_Up`, the first edge.
+    uint32_t at;
+};
+
+typedef void (*ButtonHandler)(const ButtonEvent &event);
+
+// Replace the handler of a gesture, or ignore it with `nullptr`.
+//
+// By default, a press cycles the modes (or the presets, if configured), a
+// double press cycles the presets, and a hold clears the configuration.
+void setButtonHandler(ButtonGesture gesture, ButtonHandler handler);
+
+enum StatusLedPattern
+{
+    StatusLedPattern_Off = 0,
+    StatusLedPattern_On,
+    StatusLedPattern_Blink,
+};
+
+// While the button is pressed, the status led shows how long it was held instead.
+void setStatusLed(StatusLedPattern pattern);
+
+void setupButton();
+void buttonLoop();
@@ -0,0 +1,400 @@
+#include "compositor.h"
+
+#include "gamma.h"
+#include "logger.h"
+
+#include <cstring>
+
+Compositor compositor;
+
+const char *const blendModeNames[BlendMode_Count] = {
+    "add",
+    "alpha",
+    "max",
+};
+
+const char *blendModeToString(BlendMode mode)
+{
+    if (mode < 0 || mode >= BlendMode_Count)
+    {
+        return "alpha";
+    }
+
+    return blendModeNames[mode];
+}
+
+BlendMode blendModeFromString(const String &s)
+{
+    for (int i = 0; i < BlendMode_Count; i++)
+    {
+        if (s == blendModeNames[i])
+        {
+            return static_cast<BlendMode>(i);
+        }
+    }
+
+    return BlendMode_Count;
+}
+
+// The even and odd bytes of a word are processed separately, in 16-bit lanes,
+// so that multiplications and borrows never spill into the neighbouring byte.
+static const uint32_t EVEN_BYTES = 0x00FF00FF;
+static const uint32_t ODD_BYTES = 0xFF00FF00;
+static const uint32_t LOW_BITS = 0x7F7F7F7F;
+static const uint32_t HIGH_BITS = 0x80808080;
+
+static inline uint32_t scaleWord(uint32_t w, uint16_t alpha)
+{
+    const uint32_t even = (((w & EVEN_BYTES) * alpha) >> 8) & EVEN_BYTES;
+    const uint32_t odd = (((w >> 8) & EVEN_BYTES) * alpha) & ODD_BYTES;
+
+    return even | odd;
+}
+
+static inline uint32_t addWord(uint32_t a, uint32_t b)
+{
+    // Add the low 7 bits of each byte, then fix up the top bits and saturate the bytes that overflowed.
+    const uint32_t low = (a & LOW_BITS) + (b & LOW_BITS);
+    const uint32_t sum = low ^ ((a ^ b) & HIGH_BITS);
+    const uint32_t overflow = ((a & b) | ((a | b) & ~sum)) & HIGH_BITS;
+
+    return sum | ((overflow >> 7) * 0xFF);
+}
+
+static inline uint32_t maxLanes(uint32_t a, uint32_t b)
+{
+    // Bit 8 of each lane survives the subtraction only where a >= b.
+    const uint32_t ge = ((((a | 0x01000100) - b) >> 8) & 0x00010001) * 0xFF;
+
+    return (a & ge) | (b & ~ge & EVEN_BYTES);
+}
+
+static inline uint32_t maxWord(uint32_t a, uint32_t b)
+{
+    const uint32_t even = maxLanes(a & EVEN_BYTES, b & EVEN_BYTES);
+    const uint32_t odd = maxLanes((a >> 8) & EVEN_BYTES, (b >> 8) & EVEN_BYTES);
+
+    return even | (odd << 8);
+}
+
+static inline uint32_t alphaWord(uint32_t dst, uint32_t src, uint16_t alpha)
+{
+    const uint16_t inverse = 256 - alpha;
+    const uint32_t even = ((((src & EVEN_BYTES) * alpha) + ((dst & EVEN_BYTES) * inverse)) >> 8) & EVEN_BYTES;
+    const uint32_t odd = ((((src >> 8) & EVEN_BYTES) * alpha) + (((dst >> 8) & EVEN_BYTES) * inverse)) & ODD_BYTES;
+
+    return even | odd;
+}
+
+void blendAdd(uint8_t *dst, const uint8_t *src, size_t len, uint16_t alpha)
+{
+    if (alpha == 0)
+    {
+        return;
+    }
+
+    uint32_t *d = reinterpret_cast<uint32_t *>(dst);
+    const uint32_t *s = reinterpret_cast<const uint32_t *>(src);
+    const size_t words = len / 4;
+
+    if (alpha >= 256)
+    {
+        for (size_t i = 0; i < words; i++)
+        {
+            d[i] = addWord(d[i], s[i]);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < words; i++)
+        {
+            d[i] = addWord(d[i], scaleWord(s[i], alpha));
+        }
+    }
+
+    for (size_t i = words * 4; i < len; i++)
+    {
+        dst[i] = qadd8(dst[i], (src[i] * alpha) >> 8);
+    }
+}
+
+void blendAlpha(uint8_t *dst, const uint8_t *src, size_t len, uint16_t alpha)
+{
+    if (alpha == 0)
+    {
+        return;
+    }
+
+    if (alpha >= 256)
+    {
+        memcpy(dst, src, len);
+        return;
+    }
+
+    uint32_t *d = reinterpret_cast<uint32_t *>(dst);
+    const uint32_t *s = reinterpret_cast<const uint32_t *>(src);
+    const size_t words = len / 4;
+
+    for (size_t i = 0; i < words; i++)
+    {
+        d[i] = alphaWord(d[i], s[i], alpha);
+    }
+
+    for (size_t i = words * 4; i < len; i++)
+    {
+        dst[i] = ((src[i] * alpha) + (dst[i] * (256 - alpha))) >> 8;
+    }
+}
+
+void blendMax(uint8_t *dst, const uint8_t *src, size_t len, uint16_t alpha)
+{
+    if (alpha == 0)
+    {
+        return;
+    }
+
+    uint32_t *d = reinterpret_cast<uint32_t *>(dst);
+    const uint32_t *s = reinterpret_cast<const uint32_t *>(src);
+    const size_t words = len / 4;
+
+    if (alpha >= 256)
+    {
+        for (size_t i = 0; i < words; i++)
+        {
+            d[i] = maxWord(d[i], s[i]);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < words; i++)
+        {
+            d[i] = maxWord(d[i], scaleWord(s[i], alpha));
+        }
+    }
+
+    for (size_t i = words * 4; i < len; i++)
+    {
+        const uint8_t v = (src[i] * alpha) >> 8;
+
+        if (v > dst[i])
+        {
+            dst[i] = v;
+        }
+    }
+}
+
+void blend(BlendMode mode, uint8_t *dst, const uint8_t *src, size_t len, uint16_t alpha)
+{
+    switch (mode)
+    {
+    case BlendMode_Add:
+        blendAdd(dst, src, len, alpha);
+        break;
+    case BlendMode_Max:
+        blendMax(dst, src, len, alpha);
+        break;
+    case BlendMode_Alpha:
+    default:
+        blendAlpha(dst, src, len, alpha);
+        break;
+    }
+}
+
+void blendSolid(BlendMode mode, uint8_t *dst, size_t len, const CRGB &color, uint16_t alpha)
+{
+    if (alpha == 0)
+    {
+        return;
+    }
+
+    // Four pixels span exactly three words: repeat them along the buffer.
+    const CRGB pixels[4] = {color, color, color, color};
+    uint32_t pattern[3];
+    memcpy(pattern, pixels, sizeof(pattern));
+
+    uint8_t channels[3] = {color.r, color.g, color.b};
+
+    if ((mode != BlendMode_Alpha) && (alpha < 256))
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            pattern[i] = scaleWord(pattern[i], alpha);
+            channels[i] = (channels[i] * alpha) >> 8;
+        }
+    }
+
+    uint32_t *d = reinterpret_cast<uint32_t *>(dst);
+    const size_t words = len / 4;
+
+    switch (mode)
+    {
+    case BlendMode_Add:
+        for (size_t i = 0, k = 0; i < words; i++, k = (k == 2) ? 0 : k + 1)
+        {
+            d[i] = addWord(d[i], pattern[k]);
+        }
+
+        for (size_t i = words * 4; i < len; i++)
+        {
+            dst[i] = qadd8(dst[i], channels[i % 3]);
+        }
+        break;
+    case BlendMode_Max:
+        for (size_t i = 0, k = 0; i < words; i++, k = (k == 2) ? 0 : k + 1)
+        {
+            d[i] = maxWord(d[i], pattern[k]);
+        }
+
+        for (size_t i = words * 4; i < len; i++)
+        {
+            dst[i] = max(dst[i], channels[i % 3]);
+        }
+        break;
+    case BlendMode_Alpha:
+    default:
+        if (alpha >= 256)
+        {
+            fill_solid(reinterpret_cast<CRGB *>(dst), len / sizeof(CRGB), color);
+            break;
+        }
+
+        for (size_t i = 0, k = 0; i < words; i++, k = (k == 2) ? 0 : k + 1)
+        {
+            d[i] = alphaWord(d[i], pattern[k], alpha);
+        }
+
+        for (size_t i = words * 4; i < len; i++)
+        {
+            dst[i] = ((channels[i % 3] * alpha) + (dst[i] * (256 - alpha))) >> 8;
+        }
+        break;
+    }
+}
+
+uint16_t Compositor::fadeOut(uint32_t now, uint32_t start, uint32_t duration)
+{
+    const uint32_t elapsed = now - start;
+
+    if (elapsed >= duration)
+    {
+        return 0;
+    }
+
+    return 256 - static_cast<uint16_t>((static_cast<uint64_t>(elapsed) << 8) / duration);
+}
+
+void Compositor::startTransition(uint32_t duration)
+{
+    if (duration == 0)
+    {
+        transitionActive = false;
+        return;
+    }
+
+    // Start from whatever is currently displayed, even if that is the middle of another transition.
+    memcpy(transitionLayer, outputLayer, sizeof(transitionLayer));
+    transitionStart = millis();
+    transitionDuration = duration;
+    transitionActive = true;
+}
+
+void Compositor::notify(const CRGB &color, BlendMode mode, uint32_t duration)
+{
+    if (duration == 0)
+    {
+        overlayActive = false;
+        return;
+    }
+
+    overlayColor = color;
+    overlayMode = mode;
+    overlayStart = millis();
+    overlayDuration = duration;
+    overlayActive = true;
+}
+
+void Compositor::compose(const CRGB *base, uint16_t count, uint16_t baseScale, const CRGB *previous, uint16_t progress)
+{
+    const uint32_t begin = micros();
+    const uint32_t now = millis();
+    const size_t len = count * sizeof(CRGB);
+    uint8_t *out = reinterpret_cast<uint8_t *>(outputLayer);
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(base);
+
+    if (previous && (progress < 256))
+    {
+        memcpy(out, previous, len);
+        blendAlpha(out, src, len, progress);
+        src = out;
+    }
+
+    if (gammaCorrection)
+    {
+        gammaStage.convert(out, src, len, baseScale);
+    }
+    else
+    {
+        if (src != out)
+        {
+            memcpy(out, src, len);
+        }
+
+        if (baseScale != 65535)
+        {
+            const uint16_t scale = (baseScale >> 8) + 1;
+
+            for (size_t i = 0; i < len; i++)
+            {
+                out[i] = (out[i] * scale) >> 8;
+            }
+        }
+    }
+
+    if (transitionActive)
+    {
+        const uint16_t alpha = fadeOut(now, transitionStart, transitionDuration);
+
+        if (alpha == 0)
+        {
+            transitionActive = false;
+        }
+        else
+        {
+            blendAlpha(out, reinterpret_cast<const uint8_t *>(transitionLayer), len, alpha);
+        }
+    }
+
+    if (overlayActive)
+    {
+        const uint16_t alpha = fadeOut(now, overlayStart, overlayDuration);
+
+        if (alpha == 0)
+        {
+            overlayActive = false;
+        }
+        else
+        {
+            blendSolid(overlayMode, out, len, overlayColor, alpha);
+        }
+    }
+
+    lastComposeMicros = micros() - begin;
+}
+
+void Compositor::benchmark()
+{
+    const size_t len = sizeof(outputLayer);
+    uint8_t *out = reinterpret_cast<uint8_t *>(outputLayer);
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(transitionLayer);
+
+    for (int mode = 0; mode < BlendMode_Count; mode++)
+    {
+        const uint32_t begin = micros();
+        blend(static_cast<BlendMode>(mode), out, src, len, 128);
+        const uint32_t elapsed = micros() - begin;
+
+        logger.info("Blending %d leds in %s mode takes %uus.", MAX_LEDS, blendModeToString(static_cast<BlendMode>(mode)), static_cast<unsigned>(elapsed));
+    }
+
+    fill_solid(outputLayer, MAX_LEDS, CRGB::Black);
+}
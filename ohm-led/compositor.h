@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config.h"
+
+#include <FastLED.h>
+
+enum BlendMode
+{
+    BlendMode_Add = 0,
+    BlendMode_Alpha = 1,
+    BlendMode_Max = 2,
+    BlendMode_Count,
+};
+
+// Blend kernels.
+//
+// They treat the pixels as a flat array of channel bytes and process them four
+// at a time in 32-bit words, which is much cheaper than going through the
+// per-pixel `CRGB` operators. Both buffers must be 4-byte aligned. `len` is a
+// number of bytes. `alpha` is the opacity of `src`, from 0 (transparent) to 256
+// (opaque).
+void blendAdd(uint8_t *dst, const uint8_t *src, size_t len, uint16_t alpha);
+void blendAlpha(uint8_t *dst, const uint8_t *src, size_t len, uint16_t alpha);
+void blendMax(uint8_t *dst, const uint8_t *src, size_t len, uint16_t alpha);
+void blend(BlendMode mode, uint8_t *dst, const uint8_t *src, size_t len, uint16_t alpha);
+// Blend `color` over every pixel of `dst`, which holds `len` bytes of `CRGB`.
+void blendSolid(BlendMode mode, uint8_t *dst, size_t len, const CRGB &color, uint16_t alpha);
+
+// Combines the layers into the frame that is sent to the leds.
+//
+// From bottom to top:
+// - the base layer, where the current effect renders, owned by the caller;
+// - the transition layer, a snapshot of the last frame before a mode change,
+//   that fades out over the transition time;
+// - the overlay, a solid color for notifications, that fades out over its
+//   duration. It is blended from the color alone, without a layer of its own.
+class Compositor
+{
+public:
+    CRGB *output()
+    {
+        return outputLayer;
+    }
+
+    // Crossfade from the last output frame to the base layer over `duration` milliseconds.
+    void startTransition(uint32_t duration);
+
+    // Flash `color` over the effect, fading out over `duration` milliseconds.
+    void notify(const CRGB &color, BlendMode mode, uint32_t duration);
+
+    // `baseScale` dims the base layer, from 0 (black) to 65535 (unchanged), with more precision
+    // than the effect could render it when gamma correction is enabled.
+    //
+    // With `previous`, the base layer is interpolated from `previous` to `base`, with
+    // `progress` going from 0 to 256, for effects that compute slower than the frame rate.
+    void compose(const CRGB *base, uint16_t count, uint16_t baseScale = 65535, const CRGB *previous = nullptr, uint16_t progress = 256);
+
+    // Whether the output changes from frame to frame, even with a static base layer.
+    bool isAnimating() const
+    {
+        return transitionActive || overlayActive;
+    }
+
+    // Time the kernels at `MAX_LEDS`, and log the results.
+    void benchmark();
+
+    // Whether the base layer goes through the gamma stage. The layers above it are blended in linear light.
+    bool gammaCorrection = false;
+
+    uint32_t lastComposeMicros = 0;
+
+private:
+    // Returns the opacity of a layer that started fading out at `start`, or 0 once it is done.
+    static uint16_t fadeOut(uint32_t now, uint32_t start, uint32_t duration);
+
+    alignas(4) CRGB transitionLayer[MAX_LEDS];
+    alignas(4) CRGB outputLayer[MAX_LEDS];
+
+    uint32_t transitionStart = 0;
+    uint32_t transitionDuration = 0;
+    bool transitionActive = false;
+
+    CRGB overlayColor;
+    BlendMode overlayMode = BlendMode_Alpha;
+    uint32_t overlayStart = 0;
+    uint32_t overlayDuration = 0;
+    bool overlayActive = false;
+};
+
+extern Compositor compositor;
+
+const char *blendModeToString(BlendMode mode);
+BlendMode blendModeFromString(const String &s);
@@ -7,6 +7,35 @@ Config config;
 const char *Config::AP_SSID = "ohm-led";
 const char *Config::AP_PASSPHRASE = "password";
 
+// Erased flash reads as all ones: such a string is empty.
+static void sanitizeString(char *s, size_t size)
+{
+    if (static_cast<uint8_t>(s[0]) == 0xff)
+    {
+        s[0] = '\0';
+    }
+
+    s[size - 1] = '\0';
+}
+
+// Erased flash reads as all ones, which is neither true nor false: read the byte
+// itself, and only take a stored 1 as true.
+static void sanitizeBool(bool &value)
+{
+    uint8_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    value = (raw == 1);
+}
+
+// Erased flash reads as all ones: such a port is the default one.
+static void sanitizePort(uint16_t &port, uint16_t defaultPort)
+{
+    if ((port == 0) || (port == 0xffff))
+    {
+        port = defaultPort;
+    }
+}
+
 bool Config::Load()
 {
     bool result = true;
@@ -14,7 +43,23 @@ bool Config::Load()
     EEPROM.begin(sizeof(*this));
     EEPROM.get(0, *this);
 
-    if (!isValid())
+    if (magic_value == LEGACY_MAGIC_VALUE)
+    {
+        // The fields that came after `milliamps` were laid out differently while they were
+        // being added: start them over rather than misreading them.
+        const Config legacy = *this;
+        *this = Config();
+
+        memcpy(name, legacy.name, sizeof(name));
+        memcpy(ssid, legacy.ssid, sizeof(ssid));
+        memcpy(passphrase, legacy.passphrase, sizeof(passphrase));
+        http_port = legacy.http_port;
+        num_leds = legacy.num_leds;
+        fps = legacy.fps;
+        voltage = legacy.voltage;
+        milliamps = legacy.milliamps;
+    }
+    else if (!isValid())
     {
         result = false;
         *this = Config();
@@ -27,14 +72,65 @@ bool Config::Load()
         num_leds = DEFAULT_NUM_LEDS;
     }
 
-    if (http_port == 0)
+    sanitizePort(http_port, DEFAULT_HTTP_PORT);
+    sanitizePort(udp_port, DEFAULT_UDP_PORT);
+    sanitizePort(mqtt_port, DEFAULT_MQTT_PORT);
+
+    sanitizeString(name, sizeof(name));
+    sanitizeString(ssid, sizeof(ssid));
+    sanitizeString(passphrase, sizeof(passphrase));
+    sanitizeString(mqtt_host, sizeof(mqtt_host));
+    sanitizeString(mqtt_username, sizeof(mqtt_username));
+    sanitizeString(mqtt_password, sizeof(mqtt_password));
+    sanitizeString(mqtt_topic, sizeof(mqtt_topic));
+    sanitizeString(update_password, sizeof(update_password));
+
+    sanitizeBool(matrix_serpentine);
+    sanitizeBool(matrix_flip_x);
+    sanitizeBool(matrix_flip_y);
+    sanitizeBool(button_cycles_presets);
+    sanitizeBool(gamma_correction);
+
+    if ((fps <= 0) || (fps > MAX_FPS))
     {
-        http_port = DEFAULT_HTTP_PORT;
+        fps = DEFAULT_FPS;
     }
 
-    if (fps <= 0)
+    // Configurations saved by older firmwares don't have a layout.
+    if ((static_cast<uint32_t>(matrix_width) * matrix_height > MAX_LEDS) || (matrix_rotation >= MATRIX_ROTATION_COUNT))
     {
-        fps = DEFAULT_FPS;
+        matrix_width = 0;
+        matrix_height = 0;
+        matrix_serpentine = false;
+        matrix_rotation = 0;
+        matrix_flip_x = false;
+        matrix_flip_y = false;
+    }
+
+    if ((led_chipset >= LedChipset_Count) || (led_color_order >= LedColorOrder_Count))
+    {
+        led_chipset = LedChipset_WS2812;
+        led_color_order = LedColorOrder_GRB;
+    }
+
+    // Configurations saved by older firmwares have no IP settings, and erased flash reads as all ones.
+    if ((static_ip == 0xffffffff) || ((static_ip != 0) && ((static_subnet == 0) || (static_subnet == 0xffffffff))))
+    {
+        static_ip = 0;
+        static_gateway = 0;
+        static_subnet = 0;
+        static_dns = 0;
+    }
+
+    // Erased flash reads as all ones.
+    if (group == 0xff)
+    {
+        group = 0;
+    }
+
+    if ((cached_channel < 1) || (cached_channel > 14))
+    {
+        clearCachedNetwork();
     }
 
     return result;
@@ -59,7 +155,7 @@ bool Config::Clear()
 
     EEPROM.begin(sizeof(*this));
 
-    for (int i = 0; i < sizeof(*this); i++)
+    for (size_t i = 0; i < sizeof(*this); i++)
     {
         EEPROM.write(i, 0);
     }
@@ -68,4 +164,42 @@ bool Config::Clear()
     EEPROM.end();
 
     return true;
-}
\ No newline at end of file
+}
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619;
+    }
+
+    return hash;
+}
+
+uint32_t Config::restartFingerprint() const
+{
+    uint32_t hash = 2166136261;
+
+    // Network settings, and the chipset which is a template parameter of the led controller.
+    hash = fnv1a(hash, name, sizeof(name));
+    hash = fnv1a(hash, ssid, sizeof(ssid));
+    hash = fnv1a(hash, passphrase, sizeof(passphrase));
+    hash = fnv1a(hash, &http_port, sizeof(http_port));
+    hash = fnv1a(hash, &udp_port, sizeof(udp_port));
+    hash = fnv1a(hash, &led_chipset, sizeof(led_chipset));
+    hash = fnv1a(hash, &led_color_order, sizeof(led_color_order));
+    hash = fnv1a(hash, mqtt_host, sizeof(mqtt_host));
+    hash = fnv1a(hash, &mqtt_port, sizeof(mqtt_port));
+    hash = fnv1a(hash, mqtt_username, sizeof(mqtt_username));
+    hash = fnv1a(hash, mqtt_password, sizeof(mqtt_password));
+    hash = fnv1a(hash, mqtt_topic, sizeof(mqtt_topic));
+    hash = fnv1a(hash, &static_ip, sizeof(static_ip));
+    hash = fnv1a(hash, &static_gateway, sizeof(static_gateway));
+    hash = fnv1a(hash, &static_subnet, sizeof(static_subnet));
+    hash = fnv1a(hash, &static_dns, sizeof(static_dns));
+    hash = fnv1a(hash, &group, sizeof(group));
+
+    return hash;
+}
@@ -9,29 +9,61 @@
 // The maximum support number of leds.
 #define MAX_LEDS 1000
 
-// PIN configuration.
+// PIN configuration, using the NodeMCU numbering for FastLED.
+#define FASTLED_ESP8266_NODEMCU_PIN_ORDER
 #define LEDS_DATA_PIN 1
+#define LEDS_CLOCK_PIN 2
 #define EXTERNAL_LED_PIN D3
 #define BUTTON_PIN D5
 
+// The clock rate for clocked (SPI) chipsets.
+#define LEDS_SPI_DATA_RATE_MHZ 8
+
+enum LedChipset
+{
+    LedChipset_WS2812 = 0,
+    LedChipset_WS2811 = 1,
+    LedChipset_SK6812 = 2,
+    LedChipset_APA102 = 3,
+    LedChipset_SK9822 = 4,
+    LedChipset_Count,
+};
+
+enum LedColorOrder
+{
+    LedColorOrder_GRB = 0,
+    LedColorOrder_RGB = 1,
+    LedColorOrder_BGR = 2,
+    LedColorOrder_Count,
+};
+
 class Config
 {
 public:
     static const char* AP_SSID;
     static const char* AP_PASSPHRASE;
-    static const uint64_t MAGIC_VALUE = 0xBADA551;
+    static const uint64_t MAGIC_VALUE = 0xBADA552;
+    // Configurations saved by firmwares up to 0.0.2: only the fields up to `milliamps` are kept from them.
+    static const uint64_t LEGACY_MAGIC_VALUE = 0xBADA551;
     static const uint16_t DEFAULT_HTTP_PORT = 80;
+    static const uint16_t DEFAULT_UDP_PORT = 4210;
+    static const uint16_t DEFAULT_MQTT_PORT = 1883;
     static const uint16_t DEFAULT_NUM_LEDS = 16;
     static const int DEFAULT_FPS = 120;
+    static const int MAX_FPS = 1000;
     static const uint16_t DEFAULT_VOLTAGE = 5;
     static const uint16_t DEFAULT_MILLIAMPS = 0;
     static const uint16_t MIN_SYSTEM_MILLIAMPS = 500;
+    static const uint8_t MATRIX_ROTATION_COUNT = 4;
 
     Config() = default;
     bool Load();
     bool Save() const;
     bool Clear();
 
+    // A hash of the fields that can only be applied by restarting.
+    uint32_t restartFingerprint() const;
+
 private:
     mutable uint64_t magic_value = 0;
 
@@ -53,6 +85,53 @@ public:
     uint16_t voltage = DEFAULT_VOLTAGE;
     uint16_t milliamps = DEFAULT_MILLIAMPS;
 
+    // 2D layout. A width of 0 means the leds form a single strip.
+    uint16_t matrix_width = 0;
+    uint16_t matrix_height = 0;
+    bool matrix_serpentine = false;
+    uint8_t matrix_rotation = 0; // In quarter turns, clockwise.
+    bool matrix_flip_x = false;
+    bool matrix_flip_y = false;
+
+    uint8_t led_chipset = LedChipset_WS2812;
+    uint8_t led_color_order = LedColorOrder_GRB;
+
+    uint16_t udp_port = DEFAULT_UDP_PORT;
+
+    // MQTT. An empty host disables it, an empty topic defaults to "ohm-led/<name>".
+    char mqtt_host[64] = {};
+    uint16_t mqtt_port = DEFAULT_MQTT_PORT;
+    char mqtt_username[32] = {};
+    char mqtt_password[64] = {};
+    char mqtt_topic[64] = {};
+
+    // Whether a short press on the button cycles through the presets rather than the modes.
+    bool button_cycles_presets = false;
+
+    // Whether to gamma-correct and dither the effects, which smooths out low levels.
+    bool gamma_correction = false;
+
+    // Static IP configuration, in network byte order. An address of 0 uses DHCP.
+    uint32_t static_ip = 0;
+    uint32_t static_gateway = 0;
+    uint32_t static_subnet = 0;
+    uint32_t static_dns = 0;
+
+    // The last access point joined and its DHCP lease, to reconnect without scanning.
+    // Maintained by the network code rather than configured.
+    uint8_t cached_bssid[6] = {};
+    int32_t cached_channel = 0;
+    uint32_t cached_ip = 0;
+    uint32_t cached_gateway = 0;
+    uint32_t cached_subnet = 0;
+    uint32_t cached_dns = 0;
+
+    // Controllers with the same group, from 1 to 254, replicate their state writes to each other. 0 is no group.
+    uint8_t group = 0;
+
+    // The password of POST /v1/firmware/, for the user "ohm-led". Firmware updates are disabled until it is set.
+    char update_password[32] = {};
+
     bool hasName() const
     {
         return (strnlen(name, sizeof(name)) > 0);
@@ -62,6 +141,41 @@ public:
     {
         return (strnlen(ssid, sizeof(ssid)) > 0);
     }
+
+    bool hasMqtt() const
+    {
+        return (strnlen(mqtt_host, sizeof(mqtt_host)) > 0);
+    }
+
+    bool hasUpdatePassword() const
+    {
+        return (strnlen(update_password, sizeof(update_password)) > 0);
+    }
+
+    bool hasMatrix() const
+    {
+        return (matrix_width > 0) && (matrix_height > 0);
+    }
+
+    bool hasStaticIp() const
+    {
+        return static_ip != 0;
+    }
+
+    bool hasCachedNetwork() const
+    {
+        return cached_channel != 0;
+    }
+
+    void clearCachedNetwork()
+    {
+        memset(cached_bssid, 0, sizeof(cached_bssid));
+        cached_channel = 0;
+        cached_ip = 0;
+        cached_gateway = 0;
+        cached_subnet = 0;
+        cached_dns = 0;
+    }
 };
 
 extern Config config;
\ No newline at end of file
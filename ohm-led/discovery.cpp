@@ -0,0 +1,103 @@
+#include "discovery.h"
+
+#include "config.h"
+#include "logger.h"
+#include "state.h"
+
+#include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
+
+// Announcements are multicast to every host on the network: coalesce bursts of state changes.
+static const uint32_t MIN_ANNOUNCE_INTERVAL_MS = 1000;
+
+bool discoveryEnabled = false;
+MDNSResponder::hMDNSService ohmLedService = nullptr;
+
+// What the last announcement carried.
+uint32_t announcedVersion = 0;
+uint16_t announcedNumLeds = 0;
+uint32_t lastAnnounce = 0;
+
+// Called by the responder whenever it sends the service's TXT records.
+static void addDynamicTxt(const MDNSResponder::hMDNSService service)
+{
+    if (service != ohmLedService)
+    {
+        return;
+    }
+
+    const uint32_t version = state.version();
+    const StateSnapshot current = state.snapshot();
+
+    char revision[24];
+    snprintf(revision, sizeof(revision), "%llu", static_cast<unsigned long long>(current.revision));
+
+    MDNS.addDynamicServiceTxt(service, "num-leds", config.num_leds);
+    MDNS.addDynamicServiceTxt(service, "mode", modeToString(current.mode).c_str());
+    MDNS.addDynamicServiceTxt(service, "revision", revision);
+
+    announcedVersion = version;
+    announcedNumLeds = config.num_leds;
+}
+
+void setupDiscovery()
+{
+    if (!config.hasName())
+    {
+        return;
+    }
+
+    logger.info("Using configured name '%s' as a hostname.", config.name);
+    WiFi.hostname(config.name);
+
+    if (!MDNS.begin(config.name, WiFi.localIP()))
+    {
+        logger.error("Failed to setup MDNS.");
+        return;
+    }
+
+    MDNS.addService("http", "tcp", config.http_port);
+    ohmLedService = MDNS.addService("ohm-led", "tcp", config.http_port);
+    MDNS.addServiceTxt(ohmLedService, "version", VERSION);
+    MDNS.setDynamicServiceTxtCallback(ohmLedService, addDynamicTxt);
+
+    discoveryEnabled = true;
+    lastAnnounce = millis();
+
+    logger.info("MDNS has been set up.");
+}
+
+void restartDiscovery()
+{
+    if (!discoveryEnabled)
+    {
+        return;
+    }
+
+    // Probes the host name again, and announces the services with the current address.
+    MDNS.notifyAPChange();
+    lastAnnounce = millis();
+}
+
+void discoveryLoop()
+{
+    if (!discoveryEnabled)
+    {
+        return;
+    }
+
+    MDNS.update();
+
+    if ((state.version() == announcedVersion) && (config.num_leds == announcedNumLeds))
+    {
+        return;
+    }
+
+    if (millis() - lastAnnounce < MIN_ANNOUNCE_INTERVAL_MS)
+    {
+        return;
+    }
+
+    lastAnnounce = millis();
+    MDNS.announce();
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Advertises the controller over mDNS.
+//
+// The `_ohm-led._tcp` service carries TXT records with the firmware version,
+// the number of leds, the current mode and the state revision, so that a
+// single browse is enough to inventory a fleet and notice changes. The
+// records are re-announced when they change, at most once per second.
+void setupDiscovery();
+// Announce the controller again, once the network reconnected, possibly with another address.
+void restartDiscovery();
+void discoveryLoop();
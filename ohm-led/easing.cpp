@@ -56,7 +56,8 @@ double easeInCubic(double t)
 
 double easeOutCubic(double t)
 {
-    return 1 + (--t) * t * t;
+    t -= 1;
+    return 1 + t * t * t;
 }
 
 double easeInOutCubic(double t)
@@ -72,7 +73,8 @@ double easeInQuart(double t)
 
 double easeOutQuart(double t)
 {
-    t = (--t) * t;
+    t -= 1;
+    t *= t;
     return 1 - t * t;
 }
 
@@ -85,7 +87,8 @@ double easeInOutQuart(double t)
     }
     else
     {
-        t = (--t) * t;
+        t -= 1;
+        t *= t;
         return 1 - 8 * t * t;
     }
 }
@@ -98,7 +101,8 @@ double easeInQuint(double t)
 
 double easeOutQuint(double t)
 {
-    double t2 = (--t) * t;
+    t -= 1;
+    double t2 = t * t;
     return 1 + t * t2 * t2;
 }
 
@@ -112,7 +116,8 @@ double easeInOutQuint(double t)
     }
     else
     {
-        t2 = (--t) * t;
+        t -= 1;
+        t2 = t * t;
         return 1 + 16 * t * t2 * t2;
     }
 }
@@ -168,7 +173,8 @@ double easeInBack(double t)
 
 double easeOutBack(double t)
 {
-    return 1 + (--t) * t * (2.70158 * t + 1.70158);
+    t -= 1;
+    return 1 + t * t * (2.70158 * t + 1.70158);
 }
 
 double easeInOutBack(double t)
@@ -179,7 +185,8 @@ double easeInOutBack(double t)
     }
     else
     {
-        return 1 + (--t) * t * 2 * (7 * t + 2.5);
+        t -= 1;
+        return 1 + t * t * 2 * (7 * t + 2.5);
     }
 }
 
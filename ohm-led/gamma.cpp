@@ -0,0 +1,100 @@
+#include "gamma.h"
+
+#include "logger.h"
+
+#include <Arduino.h>
+#include <math.h>
+
+GammaStage gammaStage;
+
+void GammaStage::setup()
+{
+    for (int i = 0; i <= 256; i++)
+    {
+        const float x = (i < 256) ? (i / 255.0f) : 1.0f;
+        lut[i] = static_cast<uint16_t>(lroundf(powf(x, GAMMA) * 65535.0f));
+    }
+
+    reset();
+}
+
+void GammaStage::reset()
+{
+    memset(error, 0, sizeof(error));
+    dithering = false;
+}
+
+void GammaStage::convert(uint8_t *dst, const uint8_t *src, size_t len, uint16_t scale)
+{
+    const uint32_t begin = micros();
+
+    // Multiplying by 257 maps 255 to 65535, and the extra 1 makes 65535 an exact identity.
+    const uint32_t factor = (static_cast<uint32_t>(scale) + 1) * 257;
+    uint8_t *err = error;
+    uint32_t fractions = 0;
+
+    if (!ditherEnabled)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            const uint32_t p = (src[i] * factor) >> 16;
+            const uint32_t index = p >> 8;
+            const uint32_t lo = lut[index];
+            const uint32_t linear = lo + (((lut[index + 1] - lo) * (p & 0xff)) >> 8);
+
+            dst[i] = min(linear + 0x80, static_cast<uint32_t>(0xffff)) >> 8;
+            err[i] = 0;
+        }
+
+        dithering = false;
+        lastConvertMicros = micros() - begin;
+        return;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        // 16-bit perceptual value, then linear light interpolated between the two nearest levels.
+        const uint32_t p = (src[i] * factor) >> 16;
+        const uint32_t index = p >> 8;
+        const uint32_t frac = p & 0xff;
+        const uint32_t lo = lut[index];
+        const uint32_t linear = lo + (((lut[index + 1] - lo) * frac) >> 8);
+
+        const uint32_t acc = linear + err[i];
+        uint32_t out = acc >> 8;
+
+        if (out > 255)
+        {
+            out = 255;
+        }
+
+        const uint32_t residual = acc - (out << 8);
+        err[i] = (residual > 255) ? 255 : residual;
+        fractions |= linear & 0xff;
+
+        dst[i] = out;
+    }
+
+    dithering = (fractions != 0);
+    lastConvertMicros = micros() - begin;
+}
+
+void GammaStage::benchmark()
+{
+    static const int ITERATIONS = 8;
+
+    // Convert the error buffer onto itself: the output is meaningless, but the work is the same.
+    uint8_t *buffer = error;
+    const size_t len = sizeof(error);
+    uint32_t total = 0;
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        convert(buffer, buffer, len, 0x8000 + i);
+        total += lastConvertMicros;
+    }
+
+    reset();
+
+    logger.info("Gamma stage: %uus per frame at %d led(s).", static_cast<unsigned>(total / ITERATIONS), MAX_LEDS);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config.h"
+
+// Gamma correction with temporal dithering.
+//
+// Effects render perceptual 8-bit values. This stage scales them with 16-bit
+// precision, converts them to linear light through an interpolated gamma
+// table, and dithers the 16-bit result back to 8 bits by carrying each
+// channel's rounding error over to the next frame. Low levels and slow fades
+// then average out to the right brightness instead of stepping.
+//
+// There is no 16-bit framebuffer: the effects still draw 8-bit `CRGB`. What
+// gets the 16-bit precision is the dimming passed as the compositor's
+// `baseScale`, which is how the pulse fades, and how the single-color effects
+// apply the state's value.
+//
+// Dithering changes the output on every frame. Once a frame settles, the
+// renderer turns it off, and the values get rounded to the nearest level, so
+// that the frame stops changing and the controller can idle.
+class GammaStage
+{
+public:
+    static constexpr float GAMMA = 2.2f;
+
+    void setup();
+
+    // Convert `len` channel bytes from `src` to `dst`, which may be the same buffer.
+    // `scale` dims the input, from 0 (black) to 65535 (unchanged).
+    void convert(uint8_t *dst, const uint8_t *src, size_t len, uint16_t scale);
+
+    // Forget the accumulated errors.
+    void reset();
+
+    // Whether the last frame had values between two output levels, so that the next one differs.
+    bool isDithering() const
+    {
+        return dithering;
+    }
+
+    // Whether to carry the rounding errors over to the next frame, rather than round to the nearest level.
+    bool ditherEnabled = true;
+
+    // Time the conversion at `MAX_LEDS`, and log the result.
+    void benchmark();
+
+    uint32_t lastConvertMicros = 0;
+
+private:
+    // Linear light for each perceptual level, in 1/65535ths. The extra entry allows interpolating the last level.
+    uint16_t lut[257] = {};
+    uint8_t error[MAX_LEDS * 3] = {};
+    bool dithering = false;
+};
+
+extern GammaStage gammaStage;
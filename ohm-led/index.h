@@ -40,10 +40,46 @@ constexpr char INDEX[] = R"=====(
                 <label for="passphrase">Passphrase: </label>
                 <input type="password" name="passphrase" id="passphrase">
             </div>
+            <div>
+                <label for="static_ip">Static IP address (leave empty for DHCP): </label>
+                <input type="text" name="static_ip" id="static_ip" value="%s">
+            </div>
+            <div>
+                <label for="static_gateway">Gateway: </label>
+                <input type="text" name="static_gateway" id="static_gateway" value="%s">
+            </div>
+            <div>
+                <label for="static_subnet">Subnet mask: </label>
+                <input type="text" name="static_subnet" id="static_subnet" value="%s">
+            </div>
+            <div>
+                <label for="static_dns">DNS server: </label>
+                <input type="text" name="static_dns" id="static_dns" value="%s">
+            </div>
+            <div>
+                <label for="group">Group (0 for none): </label>
+                <input type="number" name="group" id="group" min="0" max="254" value="%d">
+            </div>
+            <div>
+                <label for="update_password">Firmware update password (updates are disabled until set, changing it asks for the current one): </label>
+                <input type="password" name="update_password" id="update_password">
+            </div>
             <div>
                 <label for="num_leds">Number of LEDs: </label>
                 <input type="number" name="num_leds" id="num_leds" min="1" max="%d" value="%d" required>
             </div>
+            <div>
+                <label for="led_chipset">LED chipset: </label>
+                <select name="led_chipset" id="led_chipset">%s</select>
+            </div>
+            <div>
+                <label for="led_color_order">LED color order: </label>
+                <select name="led_color_order" id="led_color_order">%s</select>
+            </div>
+            <div>
+                <label for="gamma_correction">Gamma correction and dithering: </label>
+                <input type="checkbox" name="gamma_correction" id="gamma_correction" value="1" %s>
+            </div>
             <div>
                 <label for="voltage">Voltage (V): </label>
                 <input type="number" name="voltage" id="voltage" min="1" value="%d" required readonly>
@@ -52,6 +88,54 @@ constexpr char INDEX[] = R"=====(
                 <label for="milliamps">Power supply current (mA): </label>
                 <input type="number" name="milliamps" id="milliamps" min="0" value="%d" required>
             </div>
+            <div>
+                <label for="matrix_width">Matrix width (0 for a strip): </label>
+                <input type="number" name="matrix_width" id="matrix_width" min="0" max="%d" value="%d">
+            </div>
+            <div>
+                <label for="matrix_height">Matrix height (0 for a strip): </label>
+                <input type="number" name="matrix_height" id="matrix_height" min="0" max="%d" value="%d">
+            </div>
+            <div>
+                <label for="matrix_serpentine">Serpentine wiring: </label>
+                <input type="checkbox" name="matrix_serpentine" id="matrix_serpentine" value="1" %s>
+            </div>
+            <div>
+                <label for="matrix_rotation">Matrix rotation (quarter turns): </label>
+                <input type="number" name="matrix_rotation" id="matrix_rotation" min="0" max="3" value="%d">
+            </div>
+            <div>
+                <label for="matrix_flip_x">Flip horizontally: </label>
+                <input type="checkbox" name="matrix_flip_x" id="matrix_flip_x" value="1" %s>
+            </div>
+            <div>
+                <label for="matrix_flip_y">Flip vertically: </label>
+                <input type="checkbox" name="matrix_flip_y" id="matrix_flip_y" value="1" %s>
+            </div>
+            <div>
+                <label for="mqtt_host">MQTT broker (leave empty to disable): </label>
+                <input type="text" name="mqtt_host" id="mqtt_host" value="%s">
+            </div>
+            <div>
+                <label for="mqtt_port">MQTT port: </label>
+                <input type="number" name="mqtt_port" id="mqtt_port" min="1" max="65535" value="%d">
+            </div>
+            <div>
+                <label for="mqtt_username">MQTT username: </label>
+                <input type="text" name="mqtt_username" id="mqtt_username" value="%s">
+            </div>
+            <div>
+                <label for="mqtt_password">MQTT password: </label>
+                <input type="password" name="mqtt_password" id="mqtt_password">
+            </div>
+            <div>
+                <label for="mqtt_topic">MQTT topic (defaults to ohm-led/&lt;name&gt;): </label>
+                <input type="text" name="mqtt_topic" id="mqtt_topic" value="%s">
+            </div>
+            <div>
+                <label for="button_cycles_presets">Button cycles through presets: </label>
+                <input type="checkbox" name="button_cycles_presets" id="button_cycles_presets" value="1" %s>
+            </div>
             <div>
                 <input type="submit" value="Apply configuration">
             </div>
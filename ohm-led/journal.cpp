@@ -0,0 +1,146 @@
+#include "journal.h"
+
+#if ENABLE_JOURNAL
+
+#include "config.h"
+#include "logger.h"
+#include "state.h"
+
+#include <FastLED.h>
+
+Journal journal;
+
+static const uint32_t JOURNAL_MAGIC = 0x314a4c4f; // "OLJ1"
+
+static const uint32_t FNV_OFFSET_BASIS = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+void Journal::start(uint16_t seed, uint16_t interval)
+{
+    used = 0;
+    truncated = false;
+    recording = true;
+    frameInterval = (interval > 0) ? interval : 1;
+    frameIndex = 0;
+    frameChecksum = FNV_OFFSET_BASIS;
+
+    random16_set_seed(seed);
+    resetEffects();
+
+    JournalRecord *record = append(JournalRecordType_Start);
+    record->b = config.num_leds;
+    record->c = seed;
+    record->d = config.fps;
+
+    recordState(state);
+
+    logger.info("Journal started with seed %u, recording every %u frame(s).", seed, frameInterval);
+}
+
+void Journal::stop()
+{
+    if (!recording)
+    {
+        return;
+    }
+
+    recording = false;
+
+    logger.info("Journal stopped after %u frame(s), with %u record(s).", frameIndex, static_cast<unsigned>(used));
+}
+
+JournalRecord *Journal::append(JournalRecordType type)
+{
+    JournalRecord &record = records[used++];
+    record = {};
+    record.time = millis();
+    record.type = type;
+
+    // Keep two slots free so that a state record is never split from its timing.
+    if (used >= MAX_RECORDS - 1)
+    {
+        recording = false;
+        truncated = true;
+        logger.warning("Journal is full, recording stopped.");
+    }
+
+    return &record;
+}
+
+void Journal::recordFrame(const uint8_t *pixels, size_t len, uint16_t scale, uint8_t mode)
+{
+    if (!recording)
+    {
+        return;
+    }
+
+    uint32_t hash = frameChecksum;
+    hash = (hash ^ (scale & 0xff)) * FNV_PRIME;
+    hash = (hash ^ (scale >> 8)) * FNV_PRIME;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ pixels[i]) * FNV_PRIME;
+    }
+
+    frameChecksum = hash;
+
+    if ((frameIndex++ % frameInterval) != 0)
+    {
+        return;
+    }
+
+    JournalRecord *record = append(JournalRecordType_Frame);
+    record->a = mode;
+    record->b = len / 3;
+    record->c = frameIndex - 1;
+    record->d = frameChecksum;
+}
+
+void Journal::recordButton(bool pressed)
+{
+    if (!recording)
+    {
+        return;
+    }
+
+    append(JournalRecordType_Button)->a = pressed ? 1 : 0;
+}
+
+void Journal::recordState(const State &state)
+{
+    if (!recording)
+    {
+        return;
+    }
+
+    JournalRecord *record = append(JournalRecordType_State);
+    record->a = state.mode;
+    record->b = state.easing;
+    record->c = state.hue | (state.saturation << 8) | (static_cast<uint32_t>(state.value) << 16);
+    record->d = state.fire_cooling | (state.fire_sparking << 8);
+
+    // `append` never stops in between, so this one always fits.
+    JournalRecord &timing = records[used++];
+    timing = {};
+    timing.time = record->time;
+    timing.type = JournalRecordType_StateTiming;
+    timing.b = static_cast<uint16_t>(state.revision);
+    timing.c = state.period;
+    timing.d = state.transition;
+}
+
+void Journal::write(Print &out) const
+{
+    // Header: magic, record count, flags (bit 0: recording, bit 1: truncated), record size.
+    uint32_t header[4];
+    header[0] = JOURNAL_MAGIC;
+    header[1] = used;
+    header[2] = (recording ? 1 : 0) | (truncated ? 2 : 0);
+    header[3] = sizeof(JournalRecord);
+
+    out.write(reinterpret_cast<const uint8_t *>(header), sizeof(header));
+    out.write(reinterpret_cast<const uint8_t *>(records), used * sizeof(JournalRecord));
+}
+
+#endif
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+
+class State;
+
+// Set to 0 to compile the journal out.
+#ifndef ENABLE_JOURNAL
+#define ENABLE_JOURNAL 1
+#endif
+
+enum JournalRecordType
+{
+    // a: unused, b: number of leds, c: RNG seed, d: fps.
+    JournalRecordType_Start = 1,
+    // a: mode, b: number of leds, c: frame index, d: checksum of every frame so far.
+    JournalRecordType_Frame = 2,
+    // a: 1 if pressed, 0 if released.
+    JournalRecordType_Button = 3,
+    // a: mode, b: easing, c: hue | saturation << 8 | value << 16, d: fire cooling | fire sparking << 8.
+    JournalRecordType_State = 4,
+    // b: low 16 bits of the revision, c: period, d: transition. Always follows a state record.
+    JournalRecordType_StateTiming = 5,
+};
+
+// All fields are little-endian, which is the native byte order.
+struct JournalRecord
+{
+    uint32_t time;
+    uint8_t type;
+    uint8_t a;
+    uint16_t b;
+    uint32_t c;
+    uint32_t d;
+};
+
+static_assert(sizeof(JournalRecord) == 16, "JournalRecord must stay 16 bytes");
+
+// Records the inputs of the renderer and a checksum of its output, so that a
+// visual glitch can be captured on the device and replayed elsewhere.
+//
+// Starting a recording seeds the RNG and clears the effects' internal state,
+// so that the frames only depend on the recorded inputs. Frame records carry
+// the `millis()` value the frame was rendered at, and a checksum chained over
+// all frames since the start, so recording only every Nth frame still
+// verifies every frame.
+//
+// The journal stops by itself once full rather than overwriting its start.
+class Journal
+{
+public:
+    static const size_t MAX_RECORDS = 256;
+
+    void start(uint16_t seed, uint16_t frameInterval);
+    void stop();
+
+    bool isRecording() const
+    {
+        return recording;
+    }
+
+    // `scale` is the dimming the compositor applies to `pixels`, which is part of the frame.
+    void recordFrame(const uint8_t *pixels, size_t len, uint16_t scale, uint8_t mode);
+    void recordButton(bool pressed);
+    void recordState(const State &state);
+
+    // Write the header and all records to `out`.
+    void write(Print &out) const;
+
+    // The number of bytes `write` outputs.
+    size_t size() const
+    {
+        return 16 + used * sizeof(JournalRecord);
+    }
+
+    size_t count() const
+    {
+        return used;
+    }
+
+private:
+    JournalRecord *append(JournalRecordType type);
+
+    JournalRecord records[MAX_RECORDS] = {};
+    size_t used = 0;
+    bool recording = false;
+    bool truncated = false;
+
+    uint16_t frameInterval = 1;
+    uint32_t frameIndex = 0;
+    uint32_t frameChecksum = 0;
+};
+
+#if ENABLE_JOURNAL
+extern Journal journal;
+#endif
@@ -0,0 +1,80 @@
+#include "layout.h"
+
+#include "logger.h"
+
+Layout layout;
+
+void Layout::build(const Config &config)
+{
+    if (!config.hasMatrix())
+    {
+        width = config.num_leds;
+        height = 1;
+
+        for (uint16_t i = 0; i < width; i++)
+        {
+            table[i] = i;
+        }
+
+        return;
+    }
+
+    const uint16_t physicalWidth = config.matrix_width;
+    const uint16_t physicalHeight = config.matrix_height;
+    const bool swap = (config.matrix_rotation % 2) == 1;
+
+    width = swap ? physicalHeight : physicalWidth;
+    height = swap ? physicalWidth : physicalHeight;
+
+    // Walk the leds in wiring order and find out where each one lands.
+    for (uint16_t i = 0; i < physicalWidth * physicalHeight; i++)
+    {
+        uint16_t px = i % physicalWidth;
+        uint16_t py = i / physicalWidth;
+
+        if (config.matrix_serpentine && (py % 2 == 1))
+        {
+            px = physicalWidth - 1 - px;
+        }
+
+        if (config.matrix_flip_x)
+        {
+            px = physicalWidth - 1 - px;
+        }
+
+        if (config.matrix_flip_y)
+        {
+            py = physicalHeight - 1 - py;
+        }
+
+        uint16_t x = px;
+        uint16_t y = py;
+
+        switch (config.matrix_rotation)
+        {
+        case 1:
+            x = physicalHeight - 1 - py;
+            y = px;
+            break;
+        case 2:
+            x = physicalWidth - 1 - px;
+            y = physicalHeight - 1 - py;
+            break;
+        case 3:
+            x = py;
+            y = physicalWidth - 1 - px;
+            break;
+        default:
+            break;
+        }
+
+        table[y * width + x] = i;
+    }
+}
+
+void setupLayout()
+{
+    layout.build(config);
+
+    logger.info("Layout is %dx%d.", layout.width, layout.height);
+}
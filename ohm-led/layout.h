@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include "config.h"
+
+// Maps logical (x, y) coordinates to led indices.
+//
+// The table is computed once from the configuration so that 2D effects can walk
+// it sequentially, without any per-pixel coordinate math. A strip is treated as
+// a single row of `num_leds` pixels.
+class Layout
+{
+public:
+    void build(const Config &config);
+
+    uint16_t xy(uint16_t x, uint16_t y) const
+    {
+        return table[y * width + x];
+    }
+
+    // The led indices in row-major logical order, `width * height` entries long.
+    const uint16_t *indices() const
+    {
+        return table;
+    }
+
+    uint16_t width = 0;
+    uint16_t height = 0;
+
+private:
+    uint16_t table[MAX_LEDS] = {};
+};
+
+extern Layout layout;
+
+void setupLayout();
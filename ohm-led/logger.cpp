@@ -0,0 +1,221 @@
+#include "logger.h"
+
+Logger logger;
+
+const char *const levelNames[LogLevel_Count] = {
+    "debug",
+    "info",
+    "warning",
+    "error",
+};
+
+const char levelTags[LogLevel_Count] = {'D', 'I', 'W', 'E'};
+
+const char *logLevelToString(LogLevel level)
+{
+    if (level < 0 || level >= LogLevel_Count)
+    {
+        return "info";
+    }
+
+    return levelNames[level];
+}
+
+LogLevel logLevelFromString(const String &s)
+{
+    for (int i = 0; i < LogLevel_Count; i++)
+    {
+        if (s == levelNames[i])
+        {
+            return static_cast<LogLevel>(i);
+        }
+    }
+
+    return LogLevel_Count;
+}
+
+void Logger::vlog(LogLevel level, const char *format, va_list args)
+{
+    if (level < this->level)
+    {
+        return;
+    }
+
+    char line[MAX_LINE_SIZE];
+    int len = snprintf(line, sizeof(line), "%lu [%c] ", millis(), levelTags[level]);
+
+    if (len < 0)
+    {
+        return;
+    }
+
+    const int written = vsnprintf(line + len, sizeof(line) - len - 1, format, args);
+
+    if (written < 0)
+    {
+        return;
+    }
+
+    len += written;
+
+    // Truncated messages still get their newline.
+    if (len > static_cast<int>(sizeof(line)) - 2)
+    {
+        len = sizeof(line) - 2;
+    }
+
+    line[len++] = '\n';
+
+    append(line, len);
+}
+
+void Logger::log(LogLevel level, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(level, format, args);
+    va_end(args);
+}
+
+void Logger::debug(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(LogLevel_Debug, format, args);
+    va_end(args);
+}
+
+void Logger::info(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(LogLevel_Info, format, args);
+    va_end(args);
+}
+
+void Logger::warning(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(LogLevel_Warning, format, args);
+    va_end(args);
+}
+
+void Logger::error(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(LogLevel_Error, format, args);
+    va_end(args);
+}
+
+void Logger::append(const char *data, size_t len)
+{
+    if (appending.test_and_set(std::memory_order_acquire))
+    {
+        dropped.fetch_add(len, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint32_t h = head.load(std::memory_order_relaxed);
+
+    // If Serial could not keep up, drop the message rather than the pending ones.
+    if (h - tail.load(std::memory_order_acquire) + len > BUFFER_SIZE)
+    {
+        dropped.fetch_add(len, std::memory_order_relaxed);
+        appending.clear(std::memory_order_release);
+        return;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        buffer[(h + i) % BUFFER_SIZE] = data[i];
+    }
+
+    head.store(h + len, std::memory_order_release);
+    appending.clear(std::memory_order_release);
+}
+
+size_t Logger::drain(size_t limit)
+{
+    const uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    size_t sent = 0;
+
+    while ((t != h) && (sent < limit))
+    {
+        const int room = Serial.availableForWrite();
+
+        if (room <= 0)
+        {
+            break;
+        }
+
+        // Send contiguous runs only, the buffer may wrap.
+        const size_t offset = t % BUFFER_SIZE;
+        size_t len = h - t;
+
+        if (len > BUFFER_SIZE - offset)
+        {
+            len = BUFFER_SIZE - offset;
+        }
+
+        if (len > static_cast<size_t>(room))
+        {
+            len = room;
+        }
+
+        if (len > limit - sent)
+        {
+            len = limit - sent;
+        }
+
+        Serial.write(reinterpret_cast<const uint8_t *>(buffer + offset), len);
+        t += len;
+        sent += len;
+    }
+
+    tail.store(t, std::memory_order_release);
+
+    return sent;
+}
+
+void Logger::flush()
+{
+    while (tail.load(std::memory_order_acquire) != head.load(std::memory_order_acquire))
+    {
+        if (drain() == 0)
+        {
+            yield();
+        }
+    }
+
+    Serial.flush();
+}
+
+void Logger::copyHistory(String &out) const
+{
+    const uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t start = (h > BUFFER_SIZE) ? h - BUFFER_SIZE : 0;
+
+    // When the buffer has wrapped, the oldest line is likely partial: skip it.
+    if (start > 0)
+    {
+        while ((start != h) && (buffer[start % BUFFER_SIZE] != '\n'))
+        {
+            start++;
+        }
+
+        if (start != h)
+        {
+            start++;
+        }
+    }
+
+    out.reserve(out.length() + (h - start));
+
+    for (uint32_t i = start; i != h; i++)
+    {
+        out += buffer[i % BUFFER_SIZE];
+    }
+}
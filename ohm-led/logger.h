@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+
+enum LogLevel
+{
+    LogLevel_Debug = 0,
+    LogLevel_Info = 1,
+    LogLevel_Warning = 2,
+    LogLevel_Error = 3,
+    LogLevel_Count,
+};
+
+// A leveled logger that formats messages into a fixed ring buffer.
+//
+// Logging never touches the UART: the buffer is drained to Serial by `drain()`
+// only as far as the hardware FIFO can take without blocking, which lets the
+// main loop call it whenever there is time left in the current frame.
+//
+// The most recent `BUFFER_SIZE` bytes remain readable through `copyHistory()`,
+// regardless of whether they were already sent to Serial.
+//
+// Only `drain()` moves the tail: when Serial falls behind and the buffer is
+// full, new messages are dropped and counted rather than overwriting pending
+// ones. Messages are written by one caller at a time: a message logged while
+// another one is being appended, from an interrupt or a callback nested in
+// it, is dropped and counted as well.
+class Logger
+{
+public:
+    static const size_t BUFFER_SIZE = 2048;
+    static const size_t MAX_LINE_SIZE = 160;
+    // How much the main loop sends on each iteration, even when no frame has time to spare.
+    static const size_t LOOP_DRAIN_SIZE = 32;
+
+    void log(LogLevel level, const char *format, ...) __attribute__((format(printf, 3, 4)));
+    void vlog(LogLevel level, const char *format, va_list args);
+
+    void debug(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void info(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void warning(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void error(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Send as many pending bytes to Serial as it can take without blocking,
+    // up to `limit`.
+    //
+    // Returns the number of bytes sent.
+    size_t drain(size_t limit = SIZE_MAX);
+
+    // Send all pending bytes to Serial, blocking if necessary.
+    //
+    // Only meant to be used during setup or right before a restart.
+    void flush();
+
+    // Copy the retained history, starting on a line boundary.
+    void copyHistory(String &out) const;
+
+    LogLevel level = LogLevel_Info;
+
+    uint32_t droppedBytes() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    void append(const char *data, size_t len);
+
+    char buffer[BUFFER_SIZE] = {};
+
+    // Monotonic byte counters: the buffer index is the counter modulo `BUFFER_SIZE`.
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> dropped{0};
+    std::atomic_flag appending = ATOMIC_FLAG_INIT;
+};
+
+extern Logger logger;
+
+const char *logLevelToString(LogLevel level);
+LogLevel logLevelFromString(const String &s);
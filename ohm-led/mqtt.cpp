@@ -0,0 +1,562 @@
+#include "mqtt.h"
+
+#include "config.h"
+#include "logger.h"
+#include "power.h"
+#include "state.h"
+#include "udp.h"
+
+#include <ESP8266WiFi.h>
+#include <ESPAsyncTCP.h>
+
+// Nothing here waits on the network: the name resolution and the TCP connection complete in the
+// background, and the loop polls for the broker's answers. These only bound how long it may take.
+static const uint32_t CONNECT_TIMEOUT_MS = 5000;
+static const uint32_t CONNACK_TIMEOUT_MS = 5000;
+static const uint32_t MIN_RECONNECT_DELAY_MS = 1000;
+static const uint32_t MAX_RECONNECT_DELAY_MS = 60000;
+static const uint16_t KEEP_ALIVE_S = 15;
+// A slider being dragged changes the revision on every frame: the retained state follows at this pace.
+static const uint32_t MIN_PUBLISH_INTERVAL_MS = 250;
+// The largest packet sent or received.
+static const size_t MQTT_BUFFER_SIZE = 512;
+
+enum MqttPacketType
+{
+    MqttPacketType_Connect = 1,
+    MqttPacketType_Connack = 2,
+    MqttPacketType_Publish = 3,
+    MqttPacketType_Subscribe = 8,
+    MqttPacketType_Suback = 9,
+    MqttPacketType_Pingreq = 12,
+    MqttPacketType_Pingresp = 13,
+    MqttPacketType_Disconnect = 14,
+};
+
+enum MqttSession
+{
+    MqttSession_Disconnected,
+    // Resolving the broker, then opening the TCP connection.
+    MqttSession_Connecting,
+    // The CONNECT is sent, the CONNACK not received yet.
+    MqttSession_Handshaking,
+    MqttSession_Connected,
+};
+
+AsyncClient mqttClient;
+
+char mqttTopic[sizeof(config.mqtt_topic)];
+char mqttSetTopic[sizeof(config.mqtt_topic) + 16];
+char mqttStateTopic[sizeof(config.mqtt_topic) + 16];
+char mqttAvailableTopic[sizeof(config.mqtt_topic) + 16];
+
+MqttSession mqttSession = MqttSession_Disconnected;
+uint32_t mqttSessionDeadline = 0;
+uint32_t mqttLastSent = 0;
+uint32_t mqttLastReceived = 0;
+uint16_t mqttNextPacketId = 1;
+
+// Written by the TCP callbacks, which the SDK runs between two loops, and consumed by the loop.
+bool mqttTcpConnected = false;
+bool mqttTcpClosed = false;
+uint8_t mqttReceived[MQTT_BUFFER_SIZE];
+size_t mqttReceivedSize = 0;
+// When the oldest data in `mqttReceived` arrived.
+uint32_t mqttReceivedAt = 0;
+bool mqttReceivedOverflow = false;
+
+uint32_t seenVersion = 0;
+bool statePublished = false;
+uint32_t lastPublish = 0;
+uint32_t nextConnectAttempt = 0;
+uint32_t reconnectDelay = MIN_RECONNECT_DELAY_MS;
+MqttStats stats = {};
+
+// Builds a packet, which is only sent if it fits.
+class MqttPacket
+{
+public:
+    explicit MqttPacket(uint8_t header) : header(header) {}
+
+    void writeU8(uint8_t v)
+    {
+        if (size < sizeof(body))
+        {
+            body[size] = v;
+        }
+
+        size++;
+    }
+
+    void writeU16(uint16_t v)
+    {
+        writeU8(v >> 8);
+        writeU8(v & 0xFF);
+    }
+
+    void writeBytes(const void *data, size_t length)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            writeU8(static_cast<const uint8_t *>(data)[i]);
+        }
+    }
+
+    void writeString(const char *s)
+    {
+        const size_t length = strlen(s);
+
+        writeU16(length);
+        writeBytes(s, length);
+    }
+
+    bool send()
+    {
+        // The fixed header: the type and flags, then the remaining length on up to 4 bytes.
+        uint8_t fixed[5] = {header};
+        size_t fixedSize = 1;
+        size_t remaining = size;
+
+        do
+        {
+            fixed[fixedSize] = remaining % 128;
+            remaining /= 128;
+
+            if (remaining > 0)
+            {
+                fixed[fixedSize] |= 0x80;
+            }
+
+            fixedSize++;
+        } while (remaining > 0);
+
+        if ((size > sizeof(body)) || (mqttClient.space() < fixedSize + size))
+        {
+            return false;
+        }
+
+        mqttClient.add(reinterpret_cast<const char *>(fixed), fixedSize);
+        mqttClient.add(reinterpret_cast<const char *>(body), size);
+
+        if (!mqttClient.send())
+        {
+            return false;
+        }
+
+        mqttLastSent = millis();
+
+        return true;
+    }
+
+private:
+    uint8_t header;
+    uint8_t body[MQTT_BUFFER_SIZE];
+    size_t size = 0;
+};
+
+static bool publish(const char *topic, const void *payload, size_t length, bool retain)
+{
+    MqttPacket packet((MqttPacketType_Publish << 4) | (retain ? 0x01 : 0x00));
+    packet.writeString(topic);
+    packet.writeBytes(payload, length);
+
+    return packet.send();
+}
+
+static void onMqttMessage(const char *topic, const uint8_t *payload, size_t length)
+{
+    powerNoteActivityAt(mqttReceivedAt);
+
+    if (strcmp(topic, mqttSetTopic) != 0)
+    {
+        return;
+    }
+
+    stats.received++;
+
+    StaticJsonDocument<256> doc;
+    DeserializationError error = deserializeJson(doc, reinterpret_cast<const char *>(payload), length);
+
+    if (error)
+    {
+        logger.warning("Ignoring invalid MQTT state: %s.", error.c_str());
+        return;
+    }
+
+    StateUpdate update;
+    update.fromJsonDocument(doc);
+
+    if (submitToGroup(update) != StateUpdateResult_Success)
+    {
+        logger.warning("Ignoring rejected MQTT state.");
+    }
+}
+
+bool publishState()
+{
+    StaticJsonDocument<256> json;
+    state.toJsonDocument(json);
+
+    char payload[256];
+    const size_t length = serializeJson(json, payload, sizeof(payload));
+
+    if (!publish(mqttStateTopic, payload, length, true))
+    {
+        return false;
+    }
+
+    stats.published++;
+
+    return true;
+}
+
+// Close the connection, whatever state it is in, and try again after the reconnection delay.
+static void dropConnection(const char *reason)
+{
+    const bool wasConnected = (mqttSession == MqttSession_Connected);
+
+    mqttSession = MqttSession_Disconnected;
+    mqttClient.close(true);
+
+    if (wasConnected)
+    {
+        logger.warning("Lost the connection to the MQTT broker (%s), reconnecting in %us.", reason, static_cast<unsigned>(reconnectDelay / 1000));
+    }
+    else
+    {
+        logger.warning("Failed to connect to the MQTT broker (%s), retrying in %us.", reason, static_cast<unsigned>(reconnectDelay / 1000));
+    }
+
+    nextConnectAttempt = millis() + reconnectDelay;
+    reconnectDelay = min(reconnectDelay * 2, MAX_RECONNECT_DELAY_MS);
+}
+
+// Start resolving and connecting to the broker, which completes in the background.
+static void startConnection()
+{
+    mqttTcpConnected = false;
+    mqttTcpClosed = false;
+    mqttReceivedSize = 0;
+    mqttReceivedOverflow = false;
+
+    mqttSession = MqttSession_Connecting;
+    mqttSessionDeadline = millis() + CONNECT_TIMEOUT_MS;
+
+    if (!mqttClient.connect(config.mqtt_host, config.mqtt_port))
+    {
+        dropConnection("no connection");
+    }
+}
+
+static bool sendConnect()
+{
+    const bool hasUsername = (strlen(config.mqtt_username) > 0);
+    const bool hasPassword = (strlen(config.mqtt_password) > 0);
+
+    MqttPacket packet(MqttPacketType_Connect << 4);
+    packet.writeString("MQTT");
+    // Protocol level 4 is MQTT 3.1.1.
+    packet.writeU8(4);
+    // A clean session, with a retained last will at QoS 0.
+    packet.writeU8(0x02 | 0x04 | 0x20 | (hasUsername ? 0x80 : 0x00) | (hasPassword ? 0x40 : 0x00));
+    packet.writeU16(KEEP_ALIVE_S);
+    packet.writeString(config.name);
+    packet.writeString(mqttAvailableTopic);
+    packet.writeString("offline");
+
+    if (hasUsername)
+    {
+        packet.writeString(config.mqtt_username);
+    }
+
+    if (hasPassword)
+    {
+        packet.writeString(config.mqtt_password);
+    }
+
+    return packet.send();
+}
+
+static bool subscribe(const char *topic)
+{
+    MqttPacket packet((MqttPacketType_Subscribe << 4) | 0x02);
+    packet.writeU16(mqttNextPacketId++);
+    packet.writeString(topic);
+    // At most once, as the state is idempotent anyway.
+    packet.writeU8(0);
+
+    return packet.send();
+}
+
+static void onConnack(const uint8_t *body, size_t length)
+{
+    if ((mqttSession != MqttSession_Handshaking) || (length < 2) || (body[1] != 0))
+    {
+        logger.warning("The MQTT broker refused the connection (%d).", (length >= 2) ? body[1] : -1);
+        dropConnection("refused");
+        return;
+    }
+
+    mqttSession = MqttSession_Connected;
+    publish(mqttAvailableTopic, "online", 6, true);
+    subscribe(mqttSetTopic);
+
+    logger.info("Connected to the MQTT broker.");
+    reconnectDelay = MIN_RECONNECT_DELAY_MS;
+
+    // Make sure the retained state is up-to-date after any disconnection.
+    statePublished = false;
+    stats.connections++;
+}
+
+static void onPublish(uint8_t flags, const uint8_t *body, size_t length)
+{
+    if (length < 2)
+    {
+        return;
+    }
+
+    const size_t topicLength = (body[0] << 8) | body[1];
+    // QoS 1 and 2 messages carry a packet identifier after the topic.
+    const size_t offset = 2 + topicLength + ((flags & 0x06) ? 2 : 0);
+
+    if (offset > length)
+    {
+        return;
+    }
+
+    char topic[sizeof(mqttSetTopic) + 1];
+
+    if (topicLength >= sizeof(topic))
+    {
+        return;
+    }
+
+    memcpy(topic, body + 2, topicLength);
+    topic[topicLength] = '\0';
+
+    onMqttMessage(topic, body + offset, length - offset);
+}
+
+// Handle the complete packets received so far. Returns false if the connection was dropped.
+static bool processReceived()
+{
+    size_t consumed = 0;
+
+    while (consumed < mqttReceivedSize)
+    {
+        const uint8_t *packet = mqttReceived + consumed;
+        const size_t available = mqttReceivedSize - consumed;
+        size_t length = 0;
+        size_t headerSize = 1;
+        bool complete = false;
+
+        // The remaining length, on up to 4 bytes.
+        for (int shift = 0; (headerSize < available) && (shift < 28); shift += 7)
+        {
+            const uint8_t byte = packet[headerSize++];
+            length |= static_cast<size_t>(byte & 0x7F) << shift;
+
+            if (!(byte & 0x80))
+            {
+                complete = true;
+                break;
+            }
+        }
+
+        if (!complete || (available < headerSize + length))
+        {
+            break;
+        }
+
+        const uint8_t *body = packet + headerSize;
+        consumed += headerSize + length;
+        mqttLastReceived = millis();
+
+        switch (packet[0] >> 4)
+        {
+        case MqttPacketType_Connack:
+            onConnack(body, length);
+            break;
+        case MqttPacketType_Publish:
+            onPublish(packet[0] & 0x0F, body, length);
+            break;
+        default:
+            // SUBACK and PINGRESP need no answer.
+            break;
+        }
+
+        if (mqttSession == MqttSession_Disconnected)
+        {
+            return false;
+        }
+    }
+
+    memmove(mqttReceived, mqttReceived + consumed, mqttReceivedSize - consumed);
+    mqttReceivedSize -= consumed;
+
+    return true;
+}
+
+// Advance the connection by whatever happened since the last loop. Returns whether it is connected.
+static bool sessionLoop()
+{
+    if (mqttSession == MqttSession_Disconnected)
+    {
+        if (static_cast<int32_t>(millis() - nextConnectAttempt) >= 0)
+        {
+            startConnection();
+        }
+
+        return false;
+    }
+
+    if (mqttTcpClosed)
+    {
+        dropConnection("closed");
+        return false;
+    }
+
+    if (mqttReceivedOverflow)
+    {
+        dropConnection("packet too big");
+        return false;
+    }
+
+    if (mqttSession == MqttSession_Connecting)
+    {
+        if (!mqttTcpConnected)
+        {
+            if (static_cast<int32_t>(millis() - mqttSessionDeadline) >= 0)
+            {
+                dropConnection("timed out");
+            }
+
+            return false;
+        }
+
+        if (!sendConnect())
+        {
+            dropConnection("CONNECT not sent");
+            return false;
+        }
+
+        mqttSession = MqttSession_Handshaking;
+        mqttSessionDeadline = millis() + CONNACK_TIMEOUT_MS;
+    }
+
+    if (!processReceived())
+    {
+        return false;
+    }
+
+    if (mqttSession == MqttSession_Handshaking)
+    {
+        if (static_cast<int32_t>(millis() - mqttSessionDeadline) >= 0)
+        {
+            dropConnection("no CONNACK");
+        }
+
+        return false;
+    }
+
+    // The broker drops the client after 1.5 keep-alive periods without a packet, and so do we.
+    if (millis() - mqttLastReceived >= KEEP_ALIVE_S * 1500)
+    {
+        dropConnection("no answer");
+        return false;
+    }
+
+    if (millis() - mqttLastSent >= KEEP_ALIVE_S * 1000)
+    {
+        MqttPacket(MqttPacketType_Pingreq << 4).send();
+    }
+
+    return true;
+}
+
+void setupMqtt()
+{
+    if (!config.hasMqtt())
+    {
+        return;
+    }
+
+    if (strlen(config.mqtt_topic) > 0)
+    {
+        snprintf(mqttTopic, sizeof(mqttTopic), "%s", config.mqtt_topic);
+    }
+    else
+    {
+        snprintf(mqttTopic, sizeof(mqttTopic), "ohm-led/%s", config.name);
+    }
+
+    snprintf(mqttSetTopic, sizeof(mqttSetTopic), "%s/set", mqttTopic);
+    snprintf(mqttStateTopic, sizeof(mqttStateTopic), "%s/state", mqttTopic);
+    snprintf(mqttAvailableTopic, sizeof(mqttAvailableTopic), "%s/available", mqttTopic);
+
+    mqttClient.setNoDelay(true);
+    mqttClient.onConnect([](void *, AsyncClient *)
+                         { mqttTcpConnected = true; });
+    mqttClient.onDisconnect([](void *, AsyncClient *)
+                            { mqttTcpClosed = true; });
+    mqttClient.onData([](void *, AsyncClient *, void *data, size_t length)
+                      {
+                          if (mqttReceivedSize + length > sizeof(mqttReceived))
+                          {
+                              mqttReceivedOverflow = true;
+                              return;
+                          }
+
+                          if (mqttReceivedSize == 0)
+                          {
+                              mqttReceivedAt = millis();
+                          }
+
+                          memcpy(mqttReceived + mqttReceivedSize, data, length);
+                          mqttReceivedSize += length; });
+
+    logger.info("MQTT is enabled, using broker %s:%d and topic '%s'.", config.mqtt_host, config.mqtt_port, mqttTopic);
+}
+
+void mqttLoop()
+{
+    if (!config.hasMqtt())
+    {
+        return;
+    }
+
+    const uint32_t version = state.version();
+
+    if (version != seenVersion)
+    {
+        seenVersion = version;
+        statePublished = false;
+        stats.state_changes++;
+    }
+
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        return;
+    }
+
+    if (!sessionLoop())
+    {
+        return;
+    }
+
+    // The last change is published once the interval is over. On failure, the next loop tries again.
+    if (!statePublished && (millis() - lastPublish >= MIN_PUBLISH_INTERVAL_MS))
+    {
+        statePublished = publishState();
+        lastPublish = millis();
+    }
+}
+
+MqttStats mqttStats()
+{
+    MqttStats result = stats;
+    result.connected = (mqttSession == MqttSession_Connected);
+
+    return result;
+}
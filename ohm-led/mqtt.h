@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// Mirrors the state on an MQTT broker:
+// - `<topic>/set` accepts the same JSON as `PUT /v1/state/`;
+// - `<topic>/state` holds the current state, retained, published only when the revision changes,
+//   at most every 250 milliseconds;
+// - `<topic>/available` is "online" or, through the last will, "offline".
+//
+// The connection is made in the background, and `mqttLoop()` never waits on the broker.
+void setupMqtt();
+void mqttLoop();
+
+struct MqttStats
+{
+    bool connected;
+    uint32_t connections;
+    uint32_t published;
+    uint32_t received;
+    uint32_t state_changes;
+};
+
+MqttStats mqttStats();
@@ -0,0 +1,342 @@
+#include "network.h"
+
+#include "button.h"
+#include "config.h"
+#include "discovery.h"
+#include "logger.h"
+#include "udp.h"
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266WiFiMulti.h>
+
+// How long to wait for a connection to the cached access point before scanning.
+static const uint32_t FAST_CONNECT_TIMEOUT_MS = 3000;
+// How long to wait for a scanning connection before starting over.
+static const uint32_t SCAN_CONNECT_TIMEOUT_MS = 20000;
+
+ESP8266WiFiMulti wifiMulti;
+
+enum LinkState
+{
+    LinkState_Connected,
+    LinkState_FastConnecting,
+    LinkState_Scanning,
+};
+
+LinkState linkState = LinkState_Connected;
+uint32_t linkAttemptStart = 0;
+uint32_t linkDropTime = 0;
+
+// Whether the last connection started from the cached lease rather than DHCP.
+bool usingCachedLease = false;
+// The address the group membership and mDNS records were set up for.
+uint32_t linkAddress = 0;
+// Set by the SDK whenever the station gets an address, from DHCP or the configuration.
+WiFiEventHandler gotIpHandler;
+bool gotIp = false;
+
+NetworkStats linkStats = {};
+
+static void configureIp(bool useCache)
+{
+    if (config.hasStaticIp())
+    {
+        WiFi.config(IPAddress(config.static_ip), IPAddress(config.static_gateway), IPAddress(config.static_subnet), IPAddress(config.static_dns));
+    }
+    else if (useCache)
+    {
+        WiFi.config(IPAddress(config.cached_ip), IPAddress(config.cached_gateway), IPAddress(config.cached_subnet), IPAddress(config.cached_dns));
+    }
+    else
+    {
+        // All zeros turns DHCP back on.
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+    }
+}
+
+// Returns false if there is no cached network to try.
+static bool beginFastConnect()
+{
+    if (!config.hasCachedNetwork())
+    {
+        return false;
+    }
+
+    usingCachedLease = !config.hasStaticIp() && (config.cached_ip != 0);
+    configureIp(config.cached_ip != 0);
+    WiFi.begin(config.ssid, config.passphrase, config.cached_channel, config.cached_bssid);
+
+    return true;
+}
+
+static void beginScanConnect()
+{
+    usingCachedLease = false;
+    configureIp(false);
+    WiFi.begin(config.ssid, config.passphrase);
+}
+
+// Remember the network we just joined, saving the configuration only if it changed.
+static void cacheNetwork()
+{
+    const uint8_t *bssid = WiFi.BSSID();
+    const int32_t channel = WiFi.channel();
+    const uint32_t ip = config.hasStaticIp() ? 0 : static_cast<uint32_t>(WiFi.localIP());
+    const uint32_t gateway = config.hasStaticIp() ? 0 : static_cast<uint32_t>(WiFi.gatewayIP());
+    const uint32_t subnet = config.hasStaticIp() ? 0 : static_cast<uint32_t>(WiFi.subnetMask());
+    const uint32_t dns = config.hasStaticIp() ? 0 : static_cast<uint32_t>(WiFi.dnsIP());
+
+    if (!bssid)
+    {
+        return;
+    }
+
+    if ((memcmp(config.cached_bssid, bssid, sizeof(config.cached_bssid)) == 0) &&
+        (config.cached_channel == channel) &&
+        (config.cached_ip == ip) &&
+        (config.cached_gateway == gateway) &&
+        (config.cached_subnet == subnet) &&
+        (config.cached_dns == dns))
+    {
+        return;
+    }
+
+    memcpy(config.cached_bssid, bssid, sizeof(config.cached_bssid));
+    config.cached_channel = channel;
+    config.cached_ip = ip;
+    config.cached_gateway = gateway;
+    config.cached_subnet = subnet;
+    config.cached_dns = dns;
+    config.Save();
+
+    logger.info("Cached access point %s on channel %d for the next connection.", WiFi.BSSIDstr().c_str(), channel);
+}
+
+// The cached lease only spares the wait for DHCP: once connected, ask the server
+// anyway, as the lease may have expired or gone to another host since.
+static void renewLease()
+{
+    if (!usingCachedLease)
+    {
+        return;
+    }
+
+    usingCachedLease = false;
+
+    // All zeros turns DHCP back on. The cached address stays until the server answers.
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+    logger.info("Renewing the cached lease of %s with DHCP.", WiFi.localIP().toString().c_str());
+}
+
+// Cache the address the station got, and follow it if it changed.
+static void updateLease()
+{
+    cacheNetwork();
+
+    const uint32_t address = WiFi.localIP();
+
+    if (address == linkAddress)
+    {
+        return;
+    }
+
+    logger.warning("DHCP moved the address to %s.", WiFi.localIP().toString().c_str());
+    linkAddress = address;
+
+    rejoinUdpGroup();
+    restartDiscovery();
+}
+
+static void startAccessPoint()
+{
+    logger.info("WiFi has never been configured. Starting in Access-Point mode...");
+
+    IPAddress ip(192, 168, 16, 1);
+    IPAddress gateway(192, 168, 16, 1);
+    IPAddress subnet(255, 255, 255, 0);
+
+    if (!WiFi.softAPConfig(ip, gateway, subnet))
+    {
+        logger.error("Failed to configure WiFi access-point.");
+        logger.flush();
+        return;
+    }
+
+    // Uncommenting this prevents the DHCP server to send a default gateway.
+    //uint8_t mode = 0;
+    //wifi_softap_set_dhcps_offer_option(OFFER_ROUTER, &mode);
+
+    if (WiFi.softAP(Config::AP_SSID, Config::AP_PASSPHRASE))
+    {
+        logger.info("Access-Point SSID: %s", Config::AP_SSID);
+        logger.info("Access-Point passphrase: %s", Config::AP_PASSPHRASE);
+        logger.info("Access-Point IP address: %s", WiFi.softAPIP().toString().c_str());
+    }
+    else
+    {
+        logger.error("Failed to start Access-Point! Something might be wrong with the chip.");
+    }
+}
+
+static void connectStation()
+{
+    logger.info("WiFi has been configured. Starting in client mode...");
+
+    // The configuration holds the credentials: don't wear the flash out with the SDK's copy,
+    // and reconnect from the loop rather than behind our back.
+    WiFi.persistent(false);
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);
+
+    gotIpHandler = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP &)
+                                           { gotIp = true; });
+
+    const uint32_t start = millis();
+
+    if (beginFastConnect())
+    {
+        logger.info("Connecting to '%s' on channel %d...", config.ssid, config.cached_channel);
+        logger.flush();
+
+        while ((WiFi.status() != WL_CONNECTED) && (millis() - start < FAST_CONNECT_TIMEOUT_MS))
+        {
+            delay(10);
+        }
+
+        linkStats.fast_connect = (WiFi.status() == WL_CONNECTED);
+
+        if (!linkStats.fast_connect)
+        {
+            logger.warning("Cached access point is not answering: scanning instead.");
+            WiFi.disconnect();
+            config.clearCachedNetwork();
+        }
+    }
+
+    if (!linkStats.fast_connect)
+    {
+        configureIp(false);
+        wifiMulti.addAP(config.ssid, config.passphrase);
+        logger.info("Connecting to '%s'...", config.ssid);
+        logger.flush();
+
+        while (wifiMulti.run() != WL_CONNECTED)
+        {
+            digitalWrite(LED_BUILTIN, HIGH);
+            delay(125);
+            digitalWrite(LED_BUILTIN, LOW);
+            delay(125);
+        }
+    }
+
+    linkStats.connect_ms = millis() - start;
+
+    logger.info("Connected to '%s' in %ums.", config.ssid, linkStats.connect_ms);
+    logger.info("IP address: %s", WiFi.localIP().toString().c_str());
+
+    cacheNetwork();
+    linkAddress = WiFi.localIP();
+    renewLease();
+}
+
+void setupNetwork()
+{
+    logger.info("Initializing WiFi...");
+
+    if (!config.hasSSID())
+    {
+        startAccessPoint();
+    }
+    else
+    {
+        connectStation();
+    }
+}
+
+void networkLoop()
+{
+    if (!config.hasSSID())
+    {
+        return;
+    }
+
+    const bool connected = (WiFi.status() == WL_CONNECTED);
+    const uint32_t now = millis();
+
+    switch (linkState)
+    {
+    case LinkState_Connected:
+        if (connected)
+        {
+            if (gotIp)
+            {
+                gotIp = false;
+                updateLease();
+            }
+
+            return;
+        }
+
+        logger.warning("WiFi link to '%s' dropped: reconnecting.", config.ssid);
+        setStatusLed(StatusLedPattern_Blink);
+        linkDropTime = now;
+        linkAttemptStart = now;
+        linkState = beginFastConnect() ? LinkState_FastConnecting : LinkState_Scanning;
+
+        if (linkState == LinkState_Scanning)
+        {
+            beginScanConnect();
+        }
+        break;
+
+    case LinkState_FastConnecting:
+    case LinkState_Scanning:
+        if (connected)
+        {
+            linkStats.reconnects++;
+            linkStats.last_reconnect_ms = now - linkDropTime;
+            linkState = LinkState_Connected;
+            setStatusLed(StatusLedPattern_Off);
+
+            logger.info("Reconnected to '%s' in %ums.", config.ssid, linkStats.last_reconnect_ms);
+            cacheNetwork();
+
+            // Multicast memberships and mDNS records don't survive a new lease.
+            gotIp = false;
+            linkAddress = WiFi.localIP();
+            rejoinUdpGroup();
+            restartDiscovery();
+            renewLease();
+            return;
+        }
+
+        if ((linkState == LinkState_FastConnecting) && (now - linkAttemptStart >= FAST_CONNECT_TIMEOUT_MS))
+        {
+            logger.warning("Cached access point is not answering: scanning instead.");
+            linkAttemptStart = now;
+            linkState = LinkState_Scanning;
+            WiFi.disconnect();
+            beginScanConnect();
+        }
+        else if ((linkState == LinkState_Scanning) && (now - linkAttemptStart >= SCAN_CONNECT_TIMEOUT_MS))
+        {
+            linkAttemptStart = now;
+            WiFi.disconnect();
+            beginScanConnect();
+        }
+        break;
+    }
+}
+
+NetworkStats networkStats()
+{
+    NetworkStats result = linkStats;
+
+    result.connected = (WiFi.status() == WL_CONNECTED);
+    result.rssi = result.connected ? WiFi.RSSI() : 0;
+    result.channel = result.connected ? WiFi.channel() : 0;
+
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Joins the configured WiFi network, or starts an access-point if there is none.
+//
+// The access point and DHCP lease of the last connection are cached in the
+// configuration, so that the next boot connects directly to that BSSID and
+// channel with that IP, without scanning or waiting for DHCP. If that fails,
+// it falls back to a regular scan. A dropped link is reconnected the same way
+// from the loop, without blocking it. Once reconnected, the group membership
+// and the mDNS records are renewed, as the address may have changed.
+//
+// The cached lease is only used until DHCP answers: right after connecting,
+// DHCP is started in the background, and whatever lease it hands out replaces
+// the cached one, along with the group membership and mDNS records if the
+// address changed.
+void setupNetwork();
+void networkLoop();
+
+struct NetworkStats
+{
+    bool connected;
+    // How long the initial connection took, and whether it used the cached network.
+    uint32_t connect_ms;
+    bool fast_connect;
+    uint32_t reconnects;
+    uint32_t last_reconnect_ms;
+    int32_t rssi;
+    int32_t channel;
+};
+
+NetworkStats networkStats();
@@ -0,0 +1,389 @@
+#include "ota.h"
+
+#include "logger.h"
+#include "state.h"
+
+#include <Updater.h>
+
+DeltaUpdater deltaUpdater;
+
+static const uint32_t DELTA_MAGIC = 0x31444c4f; // "OLD1"
+
+enum DeltaOpcode
+{
+    DeltaOpcode_Copy = 0,
+    DeltaOpcode_Add = 1,
+    DeltaOpcode_Insert = 2,
+};
+
+static const uint8_t DELTA_OPCODE_MASK = 0x03;
+static const uint8_t DELTA_SEEK_FLAG = 0x04;
+static const uint8_t DELTA_LENGTH_SHIFT = 3;
+
+// How much of the running firmware is read at once.
+static const size_t SOURCE_CHUNK = 256;
+
+// `ESP.flashRead()` works on aligned words, hence the slack.
+alignas(4) static uint32_t sourceWords[(SOURCE_CHUNK + 8) / 4];
+
+// Reads `len` bytes of the running firmware at `offset`, which doesn't need to be aligned.
+static const uint8_t *readSource(uint32_t offset, size_t len)
+{
+    const uint32_t start = offset & ~3u;
+    const size_t span = ((offset + len + 3) & ~3u) - start;
+
+    if (!ESP.flashRead(start, sourceWords, span))
+    {
+        return nullptr;
+    }
+
+    return reinterpret_cast<const uint8_t *>(sourceWords) + (offset - start);
+}
+
+static void toHex(const uint8_t *md5, char *hex)
+{
+    for (size_t i = 0; i < 16; i++)
+    {
+        snprintf(hex + i * 2, 3, "%02x", md5[i]);
+    }
+}
+
+void DeltaUpdater::begin()
+{
+    abort();
+
+    step = Step_Header;
+    done = false;
+    lastError = DeltaUpdateError_None;
+    message = "";
+    headerSize = 0;
+    sourceCursor = 0;
+    started = millis();
+    lastStats = {};
+}
+
+void DeltaUpdater::abort()
+{
+    // Ending an unfinished update discards it.
+    if (Update.isRunning())
+    {
+        Update.end();
+    }
+
+    step = Step_Done;
+}
+
+void DeltaUpdater::clear()
+{
+    abort();
+
+    done = false;
+    lastError = DeltaUpdateError_None;
+    message = "";
+}
+
+bool DeltaUpdater::fail(DeltaUpdateError error, const char *reason)
+{
+    abort();
+
+    lastError = error;
+    message = reason;
+    logger.error("Firmware update failed after %u byte(s): %s", lastStats.received, reason);
+
+    return false;
+}
+
+bool DeltaUpdater::checkHeader()
+{
+    if (header.magic != DELTA_MAGIC)
+    {
+        return fail(DeltaUpdateError_InvalidDelta, "Not a firmware delta.");
+    }
+
+    char hex[33];
+    toHex(header.source_md5, hex);
+
+    if ((header.source_size != ESP.getSketchSize()) || (ESP.getSketchMD5() != hex))
+    {
+        return fail(DeltaUpdateError_WrongBase, "The delta is not for the running firmware.");
+    }
+
+    if (!Update.begin(header.target_size, U_FLASH))
+    {
+        logger.error("Update: %s", Update.getErrorString().c_str());
+        return fail(DeltaUpdateError_Flash, "Not enough space for the new firmware.");
+    }
+
+    toHex(header.target_md5, hex);
+    Update.setMD5(hex);
+
+    logger.info("Firmware update started: %u byte(s) from %u.", header.target_size, header.source_size);
+
+    return true;
+}
+
+bool DeltaUpdater::output(const uint8_t *data, size_t len)
+{
+    if (lastStats.written + len > header.target_size)
+    {
+        return fail(DeltaUpdateError_InvalidDelta, "The delta produces too much data.");
+    }
+
+    if (Update.write(const_cast<uint8_t *>(data), len) != len)
+    {
+        logger.error("Update: %s", Update.getErrorString().c_str());
+        return fail(DeltaUpdateError_Flash, "Could not write the new firmware.");
+    }
+
+    lastStats.written += len;
+
+    // The transfer takes a while: keep the leds alive meanwhile.
+    stateLoop();
+    yield();
+
+    return true;
+}
+
+bool DeltaUpdater::copy(uint32_t count, const uint8_t *diff)
+{
+    static uint8_t chunk[SOURCE_CHUNK];
+
+    while (count > 0)
+    {
+        const size_t n = (count < SOURCE_CHUNK) ? count : SOURCE_CHUNK;
+
+        if (sourceCursor + n > header.source_size)
+        {
+            return fail(DeltaUpdateError_InvalidDelta, "The delta reads past the running firmware.");
+        }
+
+        const uint8_t *source = readSource(sourceCursor, n);
+
+        if (source == nullptr)
+        {
+            return fail(DeltaUpdateError_Flash, "Could not read the running firmware.");
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            chunk[i] = (diff != nullptr) ? static_cast<uint8_t>(source[i] + diff[i]) : source[i];
+        }
+
+        if (!output(chunk, n))
+        {
+            return false;
+        }
+
+        sourceCursor += n;
+        count -= n;
+
+        if (diff != nullptr)
+        {
+            diff += n;
+        }
+    }
+
+    return true;
+}
+
+bool DeltaUpdater::decoded()
+{
+    if (hasSeek)
+    {
+        varint = 0;
+        varintShift = 0;
+        step = Step_Seek;
+        return true;
+    }
+
+    seek = 0;
+
+    return execute();
+}
+
+// Run the operation whose arguments were all decoded.
+bool DeltaUpdater::execute()
+{
+    if (opcode == DeltaOpcode_Insert)
+    {
+        step = (length > 0) ? Step_Payload : Step_Opcode;
+        return true;
+    }
+
+    const int64_t cursor = static_cast<int64_t>(sourceCursor) + seek;
+
+    if ((cursor < 0) || (cursor > header.source_size))
+    {
+        return fail(DeltaUpdateError_InvalidDelta, "The delta seeks outside of the running firmware.");
+    }
+
+    sourceCursor = static_cast<uint32_t>(cursor);
+
+    if (opcode == DeltaOpcode_Copy)
+    {
+        step = Step_Opcode;
+        return copy(length, nullptr);
+    }
+
+    step = (length > 0) ? Step_Payload : Step_Opcode;
+
+    return true;
+}
+
+bool DeltaUpdater::write(const uint8_t *data, size_t len)
+{
+    if (lastError != DeltaUpdateError_None)
+    {
+        return false;
+    }
+
+    lastStats.received += len;
+
+    size_t i = 0;
+
+    while (i < len)
+    {
+        switch (step)
+        {
+        case Step_Header:
+        {
+            const size_t n = min(len - i, sizeof(header) - headerSize);
+            memcpy(reinterpret_cast<uint8_t *>(&header) + headerSize, data + i, n);
+            headerSize += n;
+            i += n;
+
+            if (headerSize == sizeof(header))
+            {
+                if (!checkHeader())
+                {
+                    return false;
+                }
+
+                step = Step_Opcode;
+            }
+
+            break;
+        }
+
+        case Step_Opcode:
+        {
+            const uint8_t byte = data[i++];
+            opcode = byte & DELTA_OPCODE_MASK;
+            hasSeek = (byte & DELTA_SEEK_FLAG) != 0;
+            length = byte >> DELTA_LENGTH_SHIFT;
+
+            if ((opcode > DeltaOpcode_Insert) || ((opcode == DeltaOpcode_Insert) && hasSeek))
+            {
+                return fail(DeltaUpdateError_InvalidDelta, "Unknown delta operation.");
+            }
+
+            if (length > 0)
+            {
+                if (!decoded())
+                {
+                    return false;
+                }
+
+                break;
+            }
+
+            varint = 0;
+            varintShift = 0;
+            step = Step_Length;
+            break;
+        }
+
+        case Step_Length:
+        case Step_Seek:
+        {
+            const uint8_t byte = data[i++];
+
+            if (varintShift > 28)
+            {
+                return fail(DeltaUpdateError_InvalidDelta, "Invalid delta operation.");
+            }
+
+            varint |= static_cast<uint32_t>(byte & 0x7f) << varintShift;
+            varintShift += 7;
+
+            if (byte & 0x80)
+            {
+                break;
+            }
+
+            bool ok;
+
+            if (step == Step_Length)
+            {
+                length = varint;
+                ok = decoded();
+            }
+            else
+            {
+                seek = static_cast<int32_t>(varint >> 1) ^ -static_cast<int32_t>(varint & 1);
+                ok = execute();
+            }
+
+            if (!ok)
+            {
+                return false;
+            }
+
+            break;
+        }
+
+        case Step_Payload:
+        {
+            const size_t n = min(len - i, static_cast<size_t>(length));
+            const bool ok = (opcode == DeltaOpcode_Insert) ? output(data + i, n) : copy(n, data + i);
+
+            if (!ok)
+            {
+                return false;
+            }
+
+            i += n;
+            length -= n;
+
+            if (length == 0)
+            {
+                step = Step_Opcode;
+            }
+
+            break;
+        }
+
+        case Step_Done:
+            return fail(DeltaUpdateError_InvalidDelta, "Unexpected data after the delta.");
+        }
+    }
+
+    return true;
+}
+
+bool DeltaUpdater::end()
+{
+    if (lastError != DeltaUpdateError_None)
+    {
+        return false;
+    }
+
+    if ((step != Step_Opcode) || (lastStats.written != header.target_size))
+    {
+        return fail(DeltaUpdateError_InvalidDelta, "The delta is truncated.");
+    }
+
+    step = Step_Done;
+
+    if (!Update.end())
+    {
+        logger.error("Update: %s", Update.getErrorString().c_str());
+        return fail(DeltaUpdateError_Flash, "The new firmware doesn't match its checksum.");
+    }
+
+    done = true;
+    lastStats.duration_ms = millis() - started;
+    logger.info("Firmware update ready: received %u byte(s) for %u in %ums.", lastStats.received, lastStats.written, lastStats.duration_ms);
+
+    return true;
+}
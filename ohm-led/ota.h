@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+
+enum DeltaUpdateError
+{
+    DeltaUpdateError_None = 0,
+    // The delta is malformed or truncated.
+    DeltaUpdateError_InvalidDelta = 1,
+    // The delta was made against another firmware than the running one.
+    DeltaUpdateError_WrongBase = 2,
+    // The new firmware could not be written, or doesn't match its checksum.
+    DeltaUpdateError_Flash = 3,
+};
+
+// A delta starts with a 44-byte header, little-endian:
+// - the magic "OLD1",
+// - the size and MD5 of the firmware it applies to, which must be the running one,
+// - the size and MD5 of the firmware it produces.
+//
+// Then comes a stream of operations. The opcode byte holds the operation in
+// its low 2 bits, a seek flag in bit 2, and the length in the upper 5 bits,
+// or 0 if it follows as a LEB128 varint. With the seek flag, a zigzag varint
+// follows, that moves the source cursor, an offset in the running firmware,
+// before the operation:
+// - Copy (0): copy `length` bytes from the source cursor.
+// - Add (1): followed by `length` bytes, each added to the byte at the source cursor.
+// - Insert (2): followed by `length` bytes, written as is. It never seeks.
+//
+// Copy and Add advance the source cursor by `length`. Small changes in a big
+// image, like the addresses shifted by a few bytes all over the code, then
+// take a few bytes each. See tools/ohm-led-ota.py for the generator.
+struct DeltaHeader
+{
+    uint32_t magic;
+    uint32_t source_size;
+    uint8_t source_md5[16];
+    uint32_t target_size;
+    uint8_t target_md5[16];
+};
+
+static_assert(sizeof(DeltaHeader) == 44, "DeltaHeader must stay 44 bytes");
+
+struct DeltaUpdateStats
+{
+    uint32_t received;
+    uint32_t written;
+    uint32_t duration_ms;
+};
+
+// Applies a firmware delta as it is received, without buffering it.
+//
+// The new firmware is written to the free flash space through `Update`, and
+// only replaces the running one on the next restart. Only a small source
+// buffer and the state of the current operation are kept, whatever the size
+// of the delta. Long operations call `stateLoop()` as they go, so the leds
+// keep rendering during the transfer.
+class DeltaUpdater
+{
+public:
+    void begin();
+    // Returns false once the update failed; the rest of the delta is then ignored.
+    bool write(const uint8_t *data, size_t len);
+    // Check that the whole firmware was produced, and commit it.
+    bool end();
+    void abort();
+
+    DeltaUpdateError error() const
+    {
+        return lastError;
+    }
+
+    const char *errorMessage() const
+    {
+        return message;
+    }
+
+    DeltaUpdateStats stats() const
+    {
+        return lastStats;
+    }
+
+    // Whether the last update went through `end()`: the whole delta was applied and the new
+    // firmware was committed, ready to run on the next restart.
+    bool completed() const
+    {
+        return done;
+    }
+
+    // Forget the outcome of the last update, once it was reported.
+    void clear();
+
+private:
+    enum Step
+    {
+        Step_Header,
+        Step_Opcode,
+        Step_Length,
+        Step_Seek,
+        Step_Payload,
+        Step_Done,
+    };
+
+    bool fail(DeltaUpdateError error, const char *message);
+    bool checkHeader();
+    // The length is known: read the seek if any, or run the operation.
+    bool decoded();
+    bool execute();
+    bool copy(uint32_t length, const uint8_t *diff);
+    bool output(const uint8_t *data, size_t len);
+
+    Step step = Step_Done;
+    bool done = false;
+    DeltaUpdateError lastError = DeltaUpdateError_None;
+    const char *message = "";
+
+    DeltaHeader header = {};
+    size_t headerSize = 0;
+
+    uint8_t opcode = 0;
+    bool hasSeek = false;
+    uint32_t varint = 0;
+    uint8_t varintShift = 0;
+    uint32_t length = 0;
+    int32_t seek = 0;
+    uint32_t sourceCursor = 0;
+
+    uint32_t started = 0;
+    DeltaUpdateStats lastStats = {};
+};
+
+extern DeltaUpdater deltaUpdater;
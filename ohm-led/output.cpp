@@ -0,0 +1,131 @@
+#include "output.h"
+
+#include "power.h"
+
+typedef CLEDController &(*AddOutputFunction)(CRGB *leds, int count);
+
+template <template <uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, EOrder ORDER>
+CLEDController &addClocklessOutput(CRGB *leds, int count)
+{
+    return FastLED.addLeds<CHIPSET, LEDS_DATA_PIN, ORDER>(leds, count);
+}
+
+template <ESPIChipsets CHIPSET, EOrder ORDER>
+CLEDController &addClockedOutput(CRGB *leds, int count)
+{
+    return FastLED.addLeds<CHIPSET, LEDS_DATA_PIN, LEDS_CLOCK_PIN, ORDER, DATA_RATE_MHZ(LEDS_SPI_DATA_RATE_MHZ)>(leds, count);
+}
+
+struct ChipsetInfo
+{
+    const char *name;
+
+    // Clockless chipsets: the duration of a bit. Clocked chipsets: 0, the rate is LEDS_SPI_DATA_RATE_MHZ.
+    uint32_t bit_time_ns;
+    uint8_t bits_per_led;
+
+    // Clockless chipsets: the latch time. Clocked chipsets: the size of the start and end frames, in bits.
+    uint32_t frame_overhead;
+
+    AddOutputFunction add[LedColorOrder_Count];
+};
+
+// Indexed by `LedChipset`, then by `LedColorOrder`.
+const ChipsetInfo chipsets[LedChipset_Count] = {
+    {"ws2812", 1250, 24, 50, {addClocklessOutput<WS2812, GRB>, addClocklessOutput<WS2812, RGB>, addClocklessOutput<WS2812, BGR>}},
+    {"ws2811", 1250, 24, 50, {addClocklessOutput<WS2811, GRB>, addClocklessOutput<WS2811, RGB>, addClocklessOutput<WS2811, BGR>}},
+    {"sk6812", 1250, 24, 80, {addClocklessOutput<SK6812, GRB>, addClocklessOutput<SK6812, RGB>, addClocklessOutput<SK6812, BGR>}},
+    {"apa102", 0, 32, 64, {addClockedOutput<APA102, GRB>, addClockedOutput<APA102, RGB>, addClockedOutput<APA102, BGR>}},
+    {"sk9822", 0, 32, 96, {addClockedOutput<SK9822, GRB>, addClockedOutput<SK9822, RGB>, addClockedOutput<SK9822, BGR>}},
+};
+
+uint32_t lastShowMicros = 0;
+
+const char *const colorOrderNames[LedColorOrder_Count] = {
+    "grb",
+    "rgb",
+    "bgr",
+};
+
+CLEDController &addOutput(CRGB *leds, uint16_t count)
+{
+    const ChipsetInfo &info = chipsets[config.led_chipset];
+
+    return info.add[config.led_color_order](leds, count);
+}
+
+uint32_t outputWireTimeMicros(uint16_t count)
+{
+    const ChipsetInfo &info = chipsets[config.led_chipset];
+
+    if (info.bit_time_ns > 0)
+    {
+        return ((static_cast<uint32_t>(count) * info.bits_per_led * info.bit_time_ns) / 1000) + info.frame_overhead;
+    }
+
+    // Clocked chipsets also need half a clock per led at the end to push the data through.
+    const uint32_t bits = (static_cast<uint32_t>(count) * info.bits_per_led) + info.frame_overhead + (count / 2);
+
+    return bits / LEDS_SPI_DATA_RATE_MHZ;
+}
+
+void showOutput()
+{
+    const uint32_t begin = micros();
+
+    powerBeginShow();
+    FastLED.show();
+
+    lastShowMicros = micros() - begin;
+}
+
+uint32_t outputShowMicros()
+{
+    return lastShowMicros;
+}
+
+const char *chipsetToString(LedChipset chipset)
+{
+    if (chipset < 0 || chipset >= LedChipset_Count)
+    {
+        return chipsets[LedChipset_WS2812].name;
+    }
+
+    return chipsets[chipset].name;
+}
+
+LedChipset chipsetFromString(const String &s)
+{
+    for (int i = 0; i < LedChipset_Count; i++)
+    {
+        if (s == chipsets[i].name)
+        {
+            return static_cast<LedChipset>(i);
+        }
+    }
+
+    return LedChipset_Count;
+}
+
+const char *colorOrderToString(LedColorOrder order)
+{
+    if (order < 0 || order >= LedColorOrder_Count)
+    {
+        return colorOrderNames[LedColorOrder_GRB];
+    }
+
+    return colorOrderNames[order];
+}
+
+LedColorOrder colorOrderFromString(const String &s)
+{
+    for (int i = 0; i < LedColorOrder_Count; i++)
+    {
+        if (s == colorOrderNames[i])
+        {
+            return static_cast<LedColorOrder>(i);
+        }
+    }
+
+    return LedColorOrder_Count;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include "config.h"
+
+#include <FastLED.h>
+
+// Register the led controller for the configured chipset and color order.
+//
+// FastLED needs both as template parameters, so every supported combination is
+// instantiated once at compile time and picked from a table at runtime. Pins
+// remain compile-time constants.
+CLEDController &addOutput(CRGB *leds, uint16_t count);
+
+// The time it takes to send a frame of `count` leds over the wire at the nominal
+// rate of the chipset, latch included.
+//
+// Clocked chipsets are bit-banged on the data and clock pins, which doesn't
+// reach `LEDS_SPI_DATA_RATE_MHZ`: for them, this is a lower bound. See
+// `outputShowMicros()` for the actual time.
+uint32_t outputWireTimeMicros(uint16_t count);
+
+// Send the frame to the leds, timing it.
+void showOutput();
+
+// How long the last `showOutput()` took, sending the frame over the wire included.
+uint32_t outputShowMicros();
+
+const char *chipsetToString(LedChipset chipset);
+LedChipset chipsetFromString(const String &s);
+const char *colorOrderToString(LedColorOrder order);
+LedColorOrder colorOrderFromString(const String &s);
@@ -0,0 +1,184 @@
+#include "power.h"
+
+#include "logger.h"
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+extern "C"
+{
+#include <user_interface.h>
+}
+
+// The longest the loop can be unresponsive while idle.
+static const uint32_t IDLE_SLEEP_MS = 50;
+
+// How long to stay fully awake after a network request.
+static const uint32_t ACTIVITY_HOLD_MS = 2000;
+
+// The window over which the idle ratio is computed.
+static const uint32_t STATS_WINDOW_MS = 10000;
+
+static const uint8_t IDLE_CPU_MHZ = 80;
+static const uint8_t ACTIVE_CPU_MHZ = F_CPU / 1000000L;
+static const uint8_t HEAVY_CPU_MHZ = 160;
+
+bool staticFrame = false;
+bool powerIdle = false;
+uint32_t lastNetworkActivity = 0;
+
+uint32_t windowStart = 0;
+uint32_t windowIdleMs = 0;
+uint8_t idlePercent = 0;
+uint32_t idleSleeps = 0;
+uint32_t sleepStart = 0;
+
+// The first event since the controller went idle, until a frame answers it.
+bool wakePending = false;
+uint32_t wakeEventTime = 0;
+uint32_t wakes = 0;
+uint32_t lastWakeLatencyMs = 0;
+uint32_t maxWakeLatencyMs = 0;
+
+void setCpuFrequency(uint8_t mhz)
+{
+    if (system_get_cpu_freq() != mhz)
+    {
+        system_update_cpu_freq(mhz);
+    }
+}
+
+void enterIdle()
+{
+    if (powerIdle)
+    {
+        return;
+    }
+
+    powerIdle = true;
+    setCpuFrequency(IDLE_CPU_MHZ);
+
+    // An access-point must keep its radio on for its clients.
+    if (WiFi.getMode() == WIFI_STA)
+    {
+        WiFi.setSleepMode(WIFI_LIGHT_SLEEP);
+    }
+}
+
+void leaveIdle()
+{
+    if (!powerIdle)
+    {
+        return;
+    }
+
+    powerIdle = false;
+    setCpuFrequency(ACTIVE_CPU_MHZ);
+
+    if (WiFi.getMode() == WIFI_STA)
+    {
+        WiFi.setSleepMode(WIFI_MODEM_SLEEP);
+    }
+}
+
+void setupPower()
+{
+    if (ACTIVE_CPU_MHZ <= IDLE_CPU_MHZ)
+    {
+        logger.info("Built for %d MHz: only the heavy effects run at %d MHz, idle power saving only sleeps.", ACTIVE_CPU_MHZ, HEAVY_CPU_MHZ);
+    }
+
+    setCpuFrequency(ACTIVE_CPU_MHZ);
+    windowStart = millis();
+    lastNetworkActivity = millis();
+}
+
+void powerBeginFrame(bool heavy)
+{
+    leaveIdle();
+
+    if (heavy)
+    {
+        setCpuFrequency(HEAVY_CPU_MHZ);
+    }
+}
+
+void powerBeginShow()
+{
+    setCpuFrequency(ACTIVE_CPU_MHZ);
+}
+
+void powerSetFrameStatic(bool isStatic)
+{
+    staticFrame = isStatic;
+
+    if (!wakePending)
+    {
+        return;
+    }
+
+    wakePending = false;
+    wakes++;
+    lastWakeLatencyMs = millis() - wakeEventTime;
+    maxWakeLatencyMs = max(maxWakeLatencyMs, lastWakeLatencyMs);
+}
+
+void powerNoteActivity()
+{
+    // A request is only seen once the loop runs again: it may have arrived as the last sleep started.
+    powerNoteActivityAt(powerIdle ? sleepStart : millis());
+}
+
+void powerNoteActivityAt(uint32_t at)
+{
+    if (powerIdle && !wakePending)
+    {
+        wakePending = true;
+        wakeEventTime = at;
+    }
+
+    lastNetworkActivity = millis();
+    leaveIdle();
+}
+
+void powerLoop()
+{
+    const uint32_t now = millis();
+
+    if (now - windowStart >= STATS_WINDOW_MS)
+    {
+        idlePercent = (windowIdleMs * 100) / (now - windowStart);
+        windowStart = now;
+        windowIdleMs = 0;
+    }
+
+    if (!staticFrame || (now - lastNetworkActivity < ACTIVITY_HOLD_MS))
+    {
+        leaveIdle();
+        return;
+    }
+
+    enterIdle();
+
+    // With light sleep enabled, the SDK suspends the CPU and radio during delay().
+    sleepStart = now;
+    delay(IDLE_SLEEP_MS);
+
+    windowIdleMs += millis() - now;
+    idleSleeps++;
+}
+
+PowerStats powerStats()
+{
+    PowerStats stats;
+
+    stats.idle = powerIdle;
+    stats.cpu_mhz = system_get_cpu_freq();
+    stats.idle_percent = idlePercent;
+    stats.sleeps = idleSleeps;
+    stats.wakes = wakes;
+    stats.last_wake_latency_ms = lastWakeLatencyMs;
+    stats.max_wake_latency_ms = maxWakeLatencyMs;
+
+    return stats;
+}
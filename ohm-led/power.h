@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// Saves power while the frame is static and nothing happens on the network.
+//
+// When idle, the governor drops the CPU to 80 MHz and sleeps in short slices
+// with WiFi light sleep enabled. Anything else brings the CPU back to F_CPU,
+// and the heavy effects (fire, fire-2d and plasma) are computed at 160 MHz
+// even on an 80 MHz build. FastLED times clockless protocols in CPU cycles at
+// F_CPU, so the frequency is always back to F_CPU when a frame is sent.
+//
+// The wake latency is measured from the event that woke the controller up
+// (the button's first edge, the arrival of an MQTT message, or for the
+// requests that are only seen once the loop runs, the start of the sleep they
+// arrived during) to the next frame. The ESP8266 can't measure its own
+// current: the idle ratio is what the governor reports instead.
+void setupPower();
+void powerLoop();
+
+// Called by the renderer: before computing a frame to send, right before
+// sending it, and on every frame whether sent or skipped.
+void powerBeginFrame(bool heavy);
+void powerBeginShow();
+void powerSetFrameStatic(bool isStatic);
+
+// Called on any network request, to stay responsive for a little while.
+void powerNoteActivity();
+// The same, for an event known to have happened at `at`, in `millis()`.
+void powerNoteActivityAt(uint32_t at);
+
+struct PowerStats
+{
+    bool idle;
+    uint8_t cpu_mhz;
+    uint8_t idle_percent;
+    uint32_t sleeps;
+    uint32_t wakes;
+    uint32_t last_wake_latency_ms;
+    uint32_t max_wake_latency_ms;
+};
+
+PowerStats powerStats();
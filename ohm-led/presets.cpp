@@ -0,0 +1,174 @@
+#include "presets.h"
+
+#include "logger.h"
+#include "udp.h"
+
+#include <LittleFS.h>
+
+Presets presets;
+
+const char *PRESETS_PATH = "/presets.bin";
+
+bool Presets::Load()
+{
+    File file = LittleFS.open(PRESETS_PATH, "r");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    bool result = (file.read(reinterpret_cast<uint8_t *>(&magic), sizeof(magic)) == sizeof(magic)) && (magic == MAGIC_VALUE);
+
+    if (result)
+    {
+        result = (file.read(reinterpret_cast<uint8_t *>(slots), sizeof(slots)) == sizeof(slots));
+    }
+
+    file.close();
+
+    if (!result)
+    {
+        memset(slots, 0, sizeof(slots));
+    }
+
+    return result;
+}
+
+bool Presets::Save() const
+{
+    File file = LittleFS.open(PRESETS_PATH, "w");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    const uint32_t magic = MAGIC_VALUE;
+    bool result = (file.write(reinterpret_cast<const uint8_t *>(&magic), sizeof(magic)) == sizeof(magic));
+    result = result && (file.write(reinterpret_cast<const uint8_t *>(slots), sizeof(slots)) == sizeof(slots));
+
+    file.close();
+
+    return result;
+}
+
+bool Presets::store(uint8_t id, const char *name, const StateSnapshot &state)
+{
+    if (id >= MAX_PRESETS)
+    {
+        return false;
+    }
+
+    Preset &preset = slots[id];
+
+    snprintf(preset.name, sizeof(preset.name), "%s", name);
+    preset.mode = state.mode;
+    preset.hue = state.hue;
+    preset.saturation = state.saturation;
+    preset.value = state.value;
+    preset.easing = state.easing;
+    preset.fire_cooling = state.fire_cooling;
+    preset.fire_sparking = state.fire_sparking;
+    preset.used = 1;
+    preset.period = state.period;
+    preset.transition = state.transition;
+
+    return Save();
+}
+
+bool Presets::recall(uint8_t id)
+{
+    if (!isUsed(id))
+    {
+        return false;
+    }
+
+    const Preset &preset = slots[id];
+
+    if ((preset.mode >= StateMode_Count) || (preset.easing >= EaseCount))
+    {
+        return false;
+    }
+
+    StateUpdate update;
+    update.fields = StateField_Mode | StateField_Hue | StateField_Saturation | StateField_Value | StateField_Easing |
+                    StateField_Period | StateField_FireCooling | StateField_FireSparking | StateField_Transition;
+    update.mode = static_cast<StateMode>(preset.mode);
+    update.hue = preset.hue;
+    update.saturation = preset.saturation;
+    update.value = preset.value;
+    update.easing = static_cast<Easing>(preset.easing);
+    update.fire_cooling = preset.fire_cooling;
+    update.fire_sparking = preset.fire_sparking;
+    update.period = preset.period;
+    update.transition = preset.transition;
+
+    if (submitToGroup(update) != StateUpdateResult_Success)
+    {
+        return false;
+    }
+
+    last = id;
+
+    logger.info("Recalled preset %d (%s).", id, preset.name);
+
+    return true;
+}
+
+bool Presets::remove(uint8_t id)
+{
+    if (!isUsed(id))
+    {
+        return false;
+    }
+
+    memset(&slots[id], 0, sizeof(slots[id]));
+
+    return Save();
+}
+
+bool Presets::cycle()
+{
+    for (uint8_t i = 1; i <= MAX_PRESETS; i++)
+    {
+        const uint8_t id = (last + i) % MAX_PRESETS;
+
+        if (slots[id].used)
+        {
+            return recall(id);
+        }
+    }
+
+    return false;
+}
+
+uint8_t Presets::count() const
+{
+    uint8_t result = 0;
+
+    for (const Preset &preset : slots)
+    {
+        if (preset.used)
+        {
+            result++;
+        }
+    }
+
+    return result;
+}
+
+void setupPresets()
+{
+    if (!LittleFS.begin())
+    {
+        logger.error("Failed to mount the filesystem: presets won't be persisted.");
+        return;
+    }
+
+    if (presets.Load())
+    {
+        logger.info("Loaded %d preset(s).", presets.count());
+    }
+}
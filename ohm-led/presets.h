@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include "state.h"
+
+// A compact binary snapshot of the visual fields of a `State`.
+struct Preset
+{
+    char name[16];
+    uint8_t mode;
+    uint8_t hue;
+    uint8_t saturation;
+    uint8_t value;
+    uint8_t easing;
+    uint8_t fire_cooling;
+    uint8_t fire_sparking;
+    uint8_t used;
+    uint32_t period;
+    uint32_t transition;
+};
+
+// Preset slots, kept in RAM for instant recall and persisted to flash on change.
+class Presets
+{
+public:
+    static const uint8_t MAX_PRESETS = 16;
+    static const uint32_t MAGIC_VALUE = 0x0B5E7001;
+
+    bool Load();
+    bool Save() const;
+
+    bool store(uint8_t id, const char *name, const StateSnapshot &state);
+    // Recalling a preset is a state write like any other: the group follows.
+    bool recall(uint8_t id);
+    bool remove(uint8_t id);
+
+    // Recall the next used preset after the last recalled one, wrapping around.
+    bool cycle();
+
+    bool isUsed(uint8_t id) const
+    {
+        return (id < MAX_PRESETS) && slots[id].used;
+    }
+
+    const Preset &get(uint8_t id) const
+    {
+        return slots[id];
+    }
+
+    uint8_t count() const;
+
+private:
+    Preset slots[MAX_PRESETS] = {};
+    uint8_t last = MAX_PRESETS - 1;
+};
+
+extern Presets presets;
+
+void setupPresets();
@@ -1,3 +0,0 @@
-#pragma once
-
-void resetLoop();
\ No newline at end of file
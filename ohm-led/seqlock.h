@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// A sequence lock around a copy of `T`.
+//
+// There must be a single writer at a time, which never waits. Readers never
+// block the writer: they copy the value and retry if a write happened in the
+// meantime, so they always get a version that was published as a whole.
+//
+// The value is stored as words of relaxed atomics, ordered by fences around
+// the sequence number, so that concurrent copies are well defined rather than
+// racy reads of a plain struct.
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock values are copied word by word");
+
+public:
+    SeqLock()
+    {
+        write(T());
+    }
+
+    void write(const T &value)
+    {
+        uint32_t words[WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+
+        const uint32_t begin = sequence.load(std::memory_order_relaxed) + 1;
+
+        // An odd sequence number tells readers a write is in progress.
+        sequence.store(begin, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; i++)
+        {
+            data[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        sequence.store(begin + 1, std::memory_order_release);
+    }
+
+    // Copy the last published value, and return its version.
+    //
+    // This spins while the sequence number is odd. An interrupt that
+    // preempted the writer would spin forever, so never call it from an ISR.
+    uint32_t read(T &value) const
+    {
+        uint32_t words[WORDS];
+
+        for (;;)
+        {
+            const uint32_t begin = sequence.load(std::memory_order_acquire);
+
+            if (begin & 1)
+            {
+                continue;
+            }
+
+            for (size_t i = 0; i < WORDS; i++)
+            {
+                words[i] = data[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (sequence.load(std::memory_order_relaxed) == begin)
+            {
+                memcpy(&value, words, sizeof(T));
+                return begin / 2;
+            }
+        }
+    }
+
+    T read() const
+    {
+        T value;
+        read(value);
+
+        return value;
+    }
+
+    // Increments with every write.
+    uint32_t version() const
+    {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> data[WORDS];
+};
@@ -0,0 +1,85 @@
+#include "sparse.h"
+
+SparseCanvas sparseCanvas;
+
+void SparseCanvas::begin(CRGB *target, uint16_t count)
+{
+    if (!cleared || (target != leds) || (count != ledCount))
+    {
+        fill_solid(target, count, CRGB::Black);
+        leds = target;
+        ledCount = count;
+        cleared = true;
+    }
+    else
+    {
+        for (size_t i = 0; i < used; i++)
+        {
+            fill_solid(leds + spans[i].start, spans[i].end - spans[i].start, CRGB::Black);
+        }
+    }
+
+    used = 0;
+}
+
+void SparseCanvas::set(uint16_t index, const CRGB &color)
+{
+    if (index >= ledCount)
+    {
+        return;
+    }
+
+    touch(index);
+    leds[index] = color;
+}
+
+void SparseCanvas::add(uint16_t index, const CRGB &color)
+{
+    if (index >= ledCount)
+    {
+        return;
+    }
+
+    touch(index);
+    leds[index] += color;
+}
+
+void SparseCanvas::touch(uint16_t index)
+{
+    // Objects are drawn led after led, so the last span is usually the one to grow.
+    for (size_t i = used; i-- > 0;)
+    {
+        LedSpan &span = spans[i];
+
+        if ((index + 1 >= span.start) && (index <= span.end))
+        {
+            span.start = min(span.start, index);
+            span.end = max(span.end, static_cast<uint16_t>(index + 1));
+            return;
+        }
+    }
+
+    if (used < MAX_SPANS)
+    {
+        spans[used++] = {index, static_cast<uint16_t>(index + 1)};
+        return;
+    }
+
+    // Out of spans: grow the closest one over the gap.
+    size_t closest = 0;
+    uint16_t closestDistance = UINT16_MAX;
+
+    for (size_t i = 0; i < used; i++)
+    {
+        const uint16_t distance = (index < spans[i].start) ? spans[i].start - index : index - spans[i].end;
+
+        if (distance < closestDistance)
+        {
+            closest = i;
+            closestDistance = distance;
+        }
+    }
+
+    spans[closest].start = min(spans[closest].start, index);
+    spans[closest].end = max(spans[closest].end, static_cast<uint16_t>(index + 1));
+}
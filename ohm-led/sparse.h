@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <FastLED.h>
+
+// A range of leds, from `start` included to `end` excluded.
+struct LedSpan
+{
+    uint16_t start;
+    uint16_t end;
+};
+
+// Renders effects that only light a few leds, like a moving dot or a comet.
+//
+// Rather than writing every led on each frame, these effects draw through the
+// canvas, which remembers the spans they touched. The next frame only blacks
+// out those spans before drawing again, so the cost scales with the lit leds
+// rather than the strip length. When the spans don't fit, the closest ones are
+// merged: a few more leds get cleared than needed, which is still correct.
+class SparseCanvas
+{
+public:
+    static const size_t MAX_SPANS = 16;
+
+    // Start a frame into `leds`, clearing what the previous frame drew.
+    void begin(CRGB *leds, uint16_t count);
+
+    // Something else wrote the leds: the next frame clears them all.
+    void invalidate()
+    {
+        cleared = false;
+    }
+
+    void set(uint16_t index, const CRGB &color);
+
+    // Add `color` to the led, so that overlapping objects light each other up.
+    void add(uint16_t index, const CRGB &color);
+
+    uint16_t count() const
+    {
+        return ledCount;
+    }
+
+private:
+    void touch(uint16_t index);
+
+    CRGB *leds = nullptr;
+    uint16_t ledCount = 0;
+    bool cleared = false;
+
+    LedSpan spans[MAX_SPANS];
+    size_t used = 0;
+};
+
+extern SparseCanvas sparseCanvas;
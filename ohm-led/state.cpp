@@ -1,11 +1,19 @@
 #include "state.h"
 
+#include "compositor.h"
 #include "config.h"
 #include "easing.h"
+#include "gamma.h"
+#include "journal.h"
+#include "layout.h"
+#include "logger.h"
+#include "output.h"
+#include "power.h"
+#include "sparse.h"
+#include "trace.h"
 
 #include <map>
 
-#define FASTLED_ESP8266_NODEMCU_PIN_ORDER
 #include <FastLED.h>
 
 const std::map<StateMode, const char *> modeNames = {
@@ -16,6 +24,11 @@ const std::map<StateMode, const char *> modeNames = {
     {StateMode_Rainbow, "rainbow"},
     {StateMode_KnightRider, "knight-rider"},
     {StateMode_Fire, "fire"},
+    {StateMode_Plasma, "plasma"},
+    {StateMode_Fire2D, "fire-2d"},
+    {StateMode_DiagonalRainbow, "diagonal-rainbow"},
+    {StateMode_Comet, "comet"},
+    {StateMode_MultiBall, "multi-ball"},
 };
 
 const std::map<Easing, const char *> easingNames = {
@@ -92,106 +105,458 @@ String easingToString(Easing easing)
     return it->second;
 }
 
-StateUpdateResult State::fromJsonDocument(const StaticJsonDocument<256> &json)
+template <typename T>
+bool readJsonField(const StaticJsonDocument<256> &json, const char *key, T &out)
+{
+    const auto variant = json[key];
+
+    if (!variant.template is<T>())
+    {
+        return false;
+    }
+
+    out = variant.template as<T>();
+
+    return true;
+}
+
+void StateUpdate::fromJsonDocument(const StaticJsonDocument<256> &json)
+{
+    fields = 0;
+
+    // Unknown names are kept as out-of-range values, so that `State::submit()` rejects them.
+    if (json["mode"].is<const char *>())
+    {
+        mode = modeFromString(json["mode"].as<const char *>());
+        fields |= StateField_Mode;
+    }
+
+    if (json["easing"].is<const char *>())
+    {
+        easing = easingFromString(json["easing"].as<const char *>());
+        fields |= StateField_Easing;
+    }
+
+    fields |= readJsonField(json, "revision", revision) ? StateField_Revision : 0;
+    fields |= readJsonField(json, "hue", hue) ? StateField_Hue : 0;
+    fields |= readJsonField(json, "saturation", saturation) ? StateField_Saturation : 0;
+    fields |= readJsonField(json, "value", value) ? StateField_Value : 0;
+    fields |= readJsonField(json, "period", period) ? StateField_Period : 0;
+    fields |= readJsonField(json, "fire-cooling", fire_cooling) ? StateField_FireCooling : 0;
+    fields |= readJsonField(json, "fire-sparking", fire_sparking) ? StateField_FireSparking : 0;
+    fields |= readJsonField(json, "transition", transition) ? StateField_Transition : 0;
+}
+
+// Counters for `stateUpdateStats()`, with the rates measured over windows of about a second.
+//
+// Writers only ever increment `submittedUpdates`, the rest belongs to the render loop.
+static const uint32_t UPDATE_RATE_WINDOW_MS = 1000;
+
+std::atomic<uint32_t> submittedUpdates{0};
+std::atomic<uint32_t> appliedUpdates{0};
+std::atomic<uint32_t> submittedUpdatesPerSecond{0};
+std::atomic<uint32_t> appliedUpdatesPerSecond{0};
+uint32_t updateRateWindowStart = 0;
+uint32_t updateRateWindowSubmitted = 0;
+uint32_t updateRateWindowApplied = 0;
+
+static void updateRates()
+{
+    const uint32_t elapsed = millis() - updateRateWindowStart;
+
+    if (elapsed < UPDATE_RATE_WINDOW_MS)
+    {
+        return;
+    }
+
+    const uint32_t submitted = submittedUpdates.load(std::memory_order_relaxed);
+    const uint32_t applied = appliedUpdates.load(std::memory_order_relaxed);
+
+    submittedUpdatesPerSecond.store(((submitted - updateRateWindowSubmitted) * 1000) / elapsed, std::memory_order_relaxed);
+    appliedUpdatesPerSecond.store(((applied - updateRateWindowApplied) * 1000) / elapsed, std::memory_order_relaxed);
+    updateRateWindowStart += elapsed;
+    updateRateWindowSubmitted = submitted;
+    updateRateWindowApplied = applied;
+}
+
+StateUpdateStats stateUpdateStats()
+{
+    StateUpdateStats stats;
+    stats.submitted = submittedUpdates.load(std::memory_order_relaxed);
+    stats.applied = appliedUpdates.load(std::memory_order_relaxed);
+    stats.submitted_per_second = submittedUpdatesPerSecond.load(std::memory_order_relaxed);
+    stats.applied_per_second = appliedUpdatesPerSecond.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+State::State()
+{
+    writerTarget = *this;
+    target.write(writerTarget);
+    appliedVersion = target.version();
+    published.write({*this, appliedVersion});
+}
+
+void State::lockWriters()
+{
+    // Writers only hold the lock for a few copies, and never from an interrupt.
+    while (writersLock.test_and_set(std::memory_order_acquire))
+    {
+    }
+}
+
+void State::unlockWriters()
+{
+    writersLock.clear(std::memory_order_release);
+}
+
+StateSnapshot State::snapshot() const
+{
+    return published.read().state;
+}
+
+uint32_t State::version() const
+{
+    return published.read().targetVersion;
+}
+
+uint64_t State::pendingRevision() const
+{
+    return target.read().revision;
+}
+
+StateUpdateResult State::submit(const StateUpdate &update)
+{
+    return accept(update, nullptr);
+}
+
+StateUpdateResult State::submitReplica(const StateUpdate &update, uint64_t revision)
 {
-    const StateMode newMode = modeFromString(json["mode"] | modeToString(mode));
-    const Easing newEasing = easingFromString(json["easing"] | easingToString(easing));
-    uint64_t requestRevision = json["revision"] | revision;
+    return accept(update, &revision);
+}
 
-    if (newMode == StateMode_Count)
+StateUpdateResult State::accept(const StateUpdate &update, const uint64_t *revision)
+{
+    if ((update.fields & StateField_Mode) && ((update.mode < 0) || (update.mode >= StateMode_Count)))
     {
         return StateUpdateResult_InvalidInput;
     }
 
-    if (newEasing == EaseCount)
+    if ((update.fields & StateField_Easing) && ((update.easing < 0) || (update.easing >= EaseCount)))
     {
         return StateUpdateResult_InvalidInput;
     }
 
-    if (requestRevision != revision)
+    lockWriters();
+
+    // The writers' target is the latest state anyone could have seen.
+    if ((update.fields & StateField_Revision) && (update.revision != writerTarget.revision))
     {
-        Serial.printf("Ignoring outdated state with revision %ul when %ul was expected.", requestRevision, revision);
+        const uint64_t expected = writerTarget.revision;
+        unlockWriters();
+        logger.warning("Ignoring outdated state with revision %llu when %llu was expected.", static_cast<unsigned long long>(update.revision), static_cast<unsigned long long>(expected));
         return StateUpdateResult_OutdatedInput;
     }
 
-    mode = newMode;
-    hue = json["hue"] | hue;
-    saturation = json["saturation"] | saturation;
-    value = json["value"] | value;
-    easing = newEasing;
-    period = json["period"] | period;
-    fire_cooling = json["fire-cooling"] | fire_cooling;
-    fire_sparking = json["fire-sparking"] | fire_sparking;
+    mergeTarget(update, revision ? *revision : writerTarget.revision + 1);
+    unlockWriters();
 
-    revision++;
+    submittedUpdates.fetch_add(1, std::memory_order_relaxed);
+
+    return StateUpdateResult_Success;
+}
+
+void State::mergeTarget(const StateUpdate &update, uint64_t revision)
+{
+    StateSnapshot &next = writerTarget;
+    next.revision = revision;
+
+    if (update.fields & StateField_Mode)
+    {
+        next.mode = update.mode;
+    }
+
+    if (update.fields & StateField_Hue)
+    {
+        next.hue = update.hue;
+    }
+
+    if (update.fields & StateField_Saturation)
+    {
+        next.saturation = update.saturation;
+    }
+
+    if (update.fields & StateField_Value)
+    {
+        next.value = update.value;
+    }
+
+    if (update.fields & StateField_Easing)
+    {
+        next.easing = update.easing;
+    }
+
+    if (update.fields & StateField_Period)
+    {
+        next.period = update.period;
+    }
+
+    if (update.fields & StateField_FireCooling)
+    {
+        next.fire_cooling = update.fire_cooling;
+    }
+
+    if (update.fields & StateField_FireSparking)
+    {
+        next.fire_sparking = update.fire_sparking;
+    }
+
+    if (update.fields & StateField_Transition)
+    {
+        next.transition = update.transition;
+    }
+
+    target.write(next);
+}
+
+bool State::applyPending()
+{
+    updateRates();
+
+    if (target.version() == appliedVersion)
+    {
+        return false;
+    }
+
+    StateSnapshot next;
+    appliedVersion = target.read(next);
+    static_cast<StateSnapshot &>(*this) = next;
+    published.write({next, appliedVersion});
+
+    appliedUpdates.fetch_add(1, std::memory_order_relaxed);
 
     printState();
 
-    return StateUpdateResult_Success;
+#if ENABLE_JOURNAL
+    journal.recordState(*this);
+#endif
+
+    return true;
 }
 
-void State::toJsonDocument(StaticJsonDocument<256> &json)
+StateUpdateResult State::fromJsonDocument(const StaticJsonDocument<256> &json)
 {
+    StateUpdate update;
+    update.fromJsonDocument(json);
+
+    return submit(update);
+}
+
+void State::toJsonDocument(StaticJsonDocument<256> &json, bool pending) const
+{
+    const StateSnapshot current = pending ? target.read() : snapshot();
+
     json.clear();
 
-    json["revision"] = revision;
-    json["mode"] = modeToString(mode);
-    json["hue"] = hue;
-    json["saturation"] = saturation;
-    json["value"] = value;
-    json["easing"] = easingToString(easing);
-    json["period"] = period;
-    json["fire-cooling"] = fire_cooling;
-    json["fire-sparking"] = fire_sparking;
+    json["revision"] = current.revision;
+    json["mode"] = modeToString(current.mode);
+    json["hue"] = current.hue;
+    json["saturation"] = current.saturation;
+    json["value"] = current.value;
+    json["easing"] = easingToString(current.easing);
+    json["period"] = current.period;
+    json["fire-cooling"] = current.fire_cooling;
+    json["fire-sparking"] = current.fire_sparking;
+    json["transition"] = current.transition;
+    json["compute-fps"] = effectComputeFps(current.mode);
 }
 
-void State::cycle()
+StateUpdate State::cycleUpdate()
 {
-    mode = static_cast<StateMode>(static_cast<int>(mode + 1));
+    lockWriters();
 
-    if (mode >= StateMode_Count)
+    StateUpdate update;
+    update.fields = StateField_Mode;
+    update.mode = static_cast<StateMode>(static_cast<int>(writerTarget.mode + 1));
+
+    if (update.mode >= StateMode_Count)
     {
-        mode = StateMode_Off;
+        update.mode = StateMode_Off;
     }
 
-    revision++;
+    unlockWriters();
 
-    printState();
+    return update;
 }
 
 void State::printState()
 {
-    Serial.printf("State: %s.\n", modeToString(mode).c_str());
-    Serial.printf("HSV: %02x%02x%02x.\n", hue, saturation, value);
-    Serial.printf("Period: %dms.\n", period);
-    Serial.printf("Fire cooling: %d.\n", fire_cooling);
-    Serial.printf("Fire sparking: %d.\n", fire_sparking);
-    Serial.printf("Easing: %s.\n", easingToString(easing).c_str());
+    logger.info(
+        "State: %s, HSV: %02x%02x%02x, period: %ums, fire cooling: %d, fire sparking: %d, easing: %s, transition: %ums.",
+        modeToString(mode).c_str(),
+        hue, saturation, value,
+        period,
+        fire_cooling,
+        fire_sparking,
+        easingToString(easing).c_str(),
+        transition);
 }
 
 State state;
 
-CRGB leds[MAX_LEDS];
+// The base layer, where effects render. It goes through the compositor before being shown.
+alignas(4) CRGB leds[MAX_LEDS];
 
-void setupState()
+// Array of temperature readings at each simulation cell, shared by both fire effects.
+byte heat[MAX_LEDS];
+
+// The frame computed before `leds`, for effects that compute slower than the output frame rate.
+alignas(4) CRGB previousFrame[MAX_LEDS];
+
+// How far the output is from `previousFrame` to `leds`, from 0 to 256.
+uint16_t interpolation = 256;
+
+// How much the compositor dims the base layer this frame, from 0 to 65535.
+uint16_t baseScale = 65535;
+
+// Single-color effects draw at full value, and leave the value to `baseScale`:
+// drawn into `leds`, a low value would only leave a few levels to fade through.
+static CRGB fullValueColor(uint8_t hue)
 {
-    FastLED.addLeds<WS2812, LEDS_DATA_PIN, GRB>(leds, config.num_leds).setCorrection(TypicalLEDStrip);
-    FastLED.setBrightness(255);
+    baseScale = state.value * 257;
+
+    return CHSV(hue, state.saturation, 255);
+}
+
+// Static frames are sent again at least this often.
+static const uint32_t STATIC_REFRESH_MS = 1000;
 
+// How long a static frame keeps dithering before it settles on the nearest levels.
+static const uint32_t DITHER_SETTLE_MS = 1000;
+
+// Set when the output changed in a way the state revision doesn't capture.
+bool frameInvalidated = true;
+
+void applyPowerLimit()
+{
     if ((config.milliamps > 0) && (config.voltage > 0)) {
-        uint16_t milliamps = config.milliamps;
+        // Whatever the system itself needs is not available to the leds.
+        uint16_t milliamps = 0;
 
-        if (config.milliamps < config.MIN_SYSTEM_MILLIAMPS) {
-            milliamps = 0;
+        if (config.milliamps > config.MIN_SYSTEM_MILLIAMPS) {
+            milliamps = config.milliamps - config.MIN_SYSTEM_MILLIAMPS;
         }
 
-        milliamps -= config.MIN_SYSTEM_MILLIAMPS;
-
-        Serial.printf("Both voltage and milliamps were set: limiting LED power consumption to %dW.\n", (config.voltage * milliamps) / 1000);
+        logger.info("Both voltage and milliamps were set: limiting LED power consumption to %dW.", (config.voltage * milliamps) / 1000);
         FastLED.setMaxPowerInVoltsAndMilliamps(config.voltage, milliamps);
     } else {
-        Serial.println("Not limiting power consumption. Careful as this can be dangerous if you don't provide enough current!");
+        logger.warning("Not limiting power consumption. Careful as this can be dangerous if you don't provide enough current!");
+
+        // FastLED can't forget a limit once set, so make it unreachable instead.
+        FastLED.setMaxPowerInMilliWatts(UINT32_MAX);
+    }
+}
+
+void applyGammaCorrection()
+{
+    if (compositor.gammaCorrection == config.gamma_correction)
+    {
+        return;
     }
+
+    compositor.gammaCorrection = config.gamma_correction;
+    gammaStage.reset();
+
+    // FastLED's own dithering only kicks in under a global brightness, and would fight ours.
+    FastLED.setDither(config.gamma_correction ? DISABLE_DITHER : BINARY_DITHER);
+}
+
+void setupState()
+{
+    addOutput(compositor.output(), config.num_leds).setCorrection(TypicalLEDStrip);
+    FastLED.setBrightness(255);
+
+    gammaStage.setup();
+    applyGammaCorrection();
+
+    logger.info(
+        "Driving %s leds in %s order, taking at least %uus per frame on the wire.",
+        chipsetToString(static_cast<LedChipset>(config.led_chipset)),
+        colorOrderToString(static_cast<LedColorOrder>(config.led_color_order)),
+        static_cast<unsigned>(outputWireTimeMicros(config.num_leds)));
+
+    applyPowerLimit();
+
+    compositor.benchmark();
+    gammaStage.benchmark();
+}
+
+void reconfigureState(uint16_t previousNumLeds)
+{
+    // Leds that are no longer driven would keep their last color.
+    if (config.num_leds < previousNumLeds)
+    {
+        fill_solid(compositor.output(), previousNumLeds, CRGB::Black);
+        powerBeginFrame(false);
+        showOutput();
+    }
+
+    FastLED[0].setLeds(compositor.output(), config.num_leds);
+
+    for (int i = config.num_leds; i < MAX_LEDS; i++)
+    {
+        leds[i] = CRGB::Black;
+        heat[i] = 0;
+    }
+
+    layout.build(config);
+    applyPowerLimit();
+    applyGammaCorrection();
+    frameInvalidated = true;
+
+    logger.info("Reconfigured for %d led(s) at %d fps.", config.num_leds, config.fps);
+}
+
+// The most frames per second an effect needs to compute, or 0 to compute every output frame.
+int effectMaxComputeFps(StateMode mode)
+{
+    switch (mode)
+    {
+    case StateMode_Fire:
+    case StateMode_Fire2D:
+        return 30;
+    default:
+        return 0;
+    }
+}
+
+// The effects that take the most time to compute, which the governor runs faster.
+static bool isHeavyEffect(StateMode mode)
+{
+    switch (mode)
+    {
+    case StateMode_Fire:
+    case StateMode_Fire2D:
+    case StateMode_Plasma:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int effectComputeFps(StateMode mode)
+{
+    const int fps = effectMaxComputeFps(mode);
+
+    return ((fps > 0) && (fps < config.fps)) ? fps : config.fps;
+}
+
+void resetEffects()
+{
+    memset(heat, 0, sizeof(heat));
+    gammaStage.reset();
+    sparseCanvas.invalidate();
 }
 
 int State::easeTime(Easing easing, int time, int mult)
@@ -203,7 +568,7 @@ int State::easeTime(Easing easing, int time, int mult)
     const auto f = getEasingFunction(easing);
     int ts = time % (period * 2);
 
-    if (ts >= period)
+    if (ts >= static_cast<int>(period))
     {
         ts = 2 * period - ts;
     }
@@ -216,60 +581,155 @@ int State::easeTime(Easing easing, int time, int mult)
 
 void pulse()
 {
-    const int fadeLevel = state.easeTime(state.easing, millis(), 255);
-
-    fill_solid(leds, config.num_leds, CHSV(state.hue, state.saturation, state.value));
-    fadeToBlackBy(leds, config.num_leds, fadeLevel);
+    const int fadeLevel = state.easeTime(state.easing, millis(), 65535);
 
-    FastLED.show();
+    // Fade in the compositor rather than in `leds`, which would lose the low bits.
+    fill_solid(leds, config.num_leds, fullValueColor(state.hue));
+    baseScale = (static_cast<uint32_t>(baseScale) * (65535 - fadeLevel)) / 65535;
 }
 
 void colorloop()
 {
     const int hue = state.easeTime(state.easing, millis(), 255);
 
-    FastLED.showColor(CHSV(hue, state.saturation, state.value));
+    fill_solid(leds, config.num_leds, CHSV(hue, state.saturation, state.value));
 }
 
 void rainbow()
 {
-    const int hue = state.easeTime(state.easing, millis(), 255);
+    // Hues are 16-bit so that strips longer than 255 leds still get a gradient: only the final color lookup uses 8 bits.
+    const uint16_t hue = state.easeTime(state.easing, millis(), 65535);
+    const uint16_t step = 65536 / config.num_leds;
+    uint16_t pixelHue = hue;
 
-    fill_rainbow(leds, config.num_leds, hue, 255 / config.num_leds);
+    for (int i = 0; i < config.num_leds; i++)
+    {
+        leds[i] = CHSV(pixelHue >> 8, 240, 255);
+        pixelHue += step;
+    }
+}
 
-    FastLED.show();
+void knight_rider()
+{
+    // The position is in Q8.8 fixed-point, and spread over the two closest leds.
+    const int maxPosition = (config.num_leds - 1) << 8;
+    const int position = constrain(state.easeTime(state.easing, millis(), maxPosition), 0, maxPosition);
+    const int index = position >> 8;
+    const uint8_t fraction = position & 0xFF;
+    const CRGB color = fullValueColor(state.hue);
+
+    sparseCanvas.begin(leds, config.num_leds);
+    sparseCanvas.set(index, CRGB(color).nscale8(255 - fraction));
+    sparseCanvas.set(index + 1, CRGB(color).nscale8(fraction));
 }
 
-struct ballInfo {
-    int timeOffset;
-    double multiplier;
-    CRGB color;
-};
+// Comet tails are this fraction of the strip, within bounds.
+static const uint16_t COMET_TAIL_DIVIDER = 8;
+static const uint16_t COMET_MIN_TAIL = 3;
+static const uint16_t COMET_MAX_TAIL = 48;
 
-void knight_rider()
+static uint16_t cometTail(uint16_t count)
 {
-    const int position = state.easeTime(state.easing, millis(), config.num_leds - 1);
+    return constrain(count / COMET_TAIL_DIVIDER, COMET_MIN_TAIL, COMET_MAX_TAIL);
+}
 
-    for (int i = 0; i < config.num_leds; i++)
+// Draw a comet whose head is at `position`, in Q8.8 fixed-point, moving towards `direction` (1 or -1).
+//
+// The tail fades out quadratically over `tail` leds, and the whole comet is
+// shifted by the fractional part of the position so that it moves smoothly.
+// With `wrap`, the comet goes around the ends of the strip.
+static void drawComet(int32_t position, int8_t direction, uint16_t tail, const CRGB &color, bool wrap)
+{
+    const int32_t count = sparseCanvas.count();
+    const int32_t length = static_cast<int32_t>(tail + 1) << 8;
+    const int32_t head = position >> 8;
+
+    for (int32_t k = -1; k <= tail; k++)
     {
-        if (i == position)
+        int32_t index = head - direction * k;
+        // How far behind the head this led is, in Q8.8.
+        const int32_t distance = (position - (index << 8)) * direction;
+        uint8_t brightness;
+
+        if (distance < -256)
         {
-            leds[i] = CHSV(state.hue, state.saturation, state.value);
+            continue;
+        }
+        else if (distance < 0)
+        {
+            // The leading edge, lit as the head moves into it.
+            brightness = 256 + distance;
+        }
+        else if (distance < length)
+        {
+            const uint8_t remaining = 255 - (distance * 255) / length;
+            brightness = scale8(remaining, remaining);
         }
         else
         {
-            leds[i] = CRGB::Black;
+            continue;
         }
+
+        if (wrap)
+        {
+            index = ((index % count) + count) % count;
+        }
+        else if ((index < 0) || (index >= count))
+        {
+            continue;
+        }
+
+        sparseCanvas.add(index, CRGB(color).nscale8(brightness));
     }
+}
 
-    FastLED.show();
+void comet()
+{
+    // One lap per period.
+    const uint32_t period = (state.period > 0) ? state.period : 1;
+    const int32_t position = (static_cast<uint64_t>(millis() % period) * (config.num_leds << 8)) / period;
+
+    sparseCanvas.begin(leds, config.num_leds);
+    drawComet(position, 1, cometTail(config.num_leds), fullValueColor(state.hue), true);
 }
 
-void fire()
+struct ballInfo
 {
-    // Array of temperature readings at each simulation cell
-    static byte heat[MAX_LEDS];
+    uint32_t timeOffset;
+    // In Q8.8 fixed-point, relative to the period.
+    uint16_t speed;
+    uint8_t hueOffset;
+};
 
+// Balls bounce at slightly different speeds, so they keep crossing each other.
+static const ballInfo balls[] = {
+    {0, 256, 0},
+    {1700, 333, 85},
+    {3100, 205, 170},
+};
+
+void multi_ball()
+{
+    const int maxPosition = (config.num_leds - 1) << 8;
+    const uint16_t tail = cometTail(config.num_leds) / 2;
+    const uint32_t now = millis();
+
+    sparseCanvas.begin(leds, config.num_leds);
+
+    for (const ballInfo &ball : balls)
+    {
+        const uint32_t time = static_cast<uint32_t>((static_cast<uint64_t>(now) * ball.speed) >> 8) + ball.timeOffset;
+        const int position = constrain(state.easeTime(state.easing, time, maxPosition), 0, maxPosition);
+        // The tail follows the way the ball came from, a few milliseconds ago.
+        const int previous = state.easeTime(state.easing, time - 16, maxPosition);
+        const int8_t direction = (position >= previous) ? 1 : -1;
+
+        drawComet(position, direction, tail, fullValueColor(state.hue + ball.hueOffset), false);
+    }
+}
+
+void fire()
+{
     // Step 1.  Cool down every cell a little
     for (int i = 0; i < config.num_leds; i++)
     {
@@ -299,33 +759,138 @@ void fire()
 
         leds[j] = color;
     }
+}
 
-    FastLED.show();
+// Returns the position in the current period, on a 0-255 scale.
+uint8_t periodPhase()
+{
+    if (state.period <= 0)
+    {
+        return 0;
+    }
+
+    return static_cast<uint8_t>((static_cast<uint64_t>(millis() % state.period) << 8) / state.period);
 }
 
-void stateLoop()
+// 2D effects only draw the matrix: turn off the leds wired past it.
+static void clearPastLayout()
 {
+    const uint16_t count = layout.width * layout.height;
+
+    if (count < config.num_leds)
     {
-        static int lastUpdate = millis();
-        // Make sure we don't update fast than necessary.
-        const int elapsed = millis() - lastUpdate;
-        const int frame_time_left = (1000 / config.fps) - elapsed;
+        fill_solid(leds + count, config.num_leds - count, CRGB::Black);
+    }
+}
 
-        if (frame_time_left > 0)
+void plasma()
+{
+    const uint8_t phase = periodPhase();
+    const uint16_t *index = layout.indices();
+    uint8_t rowPhase = phase;
+
+    for (uint16_t y = 0; y < layout.height; y++)
+    {
+        const uint8_t rowWave = sin8(rowPhase);
+        uint8_t columnPhase = -phase;
+        uint8_t diagonalPhase = (y * 7) + (phase * 2);
+
+        for (uint16_t x = 0; x < layout.width; x++)
         {
-            return;
+            const uint8_t v = (rowWave + sin8(columnPhase) + 2 * sin8(diagonalPhase)) / 4;
+
+            leds[*index++] = CHSV(state.hue + v, state.saturation, state.value);
+
+            columnPhase += 13;
+            diagonalPhase += 7;
         }
 
-        lastUpdate = millis();
+        rowPhase += 11;
     }
 
+    clearPastLayout();
+}
+
+void fire_2d()
+{
+    const uint16_t width = layout.width;
+    const uint16_t height = layout.height;
+    const uint16_t count = width * height;
+
+    // Step 1.  Cool down every cell a little
+    for (uint16_t i = 0; i < count; i++)
+    {
+        heat[i] = qsub8(heat[i], random8(0, ((state.fire_cooling * 10) / height) + 2));
+    }
+
+    // Step 2.  Heat from each cell drifts 'up' (towards row 0) and diffuses a little
+    for (uint16_t i = 0; i + 2 * width < count; i++)
+    {
+        heat[i] = (heat[i + width] + heat[i + 2 * width] + heat[i + 2 * width]) / 3;
+    }
+
+    // Step 3.  Randomly ignite new 'sparks' of heat on the bottom row
+    byte *bottom = heat + count - width;
+
+    for (uint16_t x = 0; x < width; x++)
+    {
+        if (random8() < state.fire_sparking)
+        {
+            bottom[x] = qadd8(bottom[x], random8(160, 255));
+        }
+    }
+
+    // Step 4.  Map from heat cells to LED colors
+    const uint16_t *index = layout.indices();
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        leds[index[i]] = ColorFromPalette(HeatColors_p, scale8(heat[i], 240));
+    }
+
+    clearPastLayout();
+}
+
+void diagonal_rainbow()
+{
+    const uint16_t hue = state.easeTime(state.easing, millis(), 65535);
+    const uint16_t step = 65536 / (layout.width + layout.height - 1);
+    const uint16_t *index = layout.indices();
+    uint16_t rowHue = hue;
+
+    for (uint16_t y = 0; y < layout.height; y++)
+    {
+        uint16_t pixelHue = rowHue;
+
+        for (uint16_t x = 0; x < layout.width; x++)
+        {
+            leds[*index++] = CHSV(pixelHue >> 8, 240, 255);
+            pixelHue += step;
+        }
+
+        rowHue += step;
+    }
+
+    clearPastLayout();
+}
+
+// Whether the effect of `mode` only draws the leds it lights, through `sparseCanvas`.
+static bool isSparseMode(StateMode mode)
+{
+    return (mode == StateMode_KnightRider) || (mode == StateMode_Comet) || (mode == StateMode_MultiBall);
+}
+
+void renderEffect()
+{
+    baseScale = 65535;
+
     switch (state.mode)
     {
     case StateMode_Off:
-        FastLED.showColor(CRGB::Black);
+        fill_solid(leds, config.num_leds, CRGB::Black);
         break;
     case StateMode_On:
-        FastLED.showColor(CHSV(state.hue, state.saturation, state.value));
+        fill_solid(leds, config.num_leds, CHSV(state.hue, state.saturation, state.value));
         break;
     case StateMode_Pulse:
         pulse();
@@ -342,8 +907,142 @@ void stateLoop()
     case StateMode_Fire:
         fire();
         break;
+    case StateMode_Plasma:
+        plasma();
+        break;
+    case StateMode_Fire2D:
+        fire_2d();
+        break;
+    case StateMode_DiagonalRainbow:
+        diagonal_rainbow();
+        break;
+    case StateMode_Comet:
+        comet();
+        break;
+    case StateMode_MultiBall:
+        multi_ball();
+        break;
     default:
-        FastLED.showColor(CRGB::Black);
+        fill_solid(leds, config.num_leds, CRGB::Black);
         break;
     }
+
+    if (!isSparseMode(state.mode))
+    {
+        sparseCanvas.invalidate();
+    }
+}
+
+void stateLoop()
+{
+    {
+        static int lastUpdate = millis();
+        // Make sure we don't update fast than necessary.
+        const int elapsed = millis() - lastUpdate;
+        const int frame_time_left = (1000 / config.fps) - elapsed;
+
+        if (frame_time_left > 0)
+        {
+            // Use the spare frame time to send pending logs without blocking.
+            logger.drain();
+            return;
+        }
+
+        lastUpdate = millis();
+    }
+
+    // All the updates since the last frame become a single transition.
+    state.applyPending();
+
+    bool modeChanged = false;
+
+    {
+        static StateMode lastMode = state.mode;
+
+        if (state.mode != lastMode)
+        {
+            compositor.startTransition(state.transition);
+            lastMode = state.mode;
+            modeChanged = true;
+        }
+    }
+
+    {
+        // A static frame only needs to be sent again when it changes, and once in a while in case a led glitched.
+        static uint32_t shownVersion = 0;
+        static uint32_t lastShow = 0;
+        static uint32_t unchangedSince = 0;
+        const bool isStatic = ((state.mode == StateMode_Off) || (state.mode == StateMode_On)) && !compositor.isAnimating();
+        const bool unchanged = isStatic && !frameInvalidated && (state.version() == shownVersion);
+
+        if (!unchanged)
+        {
+            unchangedSince = millis();
+        }
+
+        // Dithering changes every frame: once settled, the frame is rounded and stops changing.
+        gammaStage.ditherEnabled = !unchanged || (millis() - unchangedSince < DITHER_SETTLE_MS);
+
+        powerSetFrameStatic(isStatic && !gammaStage.isDithering());
+
+        if (unchanged && !gammaStage.isDithering() && (millis() - lastShow < STATIC_REFRESH_MS))
+        {
+            logger.drain();
+            return;
+        }
+
+        shownVersion = state.version();
+        lastShow = millis();
+        frameInvalidated = false;
+        powerBeginFrame(isHeavyEffect(state.mode));
+    }
+
+    {
+        // Heavy effects compute less often than frames are sent, and get interpolated in between.
+        static uint32_t lastCompute = 0;
+        const uint32_t now = millis();
+        const int computeFps = effectComputeFps(state.mode);
+        const bool interpolate = (computeFps < config.fps);
+        const uint32_t computeInterval = 1000 / computeFps;
+
+        if (modeChanged || !interpolate || (now - lastCompute >= computeInterval))
+        {
+            TRACE_SCOPE("render");
+
+            if (interpolate)
+            {
+                memcpy(previousFrame, leds, config.num_leds * sizeof(CRGB));
+            }
+
+            renderEffect();
+
+            // Keep the cadence, unless the loop fell too far behind.
+            lastCompute = (interpolate && !modeChanged && (now - lastCompute < 2 * computeInterval)) ? lastCompute + computeInterval : now;
+
+            // There is nothing to interpolate from in another mode: the compositor's transition covers it.
+            if (modeChanged && interpolate)
+            {
+                memcpy(previousFrame, leds, config.num_leds * sizeof(CRGB));
+            }
+
+#if ENABLE_JOURNAL
+            journal.recordFrame(reinterpret_cast<const uint8_t *>(leds), config.num_leds * sizeof(CRGB), baseScale, state.mode);
+#endif
+        }
+
+        const uint32_t elapsed = now - lastCompute;
+        interpolation = (interpolate && (elapsed < computeInterval)) ? (elapsed * 256) / computeInterval : 256;
+    }
+
+    {
+        TRACE_SCOPE("compose");
+
+        compositor.compose(leds, config.num_leds, baseScale, previousFrame, interpolation);
+    }
+
+    {
+        TRACE_SCOPE("show");
+
+        showOutput();
+    }
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 
 #include <ArduinoJson.h>
 
 #include "easing.h"
+#include "seqlock.h"
 
 enum StateMode
 {
@@ -15,6 +17,11 @@ enum StateMode
     StateMode_Rainbow = 4,
     StateMode_KnightRider = 5,
     StateMode_Fire = 6,
+    StateMode_Plasma = 7,
+    StateMode_Fire2D = 8,
+    StateMode_DiagonalRainbow = 9,
+    StateMode_Comet = 10,
+    StateMode_MultiBall = 11,
     StateMode_Count,
 };
 
@@ -25,15 +32,44 @@ enum StateUpdateResult
     StateUpdateResult_OutdatedInput = 2,
 };
 
-class State
+enum StateField
 {
-public:
-    StateUpdateResult fromJsonDocument(const StaticJsonDocument<256>& json);
-    void toJsonDocument(StaticJsonDocument<256> &json);
-    void cycle();
-    void printState();
-    int easeTime(Easing easing, int time, int mult);
+    StateField_Revision = 1 << 0,
+    StateField_Mode = 1 << 1,
+    StateField_Hue = 1 << 2,
+    StateField_Saturation = 1 << 3,
+    StateField_Value = 1 << 4,
+    StateField_Easing = 1 << 5,
+    StateField_Period = 1 << 6,
+    StateField_FireCooling = 1 << 7,
+    StateField_FireSparking = 1 << 8,
+    StateField_Transition = 1 << 9,
+};
+
+// A partial state change, whatever transport it came from.
+//
+// Only the fields flagged in `fields` are meaningful. If `StateField_Revision` is
+// set, the update is only accepted if `revision` matches, see `State::submit()`.
+struct StateUpdate
+{
+    void fromJsonDocument(const StaticJsonDocument<256> &json);
+
+    uint16_t fields = 0;
+    uint64_t revision = 0;
+    StateMode mode = StateMode_Off;
+    uint8_t hue = 0;
+    uint8_t saturation = 0;
+    uint8_t value = 0;
+    Easing easing = EaseLinear;
+    uint32_t period = 0;
+    uint8_t fire_cooling = 0;
+    uint8_t fire_sparking = 0;
+    uint32_t transition = 0;
+};
 
+// The state fields, as a plain value that can be copied between contexts.
+struct StateSnapshot
+{
     uint64_t revision = 0;
     StateMode mode = StateMode_Off;
     uint8_t hue = 0;
@@ -43,10 +79,109 @@ public:
     uint32_t period = 5000;
     uint8_t fire_cooling = 40;
     uint8_t fire_sparking = 80;
+    uint32_t transition = 0;
+};
+
+// The current state, and the updates waiting for the next frame.
+//
+// Updates are coalesced: everything submitted between two frames is merged,
+// the latest value winning for each field, and applied as a single transition
+// when the next frame starts. `revision` counts the accepted writes, so the
+// applied revision may skip the ones merged within the same frame.
+//
+// A submitted update gets its own revision, `pendingRevision()`, which is
+// what writers are acknowledged with. A conditional update (with
+// `StateField_Revision`) is only accepted at the latest revision, applied or
+// not: a writer can chain updates on its last acknowledgement without waiting
+// for a frame, but not on a state another write already replaced.
+//
+// A write replicated from another controller, `submitReplica()`, takes the
+// revision that controller gave it instead, so that a group shares its
+// revisions rather than each member counting its own.
+//
+// The fields of the `State` itself belong to the render loop, and only change
+// in `applyPending()`. Writers merge into a target state published through a
+// sequence lock, which the renderer picks up whole once per frame. Everything
+// else reads the state through `snapshot()`, which the renderer publishes
+// the same way after each change. Nobody waits on a lock: a reader that
+// overlaps a write just copies again.
+class State : public StateSnapshot
+{
+public:
+    State();
+
+    // Safe to call from any context.
+    StateUpdateResult submit(const StateUpdate &update);
+    StateUpdateResult submitReplica(const StateUpdate &update, uint64_t revision);
+    StateUpdateResult fromJsonDocument(const StaticJsonDocument<256>& json);
+    // With `pending`, the state as it will be once the submitted updates are applied.
+    void toJsonDocument(StaticJsonDocument<256> &json, bool pending = false) const;
+    // An update to the mode after the one about to be applied, so that quick presses don't get lost.
+    StateUpdate cycleUpdate();
+    StateSnapshot snapshot() const;
+    uint64_t pendingRevision() const;
+    // Changes whenever the applied state does, even when a replicated write kept the revision.
+    uint32_t version() const;
+
+    void printState();
+    int easeTime(Easing easing, int time, int mult);
+
+    // Apply the pending update, if any. Returns whether the state changed.
+    // Only the render loop may call it.
+    bool applyPending();
+
+private:
+    struct Published
+    {
+        StateSnapshot state;
+        // The version of `target` it was applied from.
+        uint32_t targetVersion;
+    };
+
+    // Serializes the writers among themselves. It is only held while merging, never by the renderer.
+    void lockWriters();
+    void unlockWriters();
+
+    // Check and merge `update`, as `revision` or, if `nullptr`, as the next one.
+    StateUpdateResult accept(const StateUpdate &update, const uint64_t *revision);
+    // Merge `update` into the target, with the writers locked.
+    void mergeTarget(const StateUpdate &update, uint64_t revision);
+
+    std::atomic_flag writersLock = ATOMIC_FLAG_INIT;
+    // The writers' copy of the latest target, only accessed with the writers locked.
+    StateSnapshot writerTarget;
+    SeqLock<StateSnapshot> target;
+    SeqLock<Published> published;
+    uint32_t appliedVersion = 0;
 };
 
 extern State state;
 
+struct StateUpdateStats
+{
+    uint32_t submitted;
+    uint32_t applied;
+    // Over the last second or so.
+    uint32_t submitted_per_second;
+    uint32_t applied_per_second;
+};
+
+StateUpdateStats stateUpdateStats();
+
+StateMode modeFromString(const String &s);
+String modeToString(StateMode mode);
+Easing easingFromString(const String &s);
+String easingToString(Easing easing);
+
 void setupState();
+
+// Apply the led count, layout and power limit changes without restarting.
+void reconfigureState(uint16_t previousNumLeds);
+
+// Clear the internal state of the effects, so that they render the same frames given the same inputs.
+void resetEffects();
+
+// How many times per second the effect of `mode` computes a frame, at most the output frame rate.
+int effectComputeFps(StateMode mode);
 void stateLoop();
 void cycleState();
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "trace.h"
+
+#if ENABLE_TRACE
+
+Tracer tracer;
+
+void Tracer::record(const char *name, uint32_t begin, uint32_t end)
+{
+    const uint32_t duration = end - begin;
+
+    if (duration < TRACE_MIN_DURATION_US)
+    {
+        return;
+    }
+
+    TraceEvent &event = events[count % MAX_EVENTS];
+    event.name = name;
+    event.begin = begin;
+    event.duration = duration;
+    count++;
+}
+
+size_t Tracer::copyEvents(TraceEvent *out, size_t maxEvents) const
+{
+    size_t n = (count < MAX_EVENTS) ? count : MAX_EVENTS;
+
+    if (n > maxEvents)
+    {
+        n = maxEvents;
+    }
+
+    const uint32_t first = count - n;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = events[(first + i) % MAX_EVENTS];
+    }
+
+    return n;
+}
+
+void Tracer::clear()
+{
+    count = 0;
+}
+
+#endif
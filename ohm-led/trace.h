@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+
+// Set to 0 to compile all trace points out.
+#ifndef ENABLE_TRACE
+#define ENABLE_TRACE 1
+#endif
+
+// Spans shorter than this are not recorded, so that idle loop iterations don't flush the interesting ones out of the buffer.
+#ifndef TRACE_MIN_DURATION_US
+#define TRACE_MIN_DURATION_US 50
+#endif
+
+struct TraceEvent
+{
+    const char *name;
+    uint32_t begin;
+    uint32_t duration;
+};
+
+// A fixed circular buffer of the most recent timed spans.
+class Tracer
+{
+public:
+    static const size_t MAX_EVENTS = 128;
+
+    void record(const char *name, uint32_t begin, uint32_t end);
+
+    // Copy the recorded events, oldest first, and return how many were copied.
+    size_t copyEvents(TraceEvent *out, size_t maxEvents) const;
+
+    void clear();
+
+private:
+    TraceEvent events[MAX_EVENTS] = {};
+    uint32_t count = 0;
+};
+
+extern Tracer tracer;
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : name(name), begin(micros()) {}
+
+    ~TraceScope()
+    {
+        tracer.record(name, begin, micros());
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name;
+    uint32_t begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#if ENABLE_TRACE
+// Record the time spent until the end of the enclosing scope. `name` must be a string literal.
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) \
+    do                    \
+    {                     \
+    } while (0)
+#endif
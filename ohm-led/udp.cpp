@@ -0,0 +1,541 @@
+#include "udp.h"
+
+#include "config.h"
+#include "logger.h"
+#include "power.h"
+#include "presets.h"
+#include "state.h"
+
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+WiFiUDP udp;
+
+// Bound to the group port and joined to the group address: it receives the group writes, and the members' acknowledgements.
+WiFiUDP groupUdp;
+
+static const size_t HEADER_SIZE = 8;
+static const size_t STATE_SIZE = 25;
+static const size_t SET_STATE_SIZE = HEADER_SIZE + STATE_SIZE;
+static const size_t RECALL_PRESET_SIZE = HEADER_SIZE + 1;
+static const size_t ACK_SIZE = HEADER_SIZE + 9;
+static const size_t GROUP_SET_STATE_SIZE = HEADER_SIZE + 3 + STATE_SIZE + 8;
+static const size_t GROUP_ACK_SIZE = HEADER_SIZE + 17;
+
+// Don't starve the rest of the loop when flooded.
+static const int MAX_PACKETS_PER_LOOP = 8;
+
+// How many group senders are remembered, to drop their repeated writes.
+static const size_t MAX_GROUP_SENDERS = 16;
+
+static uint16_t readU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t readU32(const uint8_t *p)
+{
+    return readU16(p) | (static_cast<uint32_t>(readU16(p + 2)) << 16);
+}
+
+static uint64_t readU64(const uint8_t *p)
+{
+    return readU32(p) | (static_cast<uint64_t>(readU32(p + 4)) << 32);
+}
+
+static void writeU16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void writeU32(uint8_t *p, uint32_t v)
+{
+    writeU16(p, v);
+    writeU16(p + 2, v >> 16);
+}
+
+static void writeU64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        p[i] = v >> (8 * i);
+    }
+}
+
+static void writeHeader(uint8_t *packet, UdpMessageType type, uint8_t flags, const uint8_t *sequence)
+{
+    packet[0] = 'O';
+    packet[1] = 'L';
+    packet[2] = UDP_PROTOCOL_VERSION;
+    packet[3] = type;
+    packet[4] = flags;
+    packet[5] = 0;
+    packet[6] = sequence[0];
+    packet[7] = sequence[1];
+}
+
+static void readState(const uint8_t *payload, StateUpdate &update)
+{
+    update.fields = readU16(payload);
+    update.revision = readU64(payload + 2);
+    update.mode = static_cast<StateMode>(payload[10]);
+    update.hue = payload[11];
+    update.saturation = payload[12];
+    update.value = payload[13];
+    update.easing = static_cast<Easing>(payload[14]);
+    update.period = readU32(payload + 15);
+    update.fire_cooling = payload[19];
+    update.fire_sparking = payload[20];
+    update.transition = readU32(payload + 21);
+}
+
+static void writeState(uint8_t *payload, const StateUpdate &update)
+{
+    writeU16(payload, update.fields);
+    writeU64(payload + 2, update.revision);
+    payload[10] = update.mode;
+    payload[11] = update.hue;
+    payload[12] = update.saturation;
+    payload[13] = update.value;
+    payload[14] = update.easing;
+    writeU32(payload + 15, update.period);
+    payload[19] = update.fire_cooling;
+    payload[20] = update.fire_sparking;
+    writeU32(payload + 21, update.transition);
+}
+
+static void sendAck(WiFiUDP &socket, const uint8_t *request, StateUpdateResult result)
+{
+    uint8_t packet[ACK_SIZE];
+
+    writeHeader(packet, UdpMessageType_Ack, 0, request + 6);
+    packet[8] = result;
+    writeU64(packet + 9, state.pendingRevision());
+
+    socket.beginPacket(socket.remoteIP(), socket.remotePort());
+    socket.write(packet, sizeof(packet));
+    socket.endPacket();
+}
+
+// The last write this controller sent to the group, while the members acknowledge it.
+struct GroupWrite
+{
+    uint16_t sequence;
+    uint32_t sentAt;
+    bool collecting;
+
+    // Where to send the aggregated acknowledgement, if the write came with `UdpFlag_Ack`.
+    bool notify;
+    IPAddress client;
+    uint16_t clientPort;
+    uint8_t clientSequence[2];
+    StateUpdateResult result;
+};
+
+// The last write seen from another member of the group.
+struct GroupSender
+{
+    uint32_t ip;
+    uint16_t boot;
+    uint16_t sequence;
+};
+
+GroupWrite groupWrite = {};
+GroupStats groupStatistics = {};
+uint16_t groupBootId = 0;
+uint16_t groupSequence = 0;
+GroupSender groupSenders[MAX_GROUP_SENDERS] = {};
+size_t groupSendersUsed = 0;
+size_t groupSenderNext = 0;
+
+// Whether this controller took part in a group write since it started, and who gave the current revision.
+bool groupSynced = false;
+uint32_t groupRevisionAuthor = 0;
+
+static IPAddress groupAddress()
+{
+    return IPAddress(239, 255, 79, config.group);
+}
+
+static void sendGroupAck()
+{
+    uint8_t packet[GROUP_ACK_SIZE];
+
+    writeHeader(packet, UdpMessageType_GroupAck, 0, groupWrite.clientSequence);
+    packet[8] = groupWrite.result;
+    writeU64(packet + 9, state.pendingRevision());
+    writeU16(packet + 17, groupStatistics.acked);
+    writeU16(packet + 19, groupStatistics.failed);
+    writeU16(packet + 21, groupStatistics.max_latency_ms);
+    writeU16(packet + 23, groupStatistics.conflicts);
+
+    udp.beginPacket(groupWrite.client, groupWrite.clientPort);
+    udp.write(packet, sizeof(packet));
+    udp.endPacket();
+}
+
+// Stop counting acknowledgements for the current group write, and report them if asked to.
+static void closeGroupWrite()
+{
+    if (!groupWrite.collecting)
+    {
+        return;
+    }
+
+    groupWrite.collecting = false;
+
+    if (groupWrite.notify)
+    {
+        sendGroupAck();
+    }
+
+    logger.debug("Group write %u: %u member(s) applied it, %u rejected it (%u as outdated), in %ums at most.", groupWrite.sequence, groupStatistics.acked, groupStatistics.failed, groupStatistics.conflicts, groupStatistics.max_latency_ms);
+}
+
+static void sendToGroup(const StateUpdate &update, uint64_t revision)
+{
+    // A write on its way out still gets its report, cut short.
+    closeGroupWrite();
+
+    groupSequence++;
+
+    uint8_t sequence[2];
+    writeU16(sequence, groupSequence);
+
+    // A conditional write keeps the revision it was accepted at here, for the members to check against theirs,
+    // and every write carries the revision it got here, for the members to take.
+    uint8_t packet[GROUP_SET_STATE_SIZE];
+    writeHeader(packet, UdpMessageType_GroupSetState, UdpFlag_Ack, sequence);
+    packet[8] = config.group;
+    writeU16(packet + 9, groupBootId);
+    writeState(packet + 11, update);
+    writeU64(packet + 36, revision);
+
+    groupUdp.beginPacketMulticast(groupAddress(), config.udp_port + UDP_GROUP_PORT_OFFSET, WiFi.localIP());
+    groupUdp.write(packet, sizeof(packet));
+    groupUdp.endPacket();
+
+    groupWrite.sequence = groupSequence;
+    groupWrite.sentAt = millis();
+    groupWrite.collecting = true;
+    groupWrite.notify = false;
+    groupStatistics.sent++;
+    groupStatistics.acked = 0;
+    groupStatistics.failed = 0;
+    groupStatistics.conflicts = 0;
+    groupStatistics.max_latency_ms = 0;
+}
+
+StateUpdateResult submitToGroup(const StateUpdate &update)
+{
+    const StateUpdateResult result = state.submit(update);
+
+    if ((result == StateUpdateResult_Success) && (config.group != 0))
+    {
+        groupSynced = true;
+        groupRevisionAuthor = WiFi.localIP();
+        sendToGroup(update, state.pendingRevision());
+    }
+
+    return result;
+}
+
+GroupStats groupStats()
+{
+    return groupStatistics;
+}
+
+// Whether this write from another member is newer than the last one seen from it.
+static bool isNewGroupWrite(uint32_t ip, uint16_t boot, uint16_t sequence)
+{
+    for (size_t i = 0; i < groupSendersUsed; i++)
+    {
+        GroupSender &sender = groupSenders[i];
+
+        if (sender.ip != ip)
+        {
+            continue;
+        }
+
+        // A new boot id means the sender restarted and counts from scratch.
+        if ((sender.boot == boot) && (static_cast<int16_t>(sequence - sender.sequence) <= 0))
+        {
+            return false;
+        }
+
+        sender.boot = boot;
+        sender.sequence = sequence;
+        return true;
+    }
+
+    GroupSender &sender = groupSenders[groupSenderNext];
+    sender = {ip, boot, sequence};
+    groupSenderNext = (groupSenderNext + 1) % MAX_GROUP_SENDERS;
+
+    if (groupSendersUsed < MAX_GROUP_SENDERS)
+    {
+        groupSendersUsed++;
+    }
+
+    return true;
+}
+
+static StateUpdateResult handleGroupSetState(const uint8_t *packet, size_t size)
+{
+    if ((size < GROUP_SET_STATE_SIZE) || (packet[HEADER_SIZE] != config.group))
+    {
+        return StateUpdateResult_InvalidInput;
+    }
+
+    const uint32_t sender = groupUdp.remoteIP();
+
+    if (!isNewGroupWrite(sender, readU16(packet + 9), readU16(packet + 6)))
+    {
+        return StateUpdateResult_OutdatedInput;
+    }
+
+    StateUpdate update;
+    readState(packet + 11, update);
+    const uint64_t revision = readU64(packet + 36);
+
+    groupStatistics.received++;
+
+    if (!groupSynced)
+    {
+        // A member that just started has no state of its own to protect, and catches up with the group.
+        update.fields &= ~StateField_Revision;
+    }
+    else if (revision == state.pendingRevision())
+    {
+        // Two members accepted a write at once, at the same revision: the one from the higher address wins everywhere.
+        if (sender < groupRevisionAuthor)
+        {
+            return StateUpdateResult_OutdatedInput;
+        }
+
+        update.fields &= ~StateField_Revision;
+    }
+
+    const StateUpdateResult result = state.submitReplica(update, revision);
+
+    if (result == StateUpdateResult_Success)
+    {
+        groupSynced = true;
+        groupRevisionAuthor = sender;
+    }
+
+    return result;
+}
+
+static void handleGroupAck(const uint8_t *packet, size_t size)
+{
+    if ((size < ACK_SIZE) || !groupWrite.collecting || (readU16(packet + 6) != groupWrite.sequence))
+    {
+        return;
+    }
+
+    const uint32_t latency = millis() - groupWrite.sentAt;
+
+    if (packet[HEADER_SIZE] == StateUpdateResult_Success)
+    {
+        groupStatistics.acked++;
+    }
+    else
+    {
+        groupStatistics.failed++;
+    }
+
+    if (packet[HEADER_SIZE] == StateUpdateResult_OutdatedInput)
+    {
+        groupStatistics.conflicts++;
+    }
+
+    groupStatistics.max_latency_ms = max(groupStatistics.max_latency_ms, static_cast<uint16_t>(min(latency, static_cast<uint32_t>(UINT16_MAX))));
+}
+
+// If the request was replicated and asks for an acknowledgement, report on the members once they had time to answer.
+static void watchGroupWrite(const uint8_t *packet, uint32_t sentBefore, StateUpdateResult result)
+{
+    if ((groupStatistics.sent != sentBefore) && (packet[4] & UdpFlag_Ack))
+    {
+        groupWrite.notify = true;
+        groupWrite.client = udp.remoteIP();
+        groupWrite.clientPort = udp.remotePort();
+        groupWrite.clientSequence[0] = packet[6];
+        groupWrite.clientSequence[1] = packet[7];
+        groupWrite.result = result;
+    }
+}
+
+static StateUpdateResult handleSetState(const uint8_t *packet, size_t size)
+{
+    if (size < SET_STATE_SIZE)
+    {
+        return StateUpdateResult_InvalidInput;
+    }
+
+    StateUpdate update;
+    readState(packet + HEADER_SIZE, update);
+
+    const uint32_t sent = groupStatistics.sent;
+    const StateUpdateResult result = submitToGroup(update);
+    watchGroupWrite(packet, sent, result);
+
+    return result;
+}
+
+static StateUpdateResult handleRecallPreset(const uint8_t *packet, size_t size)
+{
+    if (size < RECALL_PRESET_SIZE)
+    {
+        return StateUpdateResult_InvalidInput;
+    }
+
+    const uint32_t sent = groupStatistics.sent;
+    const StateUpdateResult result = presets.recall(packet[HEADER_SIZE]) ? StateUpdateResult_Success : StateUpdateResult_InvalidInput;
+    watchGroupWrite(packet, sent, result);
+
+    return result;
+}
+
+// Read a datagram into `packet`. Returns its size, 0 if there is none left, or -1 if it is not ours.
+static int receive(WiFiUDP &socket, uint8_t *packet, size_t size)
+{
+    const int available = socket.parsePacket();
+
+    if (available <= 0)
+    {
+        return 0;
+    }
+
+    powerNoteActivity();
+
+    const int len = socket.read(packet, size);
+
+    if ((len < static_cast<int>(HEADER_SIZE)) || (packet[0] != 'O') || (packet[1] != 'L') || (packet[2] != UDP_PROTOCOL_VERSION))
+    {
+        logger.debug("Ignoring invalid UDP packet of %d byte(s).", available);
+        return -1;
+    }
+
+    return len;
+}
+
+void startUdpServer(uint16_t port)
+{
+    udp.begin(port);
+
+    if (config.group != 0)
+    {
+        groupBootId = ESP.random();
+        rejoinUdpGroup();
+    }
+}
+
+void rejoinUdpGroup()
+{
+    if (config.group == 0)
+    {
+        return;
+    }
+
+    // The membership belongs to the interface address, which a reconnection may have changed.
+    groupUdp.stop();
+    groupUdp.beginMulticast(WiFi.localIP(), groupAddress(), config.udp_port + UDP_GROUP_PORT_OFFSET);
+    logger.info("Joined group %u at %s.", config.group, groupAddress().toString().c_str());
+}
+
+static void groupLoop()
+{
+    if (groupWrite.collecting && (millis() - groupWrite.sentAt >= UDP_GROUP_ACK_WINDOW_MS))
+    {
+        closeGroupWrite();
+    }
+
+    for (int i = 0; i < MAX_PACKETS_PER_LOOP; i++)
+    {
+        uint8_t packet[64];
+        const int len = receive(groupUdp, packet, sizeof(packet));
+
+        if (len == 0)
+        {
+            return;
+        }
+
+        if (len < 0)
+        {
+            continue;
+        }
+
+        switch (packet[3])
+        {
+        case UdpMessageType_GroupSetState:
+        {
+            // Multicast loops back to the sender.
+            if (groupUdp.remoteIP() == WiFi.localIP())
+            {
+                break;
+            }
+
+            const StateUpdateResult result = handleGroupSetState(packet, len);
+
+            if (packet[4] & UdpFlag_Ack)
+            {
+                sendAck(groupUdp, packet, result);
+            }
+
+            break;
+        }
+        case UdpMessageType_Ack:
+            handleGroupAck(packet, len);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void udpLoop()
+{
+    for (int i = 0; i < MAX_PACKETS_PER_LOOP; i++)
+    {
+        uint8_t packet[64];
+        const int len = receive(udp, packet, sizeof(packet));
+
+        if (len == 0)
+        {
+            break;
+        }
+
+        if (len < 0)
+        {
+            continue;
+        }
+
+        StateUpdateResult result;
+
+        switch (packet[3])
+        {
+        case UdpMessageType_SetState:
+            result = handleSetState(packet, len);
+            break;
+        case UdpMessageType_RecallPreset:
+            result = handleRecallPreset(packet, len);
+            break;
+        default:
+            result = StateUpdateResult_InvalidInput;
+            break;
+        }
+
+        if (packet[4] & UdpFlag_Ack)
+        {
+            sendAck(udp, packet, result);
+        }
+    }
+
+    if (config.group != 0)
+    {
+        groupLoop();
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+
+#include "state.h"
+
+// A compact binary control protocol over UDP.
+//
+// All integers are little-endian. Every datagram starts with an 8-byte header:
+//
+//   0  magic     2 bytes, "OL"
+//   2  version   1 byte, `UDP_PROTOCOL_VERSION`
+//   3  type      1 byte, a `UdpMessageType`
+//   4  flags     1 byte, `UdpFlag_Ack` to request an acknowledgement
+//   5  reserved  1 byte
+//   6  sequence  2 bytes, echoed back in the acknowledgement
+//
+// `UdpMessageType_SetState` is followed by a 25-byte payload mirroring `StateUpdate`:
+//
+//   8  fields         2 bytes, a mask of `StateField`
+//   10 revision       8 bytes
+//   18 mode           1 byte
+//   19 hue            1 byte
+//   20 saturation     1 byte
+//   21 value          1 byte
+//   22 easing         1 byte
+//   23 period         4 bytes
+//   27 fire-cooling   1 byte
+//   28 fire-sparking  1 byte
+//   29 transition     4 bytes
+//
+// `UdpMessageType_RecallPreset` is followed by the preset id, on 1 byte.
+//
+// `UdpMessageType_Ack` is sent back to the sender and is followed by a
+// `StateUpdateResult` on 1 byte, then `State::pendingRevision()` on 8 bytes: the revision under which the update becomes visible.
+//
+// Controllers sharing a `Config::group` replicate the state writes they accept
+// (over UDP, HTTP or MQTT, and the presets or modes the button or a request
+// switches to) to each other. The controller that received the
+// write sends a single `UdpMessageType_GroupSetState` to the multicast address
+// 239.255.79.<group>, on the UDP port + `UDP_GROUP_PORT_OFFSET`. Its header
+// sequence counts the sender's group writes, and it is followed by:
+//
+//   8  group      1 byte
+//   9  boot id    2 bytes, picked at random when the sender starts
+//   11 state      25 bytes, as in `UdpMessageType_SetState`
+//   36 revision   8 bytes, the revision the sender gave the write
+//
+// The members take the revision the write carries rather than count their
+// own, so that a group shares its revisions: a client can make a conditional
+// write to any member at the revision it read from another. A conditional write
+// keeps the revision the sender accepted it at, which each member checks
+// against its own before applying the write, and acknowledges it to the
+// sender. A member that went through other transitions than the sender rejects
+// it as outdated rather than overwrite newer state, until an unconditional
+// write brings it back in step. A member that hasn't seen a group write since it started
+// skips the check, and two writes accepted at once by two members at the same
+// revision are settled in favor of the higher sender address. Datagrams that
+// repeat or predate the last one seen from the same sender and boot are
+// acknowledged as outdated too, and not applied.
+//
+// When a write with `UdpFlag_Ack` is replicated, its sender also gets a
+// `UdpMessageType_GroupAck` once the members had `UDP_GROUP_ACK_WINDOW_MS` to
+// answer. It echoes the request sequence and is followed by:
+//
+//   8  result       1 byte, as in `UdpMessageType_Ack`
+//   9  revision     8 bytes, as in `UdpMessageType_Ack`
+//   17 acked        2 bytes, how many members applied the write
+//   19 failed       2 bytes, how many members rejected it
+//   21 latency      2 bytes, how long the slowest member took to answer, in milliseconds
+//   23 conflicts    2 bytes, how many of the members that rejected it found it outdated
+#define UDP_PROTOCOL_VERSION 1
+
+#define UDP_GROUP_PORT_OFFSET 1
+#define UDP_GROUP_ACK_WINDOW_MS 250
+
+enum UdpMessageType
+{
+    UdpMessageType_SetState = 1,
+    UdpMessageType_RecallPreset = 2,
+    UdpMessageType_Ack = 3,
+    UdpMessageType_GroupSetState = 4,
+    UdpMessageType_GroupAck = 5,
+};
+
+enum UdpFlag
+{
+    UdpFlag_Ack = 1 << 0,
+};
+
+struct GroupStats
+{
+    uint32_t sent;
+    uint32_t received;
+    // About the last write sent to the group.
+    uint16_t acked;
+    uint16_t failed;
+    uint16_t conflicts;
+    uint16_t max_latency_ms;
+};
+
+// Submit `update`, and replicate it to the group if it was accepted.
+StateUpdateResult submitToGroup(const StateUpdate &update);
+GroupStats groupStats();
+
+void startUdpServer(uint16_t port);
+// Join the group again, once the network reconnected, possibly with another address.
+void rejoinUdpGroup();
+void udpLoop();
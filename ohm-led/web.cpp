@@ -1,26 +1,164 @@
 #include "web.h"
 
 #include "index.h"
+#include "compositor.h"
 #include "config.h"
+#include "gamma.h"
+#include "journal.h"
+#include "layout.h"
+#include "logger.h"
+#include "mqtt.h"
+#include "network.h"
+#include "ota.h"
+#include "output.h"
+#include "power.h"
+#include "presets.h"
 #include "state.h"
+#include "trace.h"
+#include "udp.h"
+
+#include <memory>
 
 #include <ESP8266WebServer.h>
 #include <ArduinoJson.h>
+#include <uri/UriBraces.h>
 
 ESP8266WebServer server;
 
+// Firmware updates are authenticated as this user, with `config.update_password`.
+static const char *UPDATE_USERNAME = "ohm-led";
+
+uint32_t restartAt = 0;
+bool restartPending = false;
+
+// Restart shortly, once the response had a chance to go out.
+void scheduleRestart()
+{
+    restartAt = millis() + 1000;
+    restartPending = true;
+}
+
+// Whether the request may change or clear the update password: once one is set, only with it.
+static bool isUpdatePasswordChangeAllowed()
+{
+    return !config.hasUpdatePassword() || server.authenticate(UPDATE_USERNAME, config.update_password);
+}
+
+// Persist the configuration, then apply it live unless a field that needs a restart changed.
+//
+// Returns false if the configuration could not be saved.
+bool commitConfiguration(uint32_t previousFingerprint, uint16_t previousNumLeds, bool &restart)
+{
+    if (!config.Save())
+    {
+        return false;
+    }
+
+    restart = (config.restartFingerprint() != previousFingerprint);
+
+    if (restart)
+    {
+        logger.info("Configuration changed: restarting.");
+        scheduleRestart();
+    }
+    else
+    {
+        reconfigureState(previousNumLeds);
+    }
+
+    return true;
+}
+
 void handleGetIndex()
 {
     server.sendHeader("Location", String("/configuration/"), true);
     server.send(302, "text/plain", "");
 }
 
+template <typename Enum>
+String selectOptions(Enum count, Enum selected, const char *(*toString)(Enum))
+{
+    String html;
+
+    for (int i = 0; i < count; i++)
+    {
+        const char *name = toString(static_cast<Enum>(i));
+
+        html += "<option value=\"";
+        html += name;
+        html += (i == selected) ? "\" selected>" : "\">";
+        html += name;
+        html += "</option>";
+    }
+
+    return html;
+}
+
+// Parse a dotted IP address, in network byte order. An empty string gives 0.
+bool parseIp(const String &s, uint32_t &ip)
+{
+    if (s.length() == 0)
+    {
+        ip = 0;
+        return true;
+    }
+
+    IPAddress address;
+
+    if (!address.fromString(s.c_str()))
+    {
+        return false;
+    }
+
+    ip = address;
+    return true;
+}
+
+String ipToString(uint32_t ip)
+{
+    return (ip == 0) ? String() : IPAddress(ip).toString();
+}
+
 void handleGetConfiguration()
 {
-    // Keep some room for the injected values.
-    char tmp[sizeof(INDEX) + 256];
-    snprintf(tmp, sizeof(tmp), INDEX, config.name, config.ssid, MAX_LEDS, config.num_leds, config.voltage, config.milliamps);
-    server.send(200, "text/html", tmp);
+    const String chipsetOptions = selectOptions(LedChipset_Count, static_cast<LedChipset>(config.led_chipset), chipsetToString);
+    const String colorOrderOptions = selectOptions(LedColorOrder_Count, static_cast<LedColorOrder>(config.led_color_order), colorOrderToString);
+
+    // Keep some room for the injected values. The page is too big for the stack.
+    const size_t size = sizeof(INDEX) + 1024;
+    std::unique_ptr<char[]> tmp(new char[size]);
+    snprintf(
+        tmp.get(),
+        size,
+        INDEX,
+        config.name,
+        config.ssid,
+        ipToString(config.static_ip).c_str(),
+        ipToString(config.static_gateway).c_str(),
+        ipToString(config.static_subnet).c_str(),
+        ipToString(config.static_dns).c_str(),
+        config.group,
+        MAX_LEDS,
+        config.num_leds,
+        chipsetOptions.c_str(),
+        colorOrderOptions.c_str(),
+        config.gamma_correction ? "checked" : "",
+        config.voltage,
+        config.milliamps,
+        MAX_LEDS,
+        config.matrix_width,
+        MAX_LEDS,
+        config.matrix_height,
+        config.matrix_serpentine ? "checked" : "",
+        config.matrix_rotation,
+        config.matrix_flip_x ? "checked" : "",
+        config.matrix_flip_y ? "checked" : "",
+        config.mqtt_host,
+        config.mqtt_port,
+        config.mqtt_username,
+        config.mqtt_topic,
+        config.button_cycles_presets ? "checked" : "");
+    server.send(200, "text/html", tmp.get());
 }
 
 void handleSetConfiguration()
@@ -47,6 +185,32 @@ void handleSetConfiguration()
     const uint16_t num_leds = atoi(server.arg("num_leds").c_str());
     const uint16_t voltage = atoi(server.arg("voltage").c_str());
     const uint16_t milliamps = atoi(server.arg("milliamps").c_str());
+    const uint16_t matrix_width = atoi(server.arg("matrix_width").c_str());
+    const uint16_t matrix_height = atoi(server.arg("matrix_height").c_str());
+    const uint8_t matrix_rotation = atoi(server.arg("matrix_rotation").c_str());
+    const int group = atoi(server.arg("group").c_str());
+    const String mqtt_host = server.arg("mqtt_host");
+    const uint16_t mqtt_port = atoi(server.arg("mqtt_port").c_str());
+    const String mqtt_username = server.arg("mqtt_username");
+    const String mqtt_password = server.arg("mqtt_password");
+    const String update_password = server.arg("update_password");
+    const String mqtt_topic = server.arg("mqtt_topic");
+    const LedChipset led_chipset = server.hasArg("led_chipset") ? chipsetFromString(server.arg("led_chipset")) : static_cast<LedChipset>(config.led_chipset);
+    const LedColorOrder led_color_order = server.hasArg("led_color_order") ? colorOrderFromString(server.arg("led_color_order")) : static_cast<LedColorOrder>(config.led_color_order);
+    uint32_t static_ip = 0;
+    uint32_t static_gateway = 0;
+    uint32_t static_subnet = 0;
+    uint32_t static_dns = 0;
+
+    if (!parseIp(server.arg("static_ip"), static_ip) ||
+        !parseIp(server.arg("static_gateway"), static_gateway) ||
+        !parseIp(server.arg("static_subnet"), static_subnet) ||
+        !parseIp(server.arg("static_dns"), static_dns) ||
+        ((static_ip != 0) && (static_subnet == 0)))
+    {
+        server.send(400, "text/plain", "Invalid static IP configuration.\n");
+        return;
+    }
 
     if (name.length() >= sizeof(config.name))
     {
@@ -72,11 +236,65 @@ void handleSetConfiguration()
         return;
     }
 
+    if (update_password.length() >= sizeof(config.update_password))
+    {
+        server.send(400, "text/plain", "Update password is too big.\n");
+        return;
+    }
+
+    if ((update_password.length() > 0) && !isUpdatePasswordChangeAllowed())
+    {
+        server.requestAuthentication();
+        return;
+    }
+
+    if ((mqtt_host.length() >= sizeof(config.mqtt_host)) ||
+        (mqtt_username.length() >= sizeof(config.mqtt_username)) ||
+        (mqtt_password.length() >= sizeof(config.mqtt_password)) ||
+        (mqtt_topic.length() >= sizeof(config.mqtt_topic)))
+    {
+        server.send(400, "text/plain", "MQTT setting is too big.\n");
+        return;
+    }
+
+    if (led_chipset == LedChipset_Count)
+    {
+        server.send(400, "text/plain", "Invalid LED chipset.\n");
+        return;
+    }
+
+    if (led_color_order == LedColorOrder_Count)
+    {
+        server.send(400, "text/plain", "Invalid LED color order.\n");
+        return;
+    }
+
+    if (static_cast<uint32_t>(matrix_width) * matrix_height > MAX_LEDS)
+    {
+        server.send(400, "text/plain", "Matrix is too big.\n");
+        return;
+    }
+
+    if (matrix_rotation >= Config::MATRIX_ROTATION_COUNT)
+    {
+        server.send(400, "text/plain", "Invalid matrix rotation.\n");
+        return;
+    }
+
+    if ((group < 0) || (group > 254))
+    {
+        server.send(400, "text/plain", "Invalid group.\n");
+        return;
+    }
+
     if (ssid.length() == 0) {
         server.send(500, "text/plain", "SSID cannot be empty");
         return;
     }
 
+    const uint32_t previousFingerprint = config.restartFingerprint();
+    const uint16_t previousNumLeds = config.num_leds;
+
     snprintf(config.name, sizeof(config.name), name.c_str());
     snprintf(config.ssid, sizeof(config.ssid), ssid.c_str());
 
@@ -87,26 +305,332 @@ void handleSetConfiguration()
     config.num_leds = num_leds;
     config.voltage = voltage;
     config.milliamps = milliamps;
+    config.led_chipset = led_chipset;
+    config.led_color_order = led_color_order;
+    config.matrix_width = matrix_width;
+    config.matrix_height = matrix_height;
+    config.matrix_serpentine = server.hasArg("matrix_serpentine");
+    config.matrix_rotation = matrix_rotation;
+    config.matrix_flip_x = server.hasArg("matrix_flip_x");
+    config.matrix_flip_y = server.hasArg("matrix_flip_y");
+    config.button_cycles_presets = server.hasArg("button_cycles_presets");
+    config.gamma_correction = server.hasArg("gamma_correction");
+    config.static_ip = static_ip;
+    config.static_gateway = static_gateway;
+    config.static_subnet = static_subnet;
+    config.static_dns = static_dns;
+    config.group = group;
+
+    snprintf(config.mqtt_host, sizeof(config.mqtt_host), "%s", mqtt_host.c_str());
+    config.mqtt_port = (mqtt_port > 0) ? mqtt_port : Config::DEFAULT_MQTT_PORT;
+    snprintf(config.mqtt_username, sizeof(config.mqtt_username), "%s", mqtt_username.c_str());
+    snprintf(config.mqtt_topic, sizeof(config.mqtt_topic), "%s", mqtt_topic.c_str());
 
-    if (!config.Save()) {
+    if (update_password.length() > 0) {
+        snprintf(config.update_password, sizeof(config.update_password), "%s", update_password.c_str());
+    }
+
+    if (mqtt_password.length() > 0) {
+        snprintf(config.mqtt_password, sizeof(config.mqtt_password), "%s", mqtt_password.c_str());
+    }
+
+    bool restart = false;
+
+    if (!commitConfiguration(previousFingerprint, previousNumLeds, restart)) {
         server.send(500, "text/plain", "Failed to save configuration.\n");
         return;
     }
 
     handleGetIndex();
+}
 
-    delay(1000);
-    ESP.restart();
+void handleGetConfigurationJsonWithRestart(bool restart)
+{
+    StaticJsonDocument<768> json;
+
+    json["name"] = config.name;
+    json["ssid"] = config.ssid;
+    json["num-leds"] = config.num_leds;
+    json["fps"] = config.fps;
+    json["voltage"] = config.voltage;
+    json["milliamps"] = config.milliamps;
+    json["chipset"] = chipsetToString(static_cast<LedChipset>(config.led_chipset));
+    json["color-order"] = colorOrderToString(static_cast<LedColorOrder>(config.led_color_order));
+    json["matrix-width"] = config.matrix_width;
+    json["matrix-height"] = config.matrix_height;
+    json["matrix-serpentine"] = config.matrix_serpentine;
+    json["matrix-rotation"] = config.matrix_rotation;
+    json["matrix-flip-x"] = config.matrix_flip_x;
+    json["matrix-flip-y"] = config.matrix_flip_y;
+    json["button-cycles-presets"] = config.button_cycles_presets;
+    json["gamma-correction"] = config.gamma_correction;
+    json["static-ip"] = ipToString(config.static_ip);
+    json["static-gateway"] = ipToString(config.static_gateway);
+    json["static-subnet"] = ipToString(config.static_subnet);
+    json["static-dns"] = ipToString(config.static_dns);
+    json["group"] = config.group;
+    json["firmware-updates"] = config.hasUpdatePassword();
+    json["restart"] = restart;
+
+    String body;
+    serializeJsonPretty(json, body);
+    body += '\n';
+
+    server.send(200, "application/json", body);
+}
+
+void handleGetConfigurationJson()
+{
+    handleGetConfigurationJsonWithRestart(false);
+}
+
+void handleSetConfigurationJson()
+{
+    if (!server.hasArg("plain"))
+    {
+        server.send(400, "text/plain", "Missing message body.\n");
+        return;
+    }
+
+    const String contentType = server.header("content-type");
+
+    if (contentType != "application/json")
+    {
+        char tmp[128];
+        snprintf(tmp, 128, "Expecting 'application/json' content-type, got: '%s'.\n", contentType.c_str());
+        server.send(400, "text/plain", tmp);
+        return;
+    }
+
+    StaticJsonDocument<512> doc;
+
+    DeserializationError error = deserializeJson(doc, server.arg("plain"));
+
+    if (error)
+    {
+        char tmp[128];
+        snprintf(tmp, 128, "JSON error: %s\n", error.c_str());
+        server.send(400, "text/plain", tmp);
+        return;
+    }
+
+    // Missing fields keep their current value. Validate everything before changing anything.
+    const String name = doc["name"] | config.name;
+    const String ssid = doc["ssid"] | config.ssid;
+    const String passphrase = doc["passphrase"] | "";
+    // An empty password disables firmware updates again.
+    const bool changes_update_password = doc.containsKey("update-password");
+    const String update_password = doc["update-password"] | "";
+    const int num_leds = doc["num-leds"] | config.num_leds;
+    const int fps = doc["fps"] | config.fps;
+    const uint16_t voltage = doc["voltage"] | config.voltage;
+    const uint16_t milliamps = doc["milliamps"] | config.milliamps;
+    const LedChipset led_chipset = chipsetFromString(doc["chipset"] | chipsetToString(static_cast<LedChipset>(config.led_chipset)));
+    const LedColorOrder led_color_order = colorOrderFromString(doc["color-order"] | colorOrderToString(static_cast<LedColorOrder>(config.led_color_order)));
+    const uint16_t matrix_width = doc["matrix-width"] | config.matrix_width;
+    const uint16_t matrix_height = doc["matrix-height"] | config.matrix_height;
+    const uint8_t matrix_rotation = doc["matrix-rotation"] | config.matrix_rotation;
+    const int group = doc["group"] | config.group;
+    uint32_t static_ip = config.static_ip;
+    uint32_t static_gateway = config.static_gateway;
+    uint32_t static_subnet = config.static_subnet;
+    uint32_t static_dns = config.static_dns;
+
+    if ((doc.containsKey("static-ip") && !parseIp(doc["static-ip"].as<String>(), static_ip)) ||
+        (doc.containsKey("static-gateway") && !parseIp(doc["static-gateway"].as<String>(), static_gateway)) ||
+        (doc.containsKey("static-subnet") && !parseIp(doc["static-subnet"].as<String>(), static_subnet)) ||
+        (doc.containsKey("static-dns") && !parseIp(doc["static-dns"].as<String>(), static_dns)) ||
+        ((static_ip != 0) && (static_subnet == 0)))
+    {
+        server.send(400, "text/plain", "Invalid static IP configuration.\n");
+        return;
+    }
+
+    if ((name.length() >= sizeof(config.name)) || (ssid.length() >= sizeof(config.ssid)) || (passphrase.length() >= sizeof(config.passphrase)))
+    {
+        server.send(400, "text/plain", "Name, SSID or passphrase is too big.\n");
+        return;
+    }
+
+    if (update_password.length() >= sizeof(config.update_password))
+    {
+        server.send(400, "text/plain", "Update password is too big.\n");
+        return;
+    }
+
+    if (changes_update_password && !isUpdatePasswordChangeAllowed())
+    {
+        server.requestAuthentication();
+        return;
+    }
+
+    if (num_leds < 1 || num_leds > MAX_LEDS)
+    {
+        server.send(400, "text/plain", "Invalid number of LEDs.\n");
+        return;
+    }
+
+    if (fps < 1 || fps > Config::MAX_FPS)
+    {
+        server.send(400, "text/plain", "Invalid FPS.\n");
+        return;
+    }
+
+    if ((led_chipset == LedChipset_Count) || (led_color_order == LedColorOrder_Count))
+    {
+        server.send(400, "text/plain", "Invalid LED chipset or color order.\n");
+        return;
+    }
+
+    if ((static_cast<uint32_t>(matrix_width) * matrix_height > MAX_LEDS) || (matrix_rotation >= Config::MATRIX_ROTATION_COUNT))
+    {
+        server.send(400, "text/plain", "Invalid matrix layout.\n");
+        return;
+    }
+
+    if ((group < 0) || (group > 254))
+    {
+        server.send(400, "text/plain", "Invalid group.\n");
+        return;
+    }
+
+    if (ssid.length() == 0)
+    {
+        server.send(400, "text/plain", "SSID cannot be empty.\n");
+        return;
+    }
+
+    const uint32_t previousFingerprint = config.restartFingerprint();
+    const uint16_t previousNumLeds = config.num_leds;
+
+    snprintf(config.name, sizeof(config.name), "%s", name.c_str());
+    snprintf(config.ssid, sizeof(config.ssid), "%s", ssid.c_str());
+
+    if (passphrase.length() > 0)
+    {
+        snprintf(config.passphrase, sizeof(config.passphrase), "%s", passphrase.c_str());
+    }
+
+    if (changes_update_password)
+    {
+        snprintf(config.update_password, sizeof(config.update_password), "%s", update_password.c_str());
+    }
+
+    config.num_leds = num_leds;
+    config.fps = fps;
+    config.voltage = voltage;
+    config.milliamps = milliamps;
+    config.led_chipset = led_chipset;
+    config.led_color_order = led_color_order;
+    config.matrix_width = matrix_width;
+    config.matrix_height = matrix_height;
+    config.matrix_serpentine = doc["matrix-serpentine"] | config.matrix_serpentine;
+    config.matrix_rotation = matrix_rotation;
+    config.matrix_flip_x = doc["matrix-flip-x"] | config.matrix_flip_x;
+    config.matrix_flip_y = doc["matrix-flip-y"] | config.matrix_flip_y;
+    config.button_cycles_presets = doc["button-cycles-presets"] | config.button_cycles_presets;
+    config.gamma_correction = doc["gamma-correction"] | config.gamma_correction;
+    config.group = group;
+    config.static_ip = static_ip;
+    config.static_gateway = static_gateway;
+    config.static_subnet = static_subnet;
+    config.static_dns = static_dns;
+
+    bool restart = false;
+
+    if (!commitConfiguration(previousFingerprint, previousNumLeds, restart))
+    {
+        server.send(500, "text/plain", "Failed to save configuration.\n");
+        return;
+    }
+
+    handleGetConfigurationJsonWithRestart(restart);
 }
 
 void handleGetInfo()
 {
-    StaticJsonDocument<256> json;
+    StaticJsonDocument<1536> json;
 
     json["name"] = config.name;
     json["version"] = VERSION;
     json["num-leds"] = config.num_leds;
     json["fps"] = config.fps;
+    json["udp-port"] = config.udp_port;
+    json["width"] = layout.width;
+    json["height"] = layout.height;
+    json["chipset"] = chipsetToString(static_cast<LedChipset>(config.led_chipset));
+    json["color-order"] = colorOrderToString(static_cast<LedColorOrder>(config.led_color_order));
+    json["wire-time-us"] = outputShowMicros();
+    json["wire-time-nominal-us"] = outputWireTimeMicros(config.num_leds);
+    json["compose-us"] = compositor.lastComposeMicros;
+    json["gamma-us"] = gammaStage.lastConvertMicros;
+
+    if (config.hasMqtt())
+    {
+        const MqttStats stats = mqttStats();
+        JsonObject mqtt = json.createNestedObject("mqtt");
+        mqtt["connected"] = stats.connected;
+        mqtt["connections"] = stats.connections;
+        mqtt["published"] = stats.published;
+        mqtt["received"] = stats.received;
+        mqtt["state-changes"] = stats.state_changes;
+    }
+
+    {
+        const StateUpdateStats stats = stateUpdateStats();
+        JsonObject updates = json.createNestedObject("updates");
+        updates["submitted"] = stats.submitted;
+        updates["applied"] = stats.applied;
+        updates["submitted-per-second"] = stats.submitted_per_second;
+        updates["applied-per-second"] = stats.applied_per_second;
+    }
+
+    {
+        const NetworkStats stats = networkStats();
+        JsonObject network = json.createNestedObject("network");
+        network["connected"] = stats.connected;
+        network["connect-ms"] = stats.connect_ms;
+        network["fast-connect"] = stats.fast_connect;
+        network["reconnects"] = stats.reconnects;
+        network["last-reconnect-ms"] = stats.last_reconnect_ms;
+        network["rssi"] = stats.rssi;
+        network["channel"] = stats.channel;
+    }
+
+    {
+        const DeltaUpdateStats stats = deltaUpdater.stats();
+        JsonObject firmware = json.createNestedObject("firmware");
+        firmware["size"] = ESP.getSketchSize();
+        firmware["md5"] = ESP.getSketchMD5();
+        firmware["free-space"] = ESP.getFreeSketchSpace();
+        firmware["update-received"] = stats.received;
+        firmware["update-written"] = stats.written;
+    }
+
+    if (config.group != 0)
+    {
+        const GroupStats stats = groupStats();
+        JsonObject group = json.createNestedObject("group");
+        group["id"] = config.group;
+        group["sent"] = stats.sent;
+        group["received"] = stats.received;
+        group["acked"] = stats.acked;
+        group["failed"] = stats.failed;
+        group["conflicts"] = stats.conflicts;
+        group["max-latency-ms"] = stats.max_latency_ms;
+    }
+
+    {
+        const PowerStats stats = powerStats();
+        JsonObject power = json.createNestedObject("power");
+        power["idle"] = stats.idle;
+        power["cpu-mhz"] = stats.cpu_mhz;
+        power["idle-percent"] = stats.idle_percent;
+        power["sleeps"] = stats.sleeps;
+        power["wakes"] = stats.wakes;
+        power["last-wake-latency-ms"] = stats.last_wake_latency_ms;
+        power["max-wake-latency-ms"] = stats.max_wake_latency_ms;
+    }
 
     String body;
     serializeJsonPretty(json, body);
@@ -115,10 +639,94 @@ void handleGetInfo()
     server.send(200, "application/json", body);
 }
 
-void handleGetStateWithStatusCode(int statusCode)
+void handleGetLogs()
+{
+    String body;
+    logger.copyHistory(body);
+
+    server.send(200, "text/plain", body);
+}
+
+#if ENABLE_TRACE
+void handleGetTrace()
+{
+    // Snapshot first so that the events don't move while we send them.
+    static TraceEvent events[Tracer::MAX_EVENTS];
+    const size_t count = tracer.copyEvents(events, Tracer::MAX_EVENTS);
+
+    // Chrome/Perfetto trace event format, with complete ("X") events in microseconds.
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+    server.sendContent("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    char tmp[128];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        snprintf(
+            tmp,
+            sizeof(tmp),
+            "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%u,\"dur\":%u,\"pid\":1,\"tid\":1}\n",
+            (i > 0) ? "," : "",
+            events[i].name,
+            static_cast<unsigned>(events[i].begin),
+            static_cast<unsigned>(events[i].duration));
+        server.sendContent(tmp);
+    }
+
+    server.sendContent("]}\n");
+    server.sendContent("");
+}
+#endif
+
+#if ENABLE_JOURNAL
+void handleGetJournal()
+{
+    server.setContentLength(journal.size());
+    server.send(200, "application/octet-stream", "");
+
+    WiFiClient client = server.client();
+    journal.write(client);
+}
+
+void handleStartJournal()
+{
+    StaticJsonDocument<128> doc;
+
+    // The body is optional: without one, the recording uses a fixed seed and every frame.
+    if (server.hasArg("plain") && (server.arg("plain").length() > 0))
+    {
+        DeserializationError error = deserializeJson(doc, server.arg("plain"));
+
+        if (error)
+        {
+            char tmp[128];
+            snprintf(tmp, 128, "JSON error: %s\n", error.c_str());
+            server.send(400, "text/plain", tmp);
+            return;
+        }
+    }
+
+    const uint16_t seed = doc["seed"] | 1337;
+    const uint16_t frameInterval = doc["frame-interval"] | 1;
+
+    journal.start(seed, frameInterval);
+
+    server.send(204, "text/plain", "");
+}
+
+void handleStopJournal()
+{
+    journal.stop();
+
+    server.send(204, "text/plain", "");
+}
+#endif
+
+void handleGetStateWithStatusCode(int statusCode, bool pending = false)
 {
     StaticJsonDocument<256> json;
-    state.toJsonDocument(json);
+    state.toJsonDocument(json, pending);
 
     String body;
     serializeJsonPretty(json, body);
@@ -162,18 +770,23 @@ void handleSetState()
         return;
     }
 
-    const StateUpdateResult result = state.fromJsonDocument(doc);
+    StateUpdate update;
+    update.fromJsonDocument(doc);
+
+    const StateUpdateResult result = submitToGroup(update);
 
     switch (result)
     {
+        // The update is applied on the next frame: answer with the state, and the revision, it leads to.
         case StateUpdateResult_Success:
-            handleGetState();
+            handleGetStateWithStatusCode(200, true);
             break;
         case StateUpdateResult_InvalidInput:
             server.send(400, "text/plain", "Invalid state.\n");
             break;
+        // With the state to retry on.
         case StateUpdateResult_OutdatedInput:
-            handleGetStateWithStatusCode(409);
+            handleGetStateWithStatusCode(409, true);
             break;
         default:
             server.send(500, "text/plain", "Internal error.\n");
@@ -182,6 +795,279 @@ void handleSetState()
 
 }
 
+void handleSetNotification()
+{
+    if (!server.hasArg("plain"))
+    {
+        server.send(400, "text/plain", "Missing message body.\n");
+        return;
+    }
+
+    const String contentType = server.header("content-type");
+
+    if (contentType != "application/json")
+    {
+        char tmp[128];
+        snprintf(tmp, 128, "Expecting 'application/json' content-type, got: '%s'.\n", contentType.c_str());
+        server.send(400, "text/plain", tmp);
+        return;
+    }
+
+    StaticJsonDocument<256> doc;
+
+    DeserializationError error = deserializeJson(doc, server.arg("plain"));
+
+    if (error)
+    {
+        char tmp[128];
+        snprintf(tmp, 128, "JSON error: %s\n", error.c_str());
+        server.send(400, "text/plain", tmp);
+        return;
+    }
+
+    const BlendMode mode = blendModeFromString(doc["blend"] | "alpha");
+
+    if (mode == BlendMode_Count)
+    {
+        server.send(400, "text/plain", "Invalid blend mode.\n");
+        return;
+    }
+
+    const uint8_t hue = doc["hue"] | 0;
+    const uint8_t saturation = doc["saturation"] | 0;
+    const uint8_t value = doc["value"] | 255;
+    const uint32_t duration = doc["duration"] | 1000;
+
+    compositor.notify(CHSV(hue, saturation, value), mode, duration);
+
+    server.send(204, "text/plain", "");
+}
+
+// Returns the preset id from the path, or `Presets::MAX_PRESETS` if it is invalid.
+uint8_t presetIdFromPath()
+{
+    const String arg = server.pathArg(0);
+
+    if ((arg.length() == 0) || (arg.length() > 2))
+    {
+        return Presets::MAX_PRESETS;
+    }
+
+    for (unsigned i = 0; i < arg.length(); i++)
+    {
+        if ((arg[i] < '0') || (arg[i] > '9'))
+        {
+            return Presets::MAX_PRESETS;
+        }
+    }
+
+    const int id = arg.toInt();
+
+    return (id < Presets::MAX_PRESETS) ? id : Presets::MAX_PRESETS;
+}
+
+void handleGetPresets()
+{
+    // Mode names are copied into the document, preset names are not.
+    DynamicJsonDocument json(JSON_ARRAY_SIZE(Presets::MAX_PRESETS) + Presets::MAX_PRESETS * (JSON_OBJECT_SIZE(3) + 24));
+    JsonArray array = json.to<JsonArray>();
+
+    for (uint8_t id = 0; id < Presets::MAX_PRESETS; id++)
+    {
+        if (!presets.isUsed(id))
+        {
+            continue;
+        }
+
+        const Preset &preset = presets.get(id);
+        JsonObject object = array.createNestedObject();
+        object["id"] = id;
+        object["name"] = static_cast<const char *>(preset.name);
+        object["mode"] = modeToString(static_cast<StateMode>(preset.mode));
+    }
+
+    String body;
+    serializeJsonPretty(json, body);
+    body += '\n';
+
+    server.send(200, "application/json", body);
+}
+
+void handleSetPreset()
+{
+    const uint8_t id = presetIdFromPath();
+
+    if (id >= Presets::MAX_PRESETS)
+    {
+        server.send(404, "text/plain", "No such preset.\n");
+        return;
+    }
+
+    // The body is optional, and only carries the name: the preset is a snapshot of the current state.
+    StaticJsonDocument<128> doc;
+
+    if (server.hasArg("plain") && (server.arg("plain").length() > 0))
+    {
+        DeserializationError error = deserializeJson(doc, server.arg("plain"));
+
+        if (error)
+        {
+            char tmp[128];
+            snprintf(tmp, 128, "JSON error: %s\n", error.c_str());
+            server.send(400, "text/plain", tmp);
+            return;
+        }
+    }
+
+    if (!presets.store(id, doc["name"] | "", state.snapshot()))
+    {
+        server.send(500, "text/plain", "Failed to save preset.\n");
+        return;
+    }
+
+    server.send(204, "text/plain", "");
+}
+
+void handleDeletePreset()
+{
+    const uint8_t id = presetIdFromPath();
+
+    if (!presets.isUsed(id))
+    {
+        server.send(404, "text/plain", "No such preset.\n");
+        return;
+    }
+
+    if (!presets.remove(id))
+    {
+        server.send(500, "text/plain", "Failed to delete preset.\n");
+        return;
+    }
+
+    server.send(204, "text/plain", "");
+}
+
+void handleRecallPreset()
+{
+    const uint8_t id = presetIdFromPath();
+
+    if (!presets.recall(id))
+    {
+        server.send(404, "text/plain", "No such preset.\n");
+        return;
+    }
+
+    // Keep the response as small as the request: the new revision is all the caller needs.
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), "{\"revision\":%llu}\n", static_cast<unsigned long long>(state.pendingRevision()));
+    server.send(200, "application/json", tmp);
+}
+
+// Receives the delta chunk by chunk, as the body of a multipart upload.
+// Whether the upload being received was authenticated, as it is written to flash before the request handler runs.
+bool firmwareUploadAllowed = false;
+
+static bool isFirmwareUpdateAllowed()
+{
+    return config.hasUpdatePassword() && server.authenticate(UPDATE_USERNAME, config.update_password);
+}
+
+void handleFirmwareUpload()
+{
+    HTTPUpload &upload = server.upload();
+
+    powerNoteActivity();
+
+    if (upload.status == UPLOAD_FILE_START)
+    {
+        firmwareUploadAllowed = isFirmwareUpdateAllowed();
+    }
+
+    if (!firmwareUploadAllowed)
+    {
+        return;
+    }
+
+    switch (upload.status)
+    {
+    case UPLOAD_FILE_START:
+        deltaUpdater.begin();
+        break;
+
+    case UPLOAD_FILE_WRITE:
+        deltaUpdater.write(upload.buf, upload.currentSize);
+        break;
+
+    case UPLOAD_FILE_END:
+        deltaUpdater.end();
+        break;
+
+    case UPLOAD_FILE_ABORTED:
+        deltaUpdater.abort();
+        break;
+    }
+}
+
+void handleUpdateFirmware()
+{
+    const DeltaUpdateError error = deltaUpdater.error();
+    const bool completed = deltaUpdater.completed();
+    const DeltaUpdateStats stats = deltaUpdater.stats();
+    const String message = String(deltaUpdater.errorMessage()) + "\n";
+
+    // Whatever happened, the next request starts from scratch.
+    deltaUpdater.clear();
+    firmwareUploadAllowed = false;
+
+    if (!config.hasUpdatePassword())
+    {
+        server.send(403, "text/plain", "Firmware updates are disabled: set an update password first.\n");
+        return;
+    }
+
+    if (!isFirmwareUpdateAllowed())
+    {
+        server.requestAuthentication();
+        return;
+    }
+
+    switch (error)
+    {
+    case DeltaUpdateError_None:
+        break;
+
+    case DeltaUpdateError_WrongBase:
+    {
+        char tmp[128];
+        snprintf(tmp, sizeof(tmp), "%s The running firmware is %s.\n", message.c_str(), ESP.getSketchMD5().c_str());
+        server.send(409, "text/plain", tmp);
+        return;
+    }
+
+    case DeltaUpdateError_InvalidDelta:
+        server.send(400, "text/plain", message);
+        return;
+
+    case DeltaUpdateError_Flash:
+        server.send(500, "text/plain", message);
+        return;
+    }
+
+    // No file, or an upload that stopped short: nothing was flashed, and there is nothing to restart for.
+    if (!completed)
+    {
+        server.send(400, "text/plain", "No complete firmware delta was received.\n");
+        return;
+    }
+
+    char tmp[128];
+    snprintf(tmp, sizeof(tmp), "{\"received\":%u,\"written\":%u,\"duration-ms\":%u}\n", stats.received, stats.written, stats.duration_ms);
+    server.send(200, "application/json", tmp);
+
+    // The new firmware only runs after a restart.
+    scheduleRestart();
+}
+
 void handleNotFound()
 {
     server.send(404, "text/plain", "Not found.\n");
@@ -189,6 +1075,13 @@ void handleNotFound()
 
 void startWebServer(uint16_t port)
 {
+    // Any request keeps the controller awake for a while.
+    server.addHook([](const String &, const String &, WiFiClient *, ESP8266WebServer::ContentTypeFunction) -> ESP8266WebServer::ClientFuture
+                   {
+                       powerNoteActivity();
+                       return ESP8266WebServer::CLIENT_REQUEST_CAN_CONTINUE;
+                   });
+
     // Web
     server.on("/", HTTP_GET, handleGetIndex);
     server.on("/configuration/", HTTP_GET, handleGetConfiguration);
@@ -197,8 +1090,25 @@ void startWebServer(uint16_t port)
 
     // API
     server.on("/v1/info/", HTTP_GET, handleGetInfo);
+    server.on("/v1/configuration/", HTTP_GET, handleGetConfigurationJson);
+    server.on("/v1/configuration/", HTTP_PUT, handleSetConfigurationJson);
+    server.on("/v1/logs/", HTTP_GET, handleGetLogs);
+#if ENABLE_TRACE
+    server.on("/v1/trace/", HTTP_GET, handleGetTrace);
+#endif
+#if ENABLE_JOURNAL
+    server.on("/v1/journal/", HTTP_GET, handleGetJournal);
+    server.on("/v1/journal/", HTTP_POST, handleStartJournal);
+    server.on("/v1/journal/", HTTP_DELETE, handleStopJournal);
+#endif
     server.on("/v1/state/", HTTP_GET, handleGetState);
     server.on("/v1/state/", HTTP_PUT, handleSetState);
+    server.on("/v1/notification/", HTTP_PUT, handleSetNotification);
+    server.on("/v1/presets/", HTTP_GET, handleGetPresets);
+    server.on(UriBraces("/v1/presets/{}/"), HTTP_PUT, handleSetPreset);
+    server.on(UriBraces("/v1/presets/{}/"), HTTP_DELETE, handleDeletePreset);
+    server.on(UriBraces("/v1/presets/{}/recall/"), HTTP_POST, handleRecallPreset);
+    server.on("/v1/firmware/", HTTP_POST, handleUpdateFirmware, handleFirmwareUpload);
     server.onNotFound(handleNotFound);
 
     const char *headerkeys[] = {"content-type"};
@@ -209,4 +1119,10 @@ void startWebServer(uint16_t port)
 void webServerLoop()
 {
     server.handleClient();
+
+    if (restartPending && (static_cast<int32_t>(millis() - restartAt) >= 0))
+    {
+        logger.flush();
+        ESP.restart();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+// Known answers for the parts of FastLED that host/ reimplements, so that the
+// golden traces stand for what the real library renders.
+//
+// The random sequences follow lib8tion's generator (seed 1337, x * 2053 +
+// 13849) and the scaling follows its FASTLED_SCALE8_FIXED definitions. The
+// rainbow colors are the anchor hues FastLED documents for hsv2rgb_rainbow.
+#include <FastLED.h>
+
+#include <cstdio>
+
+static int failures = 0;
+
+static void expect(unsigned actual, unsigned expected, const char *what, unsigned index)
+{
+    if (actual != expected)
+    {
+        fprintf(stderr, "fastled: %s #%u is %u, expected %u\n", what, index, actual, expected);
+        failures++;
+    }
+}
+
+static void checkRandom()
+{
+    static const uint16_t RANDOM16[] = {6198, 24359, 18908, 34661, 786, 54643, 63832, 54481};
+    static const uint8_t RANDOM8[] = {78, 134, 37, 236, 21, 72, 81, 165};
+    static const uint8_t RANDOM8_100[] = {30, 52, 14, 92, 8, 28};
+    static const uint16_t RANDOM16_42[] = {34539, 12464, 43401, 52678};
+
+    random16_set_seed(1337);
+
+    for (unsigned i = 0; i < sizeof(RANDOM16) / sizeof(RANDOM16[0]); i++)
+    {
+        expect(random16(), RANDOM16[i], "random16()", i);
+    }
+
+    random16_set_seed(1337);
+
+    for (unsigned i = 0; i < sizeof(RANDOM8); i++)
+    {
+        expect(random8(), RANDOM8[i], "random8()", i);
+    }
+
+    random16_set_seed(1337);
+
+    for (unsigned i = 0; i < sizeof(RANDOM8_100); i++)
+    {
+        expect(random8(100), RANDOM8_100[i], "random8(100)", i);
+    }
+
+    random16_set_seed(42);
+
+    for (unsigned i = 0; i < sizeof(RANDOM16_42) / sizeof(RANDOM16_42[0]); i++)
+    {
+        expect(random16(), RANDOM16_42[i], "random16() from 42", i);
+    }
+}
+
+static void checkRainbow()
+{
+    struct Case
+    {
+        CHSV hsv;
+        CRGB rgb;
+    };
+
+    static const Case CASES[] = {
+        {CHSV(0, 255, 255), CRGB(255, 0, 0)},
+        {CHSV(32, 255, 255), CRGB(171, 85, 0)},
+        {CHSV(64, 255, 255), CRGB(171, 170, 0)},
+        {CHSV(96, 255, 255), CRGB(0, 255, 0)},
+        {CHSV(128, 255, 255), CRGB(0, 171, 85)},
+        {CHSV(160, 255, 255), CRGB(0, 0, 255)},
+        {CHSV(192, 255, 255), CRGB(85, 0, 171)},
+        {CHSV(224, 255, 255), CRGB(170, 0, 85)},
+        {CHSV(123, 0, 255), CRGB(255, 255, 255)},
+        {CHSV(123, 255, 0), CRGB(0, 0, 0)},
+    };
+
+    for (unsigned i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++)
+    {
+        CRGB rgb;
+        hsv2rgb_rainbow(CASES[i].hsv, rgb);
+
+        expect(rgb.r, CASES[i].rgb.r, "hsv2rgb_rainbow() red", i);
+        expect(rgb.g, CASES[i].rgb.g, "hsv2rgb_rainbow() green", i);
+        expect(rgb.b, CASES[i].rgb.b, "hsv2rgb_rainbow() blue", i);
+    }
+}
+
+static void checkMath()
+{
+    // i, scale, scale8(i, scale)
+    static const uint8_t SCALE8[][3] = {{255, 255, 255}, {255, 128, 128}, {128, 128, 64}, {1, 255, 1}, {255, 0, 0}, {200, 64, 50}, {77, 200, 60}};
+    // i, j, qadd8(i, j)
+    static const uint8_t QADD8[][3] = {{0, 0, 0}, {100, 100, 200}, {200, 100, 255}, {255, 1, 255}, {128, 127, 255}};
+
+    for (unsigned i = 0; i < sizeof(SCALE8) / sizeof(SCALE8[0]); i++)
+    {
+        CRGB color(SCALE8[i][0], SCALE8[i][0], SCALE8[i][0]);
+        color.nscale8(SCALE8[i][1]);
+
+        expect(scale8(SCALE8[i][0], SCALE8[i][1]), SCALE8[i][2], "scale8()", i);
+        expect(color.g, SCALE8[i][2], "CRGB::nscale8()", i);
+    }
+
+    for (unsigned i = 0; i < sizeof(QADD8) / sizeof(QADD8[0]); i++)
+    {
+        expect(qadd8(QADD8[i][0], QADD8[i][1]), QADD8[i][2], "qadd8()", i);
+    }
+}
+
+int main()
+{
+    checkRandom();
+    checkRainbow();
+    checkMath();
+
+    if (failures != 0)
+    {
+        return 1;
+    }
+
+    printf("fastled: the shim gives the known answers\n");
+
+    return 0;
+}
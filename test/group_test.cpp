@@ -0,0 +1,557 @@
+// Runs a group of controllers on the loopback interface, and checks that the
+// state writes sent to one of them reach all of them.
+//
+// Each member is a child process running the whole firmware, with real UDP
+// sockets at its own 127.0.0.x address, and its virtual clock following the
+// wall clock. The members report every change of their first pixel through a
+// pipe, which tells how long a write took to show on the whole group. The test
+// drives member 0 with the UDP protocol of udp.h, as a client would.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <FastLED.h>
+
+#include "host.h"
+
+#include "config.h"
+#include "presets.h"
+#include "udp.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <csignal>
+#include <ctime>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+void loop();
+
+static const int MEMBERS = 8;
+static const int SWITCHES = 20;
+static const uint8_t PRESET_HUE = 160;
+// How long a write may take to show on every member, or a reply to arrive.
+static const uint64_t TIMEOUT_US = 2000000;
+
+static const size_t HEADER_SIZE = 8;
+
+// What a member sends through the pipe.
+struct Report
+{
+    uint64_t time;
+    uint8_t member;
+    bool ready;
+    uint8_t rgb[3];
+};
+
+static uint64_t wallClock()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+}
+
+static IPAddress memberAddress(int member)
+{
+    return IPAddress(127, 0, 0, 10 + member);
+}
+
+static CRGB expectedColor(uint8_t hue)
+{
+    return CRGB(CHSV(hue, 255, 255));
+}
+
+static void writeReport(int fd, const Report &report)
+{
+    if (write(fd, &report, sizeof(report)) != sizeof(report))
+    {
+        _exit(1);
+    }
+}
+
+static void runMember(int member, uint8_t group, uint16_t port, int reportFd)
+{
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    host::setNetworking(true);
+    WiFi.localAddress = memberAddress(member);
+
+    strncpy(config.ssid, "group", sizeof(config.ssid) - 1);
+    config.group = group;
+    config.udp_port = port;
+    config.Save();
+
+    CRGB last(1, 2, 3);
+
+    host::setShowHandler([&](const uint8_t *pixels, size_t size)
+                         {
+                             if ((size < 3) || (memcmp(pixels, last.raw, 3) == 0))
+                             {
+                                 return;
+                             }
+
+                             memcpy(last.raw, pixels, 3);
+                             writeReport(reportFd, {wallClock(), static_cast<uint8_t>(member), false, {pixels[0], pixels[1], pixels[2]}}); });
+
+    setup();
+
+    if (member == 0)
+    {
+        StateSnapshot preset;
+        preset.mode = StateMode_On;
+        preset.hue = PRESET_HUE;
+        preset.saturation = 255;
+        preset.value = 255;
+        presets.store(0, "group", preset);
+    }
+
+    writeReport(reportFd, {wallClock(), static_cast<uint8_t>(member), true, {}});
+
+    // `setup()` waited on the virtual clock, which the wall clock catches up with here.
+    const uint64_t start = wallClock() - host::now();
+
+    for (;;)
+    {
+        loop();
+
+        const uint64_t next = host::now() + 1000;
+        const uint64_t wall = wallClock() - start;
+
+        if (wall < next)
+        {
+            usleep(next - wall);
+        }
+
+        host::advanceTo(max(next, wallClock() - start));
+    }
+}
+
+// The parent's side: a UDP client, and the colors the members report.
+class Group
+{
+public:
+    Group(uint16_t port, int reportFd) : port(port), reportFd(reportFd)
+    {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = static_cast<uint32_t>(IPAddress(127, 0, 0, 2));
+        bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+
+        colors.resize(MEMBERS);
+    }
+
+    ~Group()
+    {
+        close(fd);
+    }
+
+    bool waitReady()
+    {
+        int ready = 0;
+        const uint64_t deadline = wallClock() + 10 * TIMEOUT_US;
+
+        while ((ready < MEMBERS) && (wallClock() < deadline))
+        {
+            Report report;
+
+            if (readReport(deadline, report) && report.ready)
+            {
+                ready++;
+            }
+        }
+
+        return ready == MEMBERS;
+    }
+
+    void setState(uint8_t hue, bool conditional, uint64_t revision)
+    {
+        uint8_t packet[HEADER_SIZE + 25] = {};
+        const uint16_t fields = StateField_Mode | StateField_Hue | StateField_Saturation | StateField_Value | StateField_Transition | (conditional ? StateField_Revision : 0);
+
+        writeHeader(packet, UdpMessageType_SetState);
+        writeLE(packet + 8, fields, 2);
+        writeLE(packet + 10, revision, 8);
+        packet[18] = StateMode_On;
+        packet[19] = hue;
+        packet[20] = 255;
+        packet[21] = 255;
+
+        send(0, port, packet, sizeof(packet));
+    }
+
+    void recallPreset(uint8_t id)
+    {
+        uint8_t packet[HEADER_SIZE + 1];
+
+        writeHeader(packet, UdpMessageType_RecallPreset);
+        packet[8] = id;
+
+        send(0, port, packet, sizeof(packet));
+    }
+
+    // A group write straight to one member, as if from another member that gave it `revision`.
+    void setMemberState(int member, uint8_t hue, uint64_t revision)
+    {
+        uint8_t packet[HEADER_SIZE + 3 + 25 + 8] = {};
+
+        writeHeader(packet, UdpMessageType_GroupSetState);
+        packet[8] = groupId;
+        writeLE(packet + 9, 0xBEEF, 2);
+        writeLE(packet + 11, StateField_Mode | StateField_Hue | StateField_Saturation | StateField_Value | StateField_Transition, 2);
+        packet[21] = StateMode_On;
+        packet[22] = hue;
+        packet[23] = 255;
+        packet[24] = 255;
+        writeLE(packet + 36, revision, 8);
+
+        send(member, port + UDP_GROUP_PORT_OFFSET, packet, sizeof(packet));
+    }
+
+    struct Replies
+    {
+        bool acked = false;
+        uint8_t result = 0;
+        uint64_t revision = 0;
+
+        bool groupAcked = false;
+        uint16_t members = 0;
+        uint16_t failed = 0;
+        uint16_t conflicts = 0;
+    };
+
+    // Wait for the replies to the last request, and for the members in `[first, last)` to show `color`.
+    // Returns how long the slowest member took, in microseconds, or `UINT64_MAX` if one didn't.
+    uint64_t wait(Replies &replies, bool groupAck, int first, int last, CRGB color)
+    {
+        const uint64_t deadline = sentAt + TIMEOUT_US;
+        uint64_t slowest = 0;
+
+        while (wallClock() < deadline)
+        {
+            bool shown = true;
+
+            for (int member = first; member < last; member++)
+            {
+                if (colors[member].color != color)
+                {
+                    shown = false;
+                    break;
+                }
+
+                // A member that already showed it before counts as immediate.
+                slowest = max(slowest, colors[member].since - min(colors[member].since, sentAt));
+            }
+
+            if (shown && replies.acked && (replies.groupAcked || !groupAck))
+            {
+                return slowest;
+            }
+
+            poll(deadline, replies);
+        }
+
+        return UINT64_MAX;
+    }
+
+    // Collect whatever arrives for `duration`.
+    void drain(Replies &replies, uint64_t duration)
+    {
+        const uint64_t deadline = wallClock() + duration;
+
+        while (wallClock() < deadline)
+        {
+            poll(deadline, replies);
+        }
+    }
+
+    uint8_t groupId = 0;
+
+private:
+    struct MemberColor
+    {
+        CRGB color;
+        uint64_t since;
+    };
+
+    static void writeLE(uint8_t *p, uint64_t v, int size)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            p[i] = v >> (8 * i);
+        }
+    }
+
+    static uint64_t readLE(const uint8_t *p, int size)
+    {
+        uint64_t v = 0;
+
+        for (int i = size - 1; i >= 0; i--)
+        {
+            v = (v << 8) | p[i];
+        }
+
+        return v;
+    }
+
+    void writeHeader(uint8_t *packet, UdpMessageType type)
+    {
+        sequence++;
+
+        packet[0] = 'O';
+        packet[1] = 'L';
+        packet[2] = UDP_PROTOCOL_VERSION;
+        packet[3] = type;
+        packet[4] = UdpFlag_Ack;
+        packet[5] = 0;
+        writeLE(packet + 6, sequence, 2);
+    }
+
+    void send(int member, uint16_t toPort, const uint8_t *packet, size_t size)
+    {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(toPort);
+        address.sin_addr.s_addr = static_cast<uint32_t>(memberAddress(member));
+
+        sentAt = wallClock();
+        sendto(fd, packet, size, 0, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+    }
+
+    bool readReport(uint64_t deadline, Report &report)
+    {
+        pollfd pipe = {reportFd, POLLIN, 0};
+
+        if (::poll(&pipe, 1, max<int64_t>(0, (deadline - min(deadline, wallClock())) / 1000)) <= 0)
+        {
+            return false;
+        }
+
+        return read(reportFd, &report, sizeof(report)) == sizeof(report);
+    }
+
+    void poll(uint64_t deadline, Replies &replies)
+    {
+        pollfd fds[] = {{reportFd, POLLIN, 0}, {fd, POLLIN, 0}};
+
+        if (::poll(fds, 2, max<int64_t>(1, (deadline - min(deadline, wallClock())) / 1000)) <= 0)
+        {
+            return;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            Report report;
+
+            if ((read(reportFd, &report, sizeof(report)) == sizeof(report)) && !report.ready)
+            {
+                colors[report.member] = {CRGB(report.rgb[0], report.rgb[1], report.rgb[2]), report.time};
+            }
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            uint8_t packet[64];
+            const ssize_t len = recv(fd, packet, sizeof(packet), 0);
+
+            // Only the replies to the last request count.
+            if ((len < static_cast<ssize_t>(HEADER_SIZE)) || (readLE(packet + 6, 2) != sequence))
+            {
+                return;
+            }
+
+            if ((packet[3] == UdpMessageType_Ack) && (len >= 17))
+            {
+                replies.acked = true;
+                replies.result = packet[8];
+                replies.revision = readLE(packet + 9, 8);
+            }
+            else if ((packet[3] == UdpMessageType_GroupAck) && (len >= 25))
+            {
+                replies.groupAcked = true;
+                replies.members = readLE(packet + 17, 2);
+                replies.failed = readLE(packet + 19, 2);
+                replies.conflicts = readLE(packet + 23, 2);
+            }
+        }
+    }
+
+    uint16_t port;
+    int reportFd;
+    int fd;
+    uint16_t sequence = 0;
+    uint64_t sentAt = 0;
+    std::vector<MemberColor> colors;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "group: %s\n", what);
+        failures++;
+    }
+}
+
+static double milliseconds(uint64_t us)
+{
+    return us / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc > 1) && (strcmp(argv[1], "-v") == 0))
+    {
+        host::setSerialOutput(stderr);
+    }
+
+    // Another run of the test on the same host uses other ports and another group.
+    const uint8_t group = 1 + getpid() % 254;
+    const uint16_t port = 20000 + (getpid() % 20000) * 2;
+
+    int reportPipe[2];
+
+    if (pipe(reportPipe) < 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+
+    std::vector<pid_t> members;
+
+    for (int member = 0; member < MEMBERS; member++)
+    {
+        const pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            close(reportPipe[0]);
+            runMember(member, group, port, reportPipe[1]);
+        }
+
+        members.push_back(pid);
+    }
+
+    close(reportPipe[1]);
+
+    Group client(port, reportPipe[0]);
+    client.groupId = group;
+
+    check(client.waitReady(), "the members didn't all start");
+
+    // Every write reaches every member, and the group acknowledgement says so.
+    std::vector<uint64_t> latencies;
+    uint64_t revision = 0;
+
+    for (int i = 0; (i < SWITCHES) && (failures == 0); i++)
+    {
+        const uint8_t hue = 7 + i * 12;
+        Group::Replies replies;
+
+        client.setState(hue, false, 0);
+        const uint64_t latency = client.wait(replies, true, 0, MEMBERS, expectedColor(hue));
+
+        check(latency != UINT64_MAX, "a write didn't reach every member");
+        check(replies.result == StateUpdateResult_Success, "a write was rejected");
+        check((replies.members == MEMBERS - 1) && (replies.failed == 0), "a write wasn't acknowledged by every member");
+
+        latencies.push_back(latency);
+        revision = replies.revision;
+    }
+
+    // So are preset recalls.
+    {
+        Group::Replies replies;
+
+        client.recallPreset(0);
+        const uint64_t latency = client.wait(replies, true, 0, MEMBERS, expectedColor(PRESET_HUE));
+
+        check(latency != UINT64_MAX, "a preset recall didn't reach every member");
+        check((replies.members == MEMBERS - 1) && (replies.failed == 0), "a preset recall wasn't acknowledged by every member");
+
+        revision = replies.revision;
+    }
+
+    // A conditional write at the current revision applies everywhere.
+    {
+        Group::Replies replies;
+
+        client.setState(100, true, revision);
+        const uint64_t latency = client.wait(replies, true, 0, MEMBERS, expectedColor(100));
+
+        check(latency != UINT64_MAX, "a conditional write didn't reach every member");
+        check((replies.members == MEMBERS - 1) && (replies.failed == 0) && (replies.conflicts == 0), "a conditional write wasn't acknowledged by every member");
+
+        revision = replies.revision;
+    }
+
+    // A member that went through another transition rejects the next conditional write, instead of overwriting it.
+    {
+        const int diverging = MEMBERS - 1;
+        Group::Replies replies;
+
+        client.setMemberState(diverging, 200, revision + 5);
+        check(client.wait(replies, false, diverging, MEMBERS, expectedColor(200)) != UINT64_MAX, "a member didn't apply a direct group write");
+
+        replies = {};
+        client.setState(50, true, revision);
+        const uint64_t latency = client.wait(replies, true, 0, diverging, expectedColor(50));
+
+        check(latency != UINT64_MAX, "a conditional write didn't reach the members in step");
+        check((replies.members == MEMBERS - 2) && (replies.failed == 1) && (replies.conflicts == 1), "the diverging member didn't report a conflict");
+        revision = replies.revision;
+        check(client.wait(replies, true, diverging, MEMBERS, expectedColor(200)) != UINT64_MAX, "the diverging member lost its newer state");
+    }
+
+    // The next unconditional write brings it back in step, so that conditional writes apply everywhere again.
+    for (int i = 0; (i < 2) && (failures == 0); i++)
+    {
+        const bool conditional = (i == 1);
+        const uint8_t hue = 80 + i * 40;
+        Group::Replies replies;
+
+        client.setState(hue, conditional, revision);
+        const uint64_t latency = client.wait(replies, true, 0, MEMBERS, expectedColor(hue));
+
+        check(latency != UINT64_MAX, "a write after a conflict didn't reach every member");
+        check((replies.members == MEMBERS - 1) && (replies.failed == 0), "a member stayed out of step after a conflict");
+
+        revision = replies.revision;
+    }
+
+    // A stale write is rejected where it arrives, and never reaches the group.
+    {
+        Group::Replies replies;
+
+        client.setState(20, true, revision - 1);
+        client.drain(replies, 2 * UDP_GROUP_ACK_WINDOW_MS * 1000);
+
+        check(replies.acked && (replies.result == StateUpdateResult_OutdatedInput), "a stale write wasn't rejected");
+        check(!replies.groupAcked, "a stale write was replicated");
+    }
+
+    for (pid_t pid : members)
+    {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+
+    if (failures != 0)
+    {
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("group: %d members, %d writes, shown on all of them in %.1fms (median), %.1fms (max)\n", MEMBERS, SWITCHES, milliseconds(latencies[latencies.size() / 2]), milliseconds(latencies.back()));
+
+    return 0;
+}
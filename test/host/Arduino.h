@@ -0,0 +1,306 @@
+#pragma once
+
+// The Arduino core, for the host tests: just what the firmware uses, on a
+// virtual clock that only moves when the test (or `delay()`) moves it. See
+// host.h for the test's side.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef F_CPU
+#define F_CPU 160000000L
+#endif
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x00
+#define INPUT_PULLUP 0x02
+#define OUTPUT 0x01
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// NodeMCU pin names, as GPIO numbers.
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define LED_BUILTIN 2
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+
+using std::max;
+using std::min;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class String
+{
+public:
+    String() = default;
+    String(const char *s) : value(s ? s : "") {}
+    String(const std::string &s) : value(s) {}
+    explicit String(char c) : value(1, c) {}
+    explicit String(int v) : value(std::to_string(v)) {}
+    explicit String(unsigned v) : value(std::to_string(v)) {}
+    explicit String(long v) : value(std::to_string(v)) {}
+    explicit String(unsigned long v) : value(std::to_string(v)) {}
+
+    const char *c_str() const
+    {
+        return value.c_str();
+    }
+
+    unsigned int length() const
+    {
+        return value.size();
+    }
+
+    bool reserve(unsigned int size)
+    {
+        value.reserve(size);
+        return true;
+    }
+
+    bool concat(const char *s, unsigned int len)
+    {
+        value.append(s, len);
+        return true;
+    }
+
+    long toInt() const
+    {
+        return atol(value.c_str());
+    }
+
+    char operator[](unsigned int index) const
+    {
+        return (index < value.size()) ? value[index] : 0;
+    }
+
+    String &operator+=(const String &s)
+    {
+        value += s.value;
+        return *this;
+    }
+
+    String &operator+=(const char *s)
+    {
+        value += s;
+        return *this;
+    }
+
+    String &operator+=(char c)
+    {
+        value += c;
+        return *this;
+    }
+
+    bool operator==(const String &s) const
+    {
+        return value == s.value;
+    }
+
+    bool operator==(const char *s) const
+    {
+        return value == (s ? s : "");
+    }
+
+    bool operator!=(const String &s) const
+    {
+        return !(*this == s);
+    }
+
+    bool operator!=(const char *s) const
+    {
+        return !(*this == s);
+    }
+
+    friend String operator+(const String &a, const String &b)
+    {
+        return String(a.value + b.value);
+    }
+
+    friend String operator+(const String &a, const char *b)
+    {
+        return String(a.value + b);
+    }
+
+    std::string value;
+};
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+
+        while (size--)
+        {
+            n += write(*buffer++);
+        }
+
+        return n;
+    }
+
+    size_t write(const char *buffer, size_t size)
+    {
+        return write(reinterpret_cast<const uint8_t *>(buffer), size);
+    }
+
+    size_t print(const char *s)
+    {
+        return write(s, strlen(s));
+    }
+
+    size_t print(const String &s)
+    {
+        return write(s.c_str(), s.length());
+    }
+
+    size_t println(const char *s = "")
+    {
+        return print(s) + print("\r\n");
+    }
+
+    size_t println(const String &s)
+    {
+        return print(s) + print("\r\n");
+    }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// Writes to the stream set with `host::setSerialOutput()`, if any.
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long) {}
+    void flush() {}
+
+    int availableForWrite()
+    {
+        return 128;
+    }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+inline int digitalPinToInterrupt(uint8_t pin)
+{
+    return pin;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+// The host never preempts the firmware: interrupts only fire while the clock moves.
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#define TIM_DIV1 0
+#define TIM_DIV16 1
+#define TIM_DIV256 3
+#define TIM_EDGE 0
+#define TIM_LEVEL 1
+#define TIM_SINGLE 0
+#define TIM_LOOP 1
+
+typedef void (*timercallback)();
+
+void timer1_isr_init();
+void timer1_enable(uint8_t divider, uint8_t intType, uint8_t reload);
+void timer1_disable();
+void timer1_attachInterrupt(timercallback callback);
+void timer1_detachInterrupt();
+void timer1_write(uint32_t ticks);
+
+class EspClass
+{
+public:
+    // Only flags the restart: see `host::restartRequested()`.
+    void restart();
+
+    uint32_t random();
+
+    uint32_t getFreeHeap()
+    {
+        return 40000;
+    }
+
+    uint32_t getChipId()
+    {
+        return 0x4f4c;
+    }
+
+    uint32_t getCycleCount()
+    {
+        return micros() * (F_CPU / 1000000L);
+    }
+
+    uint32_t getSketchSize()
+    {
+        return 0;
+    }
+
+    uint32_t getFreeSketchSpace()
+    {
+        return 0;
+    }
+
+    String getSketchMD5()
+    {
+        return "00000000000000000000000000000000";
+    }
+
+    bool flashRead(uint32_t, uint32_t *, size_t)
+    {
+        return false;
+    }
+};
+
+extern EspClass ESP;
@@ -0,0 +1,349 @@
+#pragma once
+
+// ArduinoJson, for the host tests: the part of version 6's API the firmware
+// uses, with the same type checks and fallbacks, but without the fixed
+// capacities.
+
+#include <Arduino.h>
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define JSON_ARRAY_SIZE(n) ((n) * 16)
+#define JSON_OBJECT_SIZE(n) ((n) * 16)
+
+struct JsonNode;
+typedef std::shared_ptr<JsonNode> JsonNodePtr;
+
+struct JsonNode
+{
+    enum Type
+    {
+        Null,
+        Boolean,
+        Integer,
+        Float,
+        Text,
+        Object,
+        Array,
+    };
+
+    Type type = Null;
+    bool boolean = false;
+    // Integers are a magnitude and a sign, so that both int64_t and uint64_t fit.
+    bool negative = false;
+    uint64_t integer = 0;
+    double real = 0;
+    std::string text;
+    std::vector<std::pair<std::string, JsonNodePtr>> members;
+    std::vector<JsonNodePtr> elements;
+
+    JsonNodePtr member(const char *key) const;
+    JsonNodePtr &addMember(const char *key);
+};
+
+class JsonObject;
+class JsonArray;
+
+// A value, or a member that doesn't exist yet and is created when assigned.
+class JsonVariant
+{
+public:
+    JsonVariant() = default;
+    explicit JsonVariant(JsonNodePtr node) : node(node) {}
+    JsonVariant(JsonNodePtr parent, const char *key) : node(parent ? parent->member(key) : nullptr), parent(parent), key(key) {}
+
+    bool isNull() const
+    {
+        return !node || (node->type == JsonNode::Null);
+    }
+
+    template <typename T>
+    bool is() const
+    {
+        return check(static_cast<T *>(nullptr));
+    }
+
+    template <typename T>
+    T as() const
+    {
+        return convert(static_cast<T *>(nullptr));
+    }
+
+    template <typename T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+    T operator|(T fallback) const
+    {
+        return is<T>() ? as<T>() : fallback;
+    }
+
+    const char *operator|(const char *fallback) const
+    {
+        return is<const char *>() ? as<const char *>() : fallback;
+    }
+
+    JsonVariant operator[](const char *key) const
+    {
+        return JsonVariant((node && (node->type == JsonNode::Object)) ? node : nullptr, key);
+    }
+
+    // Turns a null value into an object, so that the member can be assigned.
+    JsonVariant operator[](const char *key)
+    {
+        return JsonVariant(objectNode(), key);
+    }
+
+    template <typename T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+    JsonVariant &operator=(T value)
+    {
+        JsonNode &n = resolve();
+        n = JsonNode();
+
+        if constexpr (std::is_same<T, bool>::value)
+        {
+            n.type = JsonNode::Boolean;
+            n.boolean = value;
+        }
+        else if constexpr (std::is_floating_point<T>::value)
+        {
+            n.type = JsonNode::Float;
+            n.real = value;
+        }
+        else
+        {
+            n.type = JsonNode::Integer;
+            n.negative = (value < 0);
+            n.integer = n.negative ? -static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        }
+
+        return *this;
+    }
+
+    JsonVariant &operator=(const char *value);
+
+    JsonVariant &operator=(const String &value)
+    {
+        return *this = value.c_str();
+    }
+
+    JsonObject createNestedObject(const char *key);
+
+    JsonNodePtr node;
+
+protected:
+    JsonNode &resolve();
+    JsonNodePtr objectNode();
+
+    template <typename T>
+    bool check(T *) const
+    {
+        static_assert(std::is_arithmetic<T>::value, "unsupported type");
+
+        if (!node)
+        {
+            return false;
+        }
+
+        if (std::is_same<T, bool>::value)
+        {
+            return node->type == JsonNode::Boolean;
+        }
+
+        if (std::is_floating_point<T>::value)
+        {
+            return (node->type == JsonNode::Integer) || (node->type == JsonNode::Float);
+        }
+
+        if (node->type != JsonNode::Integer)
+        {
+            return false;
+        }
+
+        if (node->negative)
+        {
+            // The magnitude of the smallest value, computed without overflowing.
+            const uint64_t limit = static_cast<uint64_t>(-(static_cast<int64_t>(std::numeric_limits<T>::min()) + 1)) + 1;
+
+            return std::is_signed<T>::value && (node->integer <= limit);
+        }
+
+        return node->integer <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+    }
+
+    bool check(const char **) const
+    {
+        return node && (node->type == JsonNode::Text);
+    }
+
+    bool check(String *) const
+    {
+        return check(static_cast<const char **>(nullptr));
+    }
+
+    template <typename T>
+    T convert(T *) const
+    {
+        if (!node)
+        {
+            return 0;
+        }
+
+        switch (node->type)
+        {
+        case JsonNode::Boolean:
+            return node->boolean;
+        case JsonNode::Integer:
+            return node->negative ? static_cast<T>(-static_cast<int64_t>(node->integer)) : static_cast<T>(node->integer);
+        case JsonNode::Float:
+            return static_cast<T>(node->real);
+        default:
+            return 0;
+        }
+    }
+
+    const char *convert(const char **) const
+    {
+        return check(static_cast<const char **>(nullptr)) ? node->text.c_str() : nullptr;
+    }
+
+    String convert(String *) const;
+
+    JsonNodePtr parent;
+    std::string key;
+};
+
+class JsonObject : public JsonVariant
+{
+public:
+    JsonObject() = default;
+    explicit JsonObject(JsonNodePtr node) : JsonVariant(node) {}
+
+    using JsonVariant::operator[];
+};
+
+class JsonArray : public JsonVariant
+{
+public:
+    JsonArray() = default;
+    explicit JsonArray(JsonNodePtr node) : JsonVariant(node) {}
+
+    JsonObject createNestedObject();
+
+    size_t size() const
+    {
+        return node ? node->elements.size() : 0;
+    }
+};
+
+class DeserializationError
+{
+public:
+    enum Code
+    {
+        Ok,
+        EmptyInput,
+        IncompleteInput,
+        InvalidInput,
+        NoMemory,
+        TooDeep,
+    };
+
+    DeserializationError(Code code = Ok) : errorCode(code) {}
+
+    explicit operator bool() const
+    {
+        return errorCode != Ok;
+    }
+
+    Code code() const
+    {
+        return errorCode;
+    }
+
+    const char *c_str() const;
+
+private:
+    Code errorCode;
+};
+
+class JsonDocument
+{
+public:
+    JsonDocument() : root(std::make_shared<JsonNode>()) {}
+
+    JsonVariant operator[](const char *key)
+    {
+        return rootVariant()[key];
+    }
+
+    JsonVariant operator[](const char *key) const
+    {
+        return JsonVariant((root->type == JsonNode::Object) ? root : nullptr, key);
+    }
+
+    bool containsKey(const char *key) const
+    {
+        return root->member(key) != nullptr;
+    }
+
+    JsonObject createNestedObject(const char *key)
+    {
+        return rootVariant().createNestedObject(key);
+    }
+
+    template <typename T>
+    T to();
+
+    void clear()
+    {
+        *root = JsonNode();
+    }
+
+    JsonNodePtr root;
+
+private:
+    JsonVariant rootVariant()
+    {
+        return JsonVariant(root);
+    }
+};
+
+template <>
+inline JsonArray JsonDocument::to<JsonArray>()
+{
+    *root = JsonNode();
+    root->type = JsonNode::Array;
+
+    return JsonArray(root);
+}
+
+template <size_t CAPACITY>
+class StaticJsonDocument : public JsonDocument
+{
+};
+
+class DynamicJsonDocument : public JsonDocument
+{
+public:
+    explicit DynamicJsonDocument(size_t) {}
+};
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input, size_t size);
+
+inline DeserializationError deserializeJson(JsonDocument &doc, const char *input)
+{
+    return deserializeJson(doc, input, strlen(input));
+}
+
+inline DeserializationError deserializeJson(JsonDocument &doc, const String &input)
+{
+    return deserializeJson(doc, input.c_str(), input.length());
+}
+
+// Writes at most `size - 1` characters and a terminator, and returns how many characters were written.
+size_t serializeJson(const JsonDocument &doc, char *output, size_t size);
+size_t serializeJson(const JsonDocument &doc, String &output);
+size_t serializeJsonPretty(const JsonDocument &doc, String &output);
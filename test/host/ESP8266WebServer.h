@@ -0,0 +1,127 @@
+#pragma once
+
+// The web server of the ESP8266 core, for the host tests: the requests come
+// from `host::httpRequest()` instead of a socket, and the response goes back
+// to its handler. Multipart uploads are not replayed.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <uri/UriBraces.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS,
+};
+
+enum HTTPUploadStatus
+{
+    UPLOAD_FILE_START,
+    UPLOAD_FILE_WRITE,
+    UPLOAD_FILE_END,
+    UPLOAD_FILE_ABORTED,
+};
+
+#define HTTP_UPLOAD_BUFLEN 2048
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+struct HTTPUpload
+{
+    HTTPUploadStatus status = UPLOAD_FILE_START;
+    String filename;
+    String name;
+    String type;
+    size_t totalSize = 0;
+    size_t currentSize = 0;
+    uint8_t buf[HTTP_UPLOAD_BUFLEN] = {};
+};
+
+class ESP8266WebServer
+{
+public:
+    enum ClientFuture
+    {
+        CLIENT_REQUEST_CAN_CONTINUE,
+        CLIENT_REQUEST_IS_HANDLED,
+        CLIENT_MUST_STOP,
+        CLIENT_IS_GIVEN,
+    };
+
+    typedef std::function<void()> THandlerFunction;
+    typedef std::function<String(const String &)> ContentTypeFunction;
+    typedef std::function<ClientFuture(const String &method, const String &url, WiFiClient *client, ContentTypeFunction contentType)> HookFunction;
+
+    explicit ESP8266WebServer(uint16_t = 80) {}
+
+    void begin(uint16_t = 80) {}
+    void collectHeaders(const char *[], size_t) {}
+
+    void on(const Uri &uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler = nullptr);
+    void onNotFound(THandlerFunction handler);
+    void addHook(HookFunction hook);
+
+    // Handles every request queued with `host::httpRequest()`.
+    void handleClient();
+
+    bool hasArg(const String &name) const;
+    String arg(const String &name) const;
+    String pathArg(unsigned int i) const;
+    String header(const String &name) const;
+
+    bool authenticate(const char *username, const char *password);
+    void requestAuthentication();
+
+    HTTPUpload &upload()
+    {
+        return currentUpload;
+    }
+
+    WiFiClient client();
+
+    void setContentLength(size_t length)
+    {
+        contentLength = length;
+    }
+
+    void sendHeader(const String &name, const String &value, bool first = false);
+    void send(int code, const char *contentType, const String &content);
+    void send(int code, const char *contentType, const char *content);
+    void sendContent(const String &content);
+    void sendContent(const char *content, size_t size);
+
+private:
+    struct Route
+    {
+        std::string uri;
+        bool braces;
+        HTTPMethod method;
+        THandlerFunction handler;
+    };
+
+    bool match(const Route &route, const std::string &path);
+
+    std::vector<Route> routes;
+    THandlerFunction notFoundHandler;
+    std::vector<HookFunction> hooks;
+
+    std::vector<std::pair<std::string, std::string>> args;
+    std::vector<std::string> pathArgs;
+    std::vector<std::pair<std::string, std::string>> headers;
+    HTTPUpload currentUpload;
+    size_t contentLength = CONTENT_LENGTH_UNKNOWN;
+
+    struct Response;
+    std::shared_ptr<Response> response;
+};
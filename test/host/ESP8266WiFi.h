@@ -0,0 +1,229 @@
+#pragma once
+
+// The WiFi of the ESP8266 core, for the host tests: the station is always connected.
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+enum WiFiMode_t
+{
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3,
+};
+
+enum WiFiSleepType_t
+{
+    WIFI_NONE_SLEEP = 0,
+    WIFI_LIGHT_SLEEP = 1,
+    WIFI_MODEM_SLEEP = 2,
+};
+
+struct WiFiEventStationModeGotIP
+{
+    IPAddress ip;
+    IPAddress mask;
+    IPAddress gw;
+};
+
+typedef std::shared_ptr<void> WiFiEventHandler;
+
+class WiFiClass
+{
+public:
+    wl_status_t begin(const char *, const char * = nullptr, int32_t = 0, const uint8_t * = nullptr, bool = true)
+    {
+        mode(WIFI_STA);
+        return WL_CONNECTED;
+    }
+
+    bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress())
+    {
+        return true;
+    }
+
+    bool disconnect(bool = false)
+    {
+        return true;
+    }
+
+    wl_status_t status()
+    {
+        return WL_CONNECTED;
+    }
+
+    bool mode(WiFiMode_t m)
+    {
+        currentMode = m;
+        return true;
+    }
+
+    WiFiMode_t getMode()
+    {
+        return currentMode;
+    }
+
+    bool persistent(bool)
+    {
+        return true;
+    }
+
+    bool setAutoReconnect(bool)
+    {
+        return true;
+    }
+
+    bool setSleepMode(WiFiSleepType_t, uint8_t = 0)
+    {
+        return true;
+    }
+
+    // The address never changes on the host.
+    WiFiEventHandler onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP &)>)
+    {
+        return nullptr;
+    }
+
+    bool hostname(const char *)
+    {
+        return true;
+    }
+
+    bool softAPConfig(IPAddress, IPAddress, IPAddress)
+    {
+        return true;
+    }
+
+    bool softAP(const char *, const char * = nullptr)
+    {
+        mode(WIFI_AP);
+        return true;
+    }
+
+    bool softAPdisconnect(bool = false)
+    {
+        return true;
+    }
+
+    IPAddress softAPIP()
+    {
+        return localAddress;
+    }
+
+    IPAddress localIP()
+    {
+        return localAddress;
+    }
+
+    IPAddress gatewayIP()
+    {
+        return IPAddress(localAddress[0], localAddress[1], localAddress[2], 1);
+    }
+
+    IPAddress subnetMask()
+    {
+        return IPAddress(255, 255, 255, 0);
+    }
+
+    IPAddress dnsIP(uint8_t = 0)
+    {
+        return gatewayIP();
+    }
+
+    uint8_t *BSSID()
+    {
+        return bssid;
+    }
+
+    String BSSIDstr()
+    {
+        return "4F:4C:00:00:00:01";
+    }
+
+    int32_t channel()
+    {
+        return 1;
+    }
+
+    int32_t RSSI()
+    {
+        return -50;
+    }
+
+    // Nothing resolves: there is no network to reach.
+    int hostByName(const char *, IPAddress &, uint32_t = 10000)
+    {
+        return 0;
+    }
+
+    // The address the host tests run the controller at.
+    IPAddress localAddress = IPAddress(127, 0, 0, 1);
+
+private:
+    WiFiMode_t currentMode = WIFI_OFF;
+    uint8_t bssid[6] = {0x4f, 0x4c, 0, 0, 0, 1};
+};
+
+extern WiFiClass WiFi;
+
+// A connection. Whatever is written to it goes to `sink`, if set.
+class WiFiClient : public Print
+{
+public:
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        if (sink)
+        {
+            sink->append(reinterpret_cast<const char *>(buffer), size);
+        }
+
+        return size;
+    }
+
+    using Print::write;
+
+    int connect(const char *, uint16_t)
+    {
+        return 0;
+    }
+
+    bool connected()
+    {
+        return false;
+    }
+
+    int available()
+    {
+        return 0;
+    }
+
+    int read()
+    {
+        return -1;
+    }
+
+    void stop() {}
+    void setTimeout(unsigned long) {}
+    void setNoDelay(bool) {}
+
+    std::string *sink = nullptr;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <ESP8266WiFi.h>
+
+class ESP8266WiFiMulti
+{
+public:
+    bool addAP(const char *, const char * = nullptr)
+    {
+        return true;
+    }
+
+    wl_status_t run(uint32_t = 0)
+    {
+        return WiFi.begin(nullptr);
+    }
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+// mDNS, for the host tests: nothing is announced.
+
+#include <ESP8266WiFi.h>
+
+class MDNSResponder
+{
+public:
+    typedef const void *hMDNSService;
+    typedef const void *hMDNSTxt;
+    typedef void (*MDNSDynamicServiceTxtCallbackFunc)(const hMDNSService service);
+
+    bool begin(const char *, const IPAddress & = IPAddress(), uint32_t = 120)
+    {
+        return true;
+    }
+
+    bool update()
+    {
+        return true;
+    }
+
+    bool announce()
+    {
+        return true;
+    }
+
+    bool notifyAPChange()
+    {
+        return true;
+    }
+
+    hMDNSService addService(const char *, const char *, uint16_t)
+    {
+        return this;
+    }
+
+    hMDNSTxt addServiceTxt(hMDNSService, const char *, const char *)
+    {
+        return this;
+    }
+
+    bool setDynamicServiceTxtCallback(hMDNSService, MDNSDynamicServiceTxtCallbackFunc)
+    {
+        return true;
+    }
+
+    template <typename T>
+    hMDNSTxt addDynamicServiceTxt(hMDNSService, const char *, T)
+    {
+        return this;
+    }
+};
+
+extern MDNSResponder MDNS;
@@ -0,0 +1,90 @@
+#pragma once
+
+// ESPAsyncTCP's client, for the host tests. Unless `host::setNetworking()`
+// turned the sockets on, connections fail at once.
+//
+// With the sockets on, it is a non-blocking socket from `WiFi.localAddress`.
+// The callbacks run when `host::advanceTo()` moves the clock, as the SDK runs
+// them whenever the sketch yields: never in the middle of `loop()` code that
+// doesn't wait.
+
+#include <ESP8266WiFi.h>
+
+#include <functional>
+#include <vector>
+
+class AsyncClient;
+
+typedef std::function<void(void *, AsyncClient *)> AcConnectHandler;
+typedef std::function<void(void *, AsyncClient *, void *data, size_t len)> AcDataHandler;
+typedef std::function<void(void *, AsyncClient *, int8_t error)> AcErrorHandler;
+
+class AsyncClient
+{
+public:
+    AsyncClient();
+    ~AsyncClient();
+
+    bool connect(const char *host, uint16_t port);
+    bool connect(IPAddress ip, uint16_t port);
+    void close(bool now = false);
+
+    bool connecting() const
+    {
+        return (fd >= 0) && !isConnected;
+    }
+
+    bool connected() const
+    {
+        return (fd >= 0) && isConnected;
+    }
+
+    size_t space() const;
+    size_t add(const char *data, size_t size, uint8_t apiflags = 0);
+    bool send();
+
+    void setNoDelay(bool) {}
+
+    void onConnect(AcConnectHandler handler, void *arg = nullptr)
+    {
+        connectHandler = handler;
+        connectArg = arg;
+    }
+
+    void onDisconnect(AcConnectHandler handler, void *arg = nullptr)
+    {
+        disconnectHandler = handler;
+        disconnectArg = arg;
+    }
+
+    void onData(AcDataHandler handler, void *arg = nullptr)
+    {
+        dataHandler = handler;
+        dataArg = arg;
+    }
+
+    void onError(AcErrorHandler handler, void *arg = nullptr)
+    {
+        errorHandler = handler;
+        errorArg = arg;
+    }
+
+    // Run the callbacks for what happened on the socket.
+    void poll();
+
+private:
+    void fail(int8_t error);
+
+    int fd = -1;
+    bool isConnected = false;
+    std::vector<uint8_t> out;
+
+    AcConnectHandler connectHandler;
+    void *connectArg = nullptr;
+    AcConnectHandler disconnectHandler;
+    void *disconnectArg = nullptr;
+    AcDataHandler dataHandler;
+    void *dataArg = nullptr;
+    AcErrorHandler errorHandler;
+    void *errorArg = nullptr;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+// The emulated EEPROM, for the host tests: it starts erased, and lasts as long as the process.
+
+#include <Arduino.h>
+
+#include <vector>
+
+class EEPROMClass
+{
+public:
+    void begin(size_t size)
+    {
+        if (data.size() < size)
+        {
+            data.resize(size, 0xff);
+        }
+    }
+
+    template <typename T>
+    T &get(int address, T &value)
+    {
+        begin(address + sizeof(T));
+        memcpy(static_cast<void *>(&value), &data[address], sizeof(T));
+
+        return value;
+    }
+
+    template <typename T>
+    const T &put(int address, const T &value)
+    {
+        begin(address + sizeof(T));
+        memcpy(&data[address], static_cast<const void *>(&value), sizeof(T));
+
+        return value;
+    }
+
+    uint8_t read(int address)
+    {
+        begin(address + 1);
+        return data[address];
+    }
+
+    void write(int address, uint8_t value)
+    {
+        begin(address + 1);
+        data[address] = value;
+    }
+
+    bool commit()
+    {
+        return true;
+    }
+
+    void end() {}
+
+private:
+    std::vector<uint8_t> data;
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,299 @@
+#pragma once
+
+// FastLED, for the host tests.
+//
+// The color math the effects use follows FastLED's portable C code
+// (hsv2rgb_rainbow, sin8_C, scale8 with FASTLED_SCALE8_FIXED, the 16-bit
+// random generator, linear palette blending), so that a trace only depends on
+// the firmware. The controllers don't drive anything: `FastLED.show()` hands
+// their pixels to `host::setShowHandler()`. The power limit and the color
+// correction are not applied, as they happen in FastLED's output stage.
+
+#include <Arduino.h>
+
+#include <vector>
+
+typedef uint8_t fract8;
+
+inline uint8_t scale8(uint8_t i, fract8 scale)
+{
+    return (static_cast<uint16_t>(i) * (1 + static_cast<uint16_t>(scale))) >> 8;
+}
+
+inline uint8_t scale8_video(uint8_t i, fract8 scale)
+{
+    return ((static_cast<int>(i) * scale) >> 8) + ((i && scale) ? 1 : 0);
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j)
+{
+    const unsigned t = i + j;
+    return (t > 255) ? 255 : t;
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j)
+{
+    return (j > i) ? 0 : i - j;
+}
+
+uint8_t sin8(uint8_t theta);
+
+uint16_t random16();
+uint8_t random8();
+uint8_t random8(uint8_t lim);
+uint8_t random8(uint8_t min, uint8_t lim);
+void random16_set_seed(uint16_t seed);
+
+struct CHSV
+{
+    union
+    {
+        struct
+        {
+            union
+            {
+                uint8_t hue;
+                uint8_t h;
+            };
+            union
+            {
+                uint8_t saturation;
+                uint8_t sat;
+                uint8_t s;
+            };
+            union
+            {
+                uint8_t value;
+                uint8_t val;
+                uint8_t v;
+            };
+        };
+        uint8_t raw[3];
+    };
+
+    CHSV() = default;
+    CHSV(uint8_t h, uint8_t s, uint8_t v) : hue(h), sat(s), val(v) {}
+};
+
+struct CRGB;
+
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb);
+
+struct CRGB
+{
+    union
+    {
+        struct
+        {
+            union
+            {
+                uint8_t r;
+                uint8_t red;
+            };
+            union
+            {
+                uint8_t g;
+                uint8_t green;
+            };
+            union
+            {
+                uint8_t b;
+                uint8_t blue;
+            };
+        };
+        uint8_t raw[3];
+    };
+
+    enum HTMLColorCode
+    {
+        Black = 0x000000,
+        Blue = 0x0000FF,
+        Green = 0x008000,
+        Red = 0xFF0000,
+        White = 0xFFFFFF,
+    };
+
+    CRGB() = default;
+    CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+    CRGB(uint32_t colorcode) : r(colorcode >> 16), g(colorcode >> 8), b(colorcode) {}
+    CRGB(HTMLColorCode colorcode) : CRGB(static_cast<uint32_t>(colorcode)) {}
+
+    CRGB(const CHSV &hsv)
+    {
+        hsv2rgb_rainbow(hsv, *this);
+    }
+
+    CRGB &operator=(const CHSV &hsv)
+    {
+        hsv2rgb_rainbow(hsv, *this);
+        return *this;
+    }
+
+    uint8_t &operator[](uint8_t x)
+    {
+        return raw[x];
+    }
+
+    const uint8_t &operator[](uint8_t x) const
+    {
+        return raw[x];
+    }
+
+    CRGB &operator+=(const CRGB &rhs)
+    {
+        r = qadd8(r, rhs.r);
+        g = qadd8(g, rhs.g);
+        b = qadd8(b, rhs.b);
+        return *this;
+    }
+
+    CRGB &nscale8(uint8_t scaledown)
+    {
+        r = scale8(r, scaledown);
+        g = scale8(g, scaledown);
+        b = scale8(b, scaledown);
+        return *this;
+    }
+
+    bool operator==(const CRGB &rhs) const
+    {
+        return (r == rhs.r) && (g == rhs.g) && (b == rhs.b);
+    }
+
+    bool operator!=(const CRGB &rhs) const
+    {
+        return !(*this == rhs);
+    }
+};
+
+void fill_solid(CRGB *leds, int numToFill, const CRGB &color);
+
+struct CRGBPalette16
+{
+    CRGB entries[16];
+};
+
+typedef CRGBPalette16 TProgmemRGBPalette16;
+
+extern const TProgmemRGBPalette16 HeatColors_p;
+
+enum TBlendType
+{
+    NOBLEND = 0,
+    LINEARBLEND = 1,
+};
+
+CRGB ColorFromPalette(const CRGBPalette16 &pal, uint8_t index, uint8_t brightness = 255, TBlendType blendType = LINEARBLEND);
+
+enum EOrder
+{
+    RGB = 0012,
+    RBG = 0021,
+    GRB = 0102,
+    GBR = 0120,
+    BRG = 0201,
+    BGR = 0210,
+};
+
+enum LEDColorCorrection
+{
+    TypicalLEDStrip = 0xFFB0F0,
+    UncorrectedColor = 0xFFFFFF,
+};
+
+enum ESPIChipsets
+{
+    LPD8806,
+    WS2801,
+    APA102,
+    SK9822,
+};
+
+#define DATA_RATE_MHZ(X) ((X) * 1000000)
+
+#define DISABLE_DITHER 0x00
+#define BINARY_DITHER 0x01
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER = GRB>
+class WS2812
+{
+};
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER = GRB>
+class WS2811
+{
+};
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER = GRB>
+class SK6812
+{
+};
+
+class CLEDController
+{
+public:
+    CLEDController &setLeds(CRGB *data, int count)
+    {
+        leds = data;
+        size = count;
+        return *this;
+    }
+
+    CLEDController &setCorrection(LEDColorCorrection)
+    {
+        return *this;
+    }
+
+    CLEDController &setDither(uint8_t = BINARY_DITHER)
+    {
+        return *this;
+    }
+
+    CRGB *leds = nullptr;
+    int size = 0;
+};
+
+class CFastLED
+{
+public:
+    template <template <uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    CLEDController &addLeds(CRGB *data, int count)
+    {
+        return add(data, count);
+    }
+
+    template <ESPIChipsets CHIPSET, uint8_t DATA_PIN, uint8_t CLOCK_PIN, EOrder RGB_ORDER, uint32_t SPI_DATA_RATE>
+    CLEDController &addLeds(CRGB *data, int count)
+    {
+        return add(data, count);
+    }
+
+    CLEDController &operator[](int x)
+    {
+        return *controllers[x];
+    }
+
+    void show();
+
+    void setBrightness(uint8_t scale)
+    {
+        brightness = scale;
+    }
+
+    uint8_t getBrightness()
+    {
+        return brightness;
+    }
+
+    void setDither(uint8_t) {}
+    void setMaxPowerInVoltsAndMilliamps(uint8_t, uint32_t) {}
+    void setMaxPowerInMilliWatts(uint32_t) {}
+
+private:
+    CLEDController &add(CRGB *data, int count);
+
+    std::vector<CLEDController *> controllers;
+    uint8_t brightness = 255;
+};
+
+extern CFastLED FastLED;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Stored in network byte order, like the ESP8266 core: the first byte is the lowest.
+class IPAddress
+{
+public:
+    IPAddress() = default;
+
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : address(a | (b << 8) | (c << 16) | (static_cast<uint32_t>(d) << 24))
+    {
+    }
+
+    IPAddress(uint32_t address) : address(address) {}
+
+    operator uint32_t() const
+    {
+        return address;
+    }
+
+    uint8_t operator[](int index) const
+    {
+        return address >> (8 * index);
+    }
+
+    bool operator==(const IPAddress &other) const
+    {
+        return address == other.address;
+    }
+
+    bool operator!=(const IPAddress &other) const
+    {
+        return address != other.address;
+    }
+
+    bool isSet() const
+    {
+        return address != 0;
+    }
+
+    String toString() const
+    {
+        char tmp[16];
+        snprintf(tmp, sizeof(tmp), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+
+        return tmp;
+    }
+
+    bool fromString(const char *s)
+    {
+        unsigned a, b, c, d;
+        char end;
+
+        if ((sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4) || (a > 255) || (b > 255) || (c > 255) || (d > 255))
+        {
+            return false;
+        }
+
+        *this = IPAddress(a, b, c, d);
+        return true;
+    }
+
+private:
+    uint32_t address = 0;
+};
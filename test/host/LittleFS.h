@@ -0,0 +1,110 @@
+#pragma once
+
+// The file system, for the host tests: files live in memory, as long as the process.
+
+#include <Arduino.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class File : public Print
+{
+public:
+    File() = default;
+    explicit File(std::shared_ptr<std::vector<uint8_t>> data) : data(data) {}
+
+    explicit operator bool() const
+    {
+        return data != nullptr;
+    }
+
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        if (!data)
+        {
+            return 0;
+        }
+
+        data->insert(data->end(), buffer, buffer + size);
+        return size;
+    }
+
+    using Print::write;
+
+    size_t read(uint8_t *buffer, size_t size)
+    {
+        if (!data)
+        {
+            return 0;
+        }
+
+        const size_t len = min(size, data->size() - position);
+        memcpy(buffer, data->data() + position, len);
+        position += len;
+
+        return len;
+    }
+
+    int available()
+    {
+        return data ? static_cast<int>(data->size() - position) : 0;
+    }
+
+    size_t size() const
+    {
+        return data ? data->size() : 0;
+    }
+
+    void close()
+    {
+        data.reset();
+    }
+
+private:
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t position = 0;
+};
+
+class FS
+{
+public:
+    bool begin()
+    {
+        return true;
+    }
+
+    File open(const char *path, const char *mode)
+    {
+        auto it = files.find(path);
+
+        if (mode[0] == 'w')
+        {
+            files[path] = std::make_shared<std::vector<uint8_t>>();
+            return File(files[path]);
+        }
+
+        return (it != files.end()) ? File(it->second) : File();
+    }
+
+    bool exists(const char *path)
+    {
+        return files.count(path) > 0;
+    }
+
+    bool remove(const char *path)
+    {
+        return files.erase(path) > 0;
+    }
+
+private:
+    std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files;
+};
+
+extern FS LittleFS;
@@ -0,0 +1,43 @@
+#pragma once
+
+// The flash updater, for the host tests: there is no flash to write to.
+
+#include <Arduino.h>
+
+#define U_FLASH 0
+
+class UpdaterClass
+{
+public:
+    bool begin(size_t, int = U_FLASH)
+    {
+        return false;
+    }
+
+    bool setMD5(const char *)
+    {
+        return true;
+    }
+
+    size_t write(uint8_t *, size_t)
+    {
+        return 0;
+    }
+
+    bool end(bool = false)
+    {
+        return false;
+    }
+
+    bool isRunning()
+    {
+        return false;
+    }
+
+    String getErrorString()
+    {
+        return "No flash on the host";
+    }
+};
+
+extern UpdaterClass Update;
@@ -0,0 +1,68 @@
+#pragma once
+
+// UDP, for the host tests. Unless `host::setNetworking()` turned the sockets
+// on, nothing is ever received, and what is sent goes nowhere.
+//
+// With the sockets on, each controller is its own `WiFi.localAddress` on the
+// loopback interface. `beginMulticast()` opens two sockets, as several
+// controllers share the port: one bound to the group address, which every
+// member receives the group's datagrams on, and one bound to the controller's
+// own address, which it sends from and receives the unicast replies on.
+
+#include <ESP8266WiFi.h>
+
+#include <vector>
+
+class WiFiUDP : public Print
+{
+public:
+    ~WiFiUDP() override;
+
+    uint8_t begin(uint16_t port);
+    uint8_t beginMulticast(IPAddress interfaceAddress, IPAddress multicast, uint16_t port);
+    void stop();
+
+    int parsePacket();
+    int read(uint8_t *buffer, size_t size);
+
+    IPAddress remoteIP()
+    {
+        return remoteAddress;
+    }
+
+    uint16_t remotePort()
+    {
+        return remotePortNumber;
+    }
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacketMulticast(IPAddress multicast, uint16_t port, IPAddress interfaceAddress, int ttl = 1);
+
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        out.insert(out.end(), buffer, buffer + size);
+        return size;
+    }
+
+    using Print::write;
+
+    int endPacket();
+
+private:
+    int unicastSocket = -1;
+    int multicastSocket = -1;
+
+    std::vector<uint8_t> in;
+    size_t inPosition = 0;
+    IPAddress remoteAddress;
+    uint16_t remotePortNumber = 0;
+
+    std::vector<uint8_t> out;
+    IPAddress destination;
+    uint16_t destinationPort = 0;
+};
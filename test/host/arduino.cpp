@@ -0,0 +1,246 @@
+#include "Arduino.h"
+
+#include "host.h"
+
+#include <user_interface.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static uint64_t clockMicros = 0;
+
+static const uint8_t PIN_COUNT = 17;
+static int pinLevels[PIN_COUNT] = {HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH};
+static void (*pinInterrupts[PIN_COUNT])() = {};
+static int pinInterruptModes[PIN_COUNT] = {};
+
+static timercallback timerCallback = nullptr;
+static bool timerEnabled = false;
+static bool timerLoop = false;
+static uint32_t timerTicks = 0;
+static uint64_t timerDue = UINT64_MAX;
+
+static FILE *serialOutput = nullptr;
+static bool restartFlag = false;
+static uint32_t randomState = 1;
+
+static uint8_t cpuFrequency = 80;
+
+namespace host
+{
+    uint64_t now()
+    {
+        return clockMicros;
+    }
+
+    uint64_t nextTimerInterrupt()
+    {
+        return timerEnabled ? timerDue : UINT64_MAX;
+    }
+
+    void advanceTo(uint64_t time)
+    {
+        while (timerEnabled && (timerDue <= time))
+        {
+            clockMicros = max(clockMicros, timerDue);
+
+            // timer1 counts at 80 MHz / 256: 16 ticks every 5 microseconds.
+            timerDue = timerLoop ? timerDue + max<uint64_t>((timerTicks * 5ull) / 16, 1) : UINT64_MAX;
+
+            if (timerCallback)
+            {
+                timerCallback();
+            }
+        }
+
+        clockMicros = max(clockMicros, time);
+        pollNetwork();
+    }
+
+    void setPin(uint8_t pin, int level)
+    {
+        if ((pin >= PIN_COUNT) || (pinLevels[pin] == level))
+        {
+            return;
+        }
+
+        pinLevels[pin] = level;
+
+        const int mode = pinInterruptModes[pin];
+
+        if (pinInterrupts[pin] && ((mode == CHANGE) || ((mode == RISING) && (level == HIGH)) || ((mode == FALLING) && (level == LOW))))
+        {
+            pinInterrupts[pin]();
+        }
+    }
+
+    void seed(uint32_t seed)
+    {
+        randomState = seed ? seed : 1;
+    }
+
+    void setSerialOutput(FILE *out)
+    {
+        serialOutput = out;
+    }
+
+    bool restartRequested()
+    {
+        return restartFlag;
+    }
+}
+
+unsigned long millis()
+{
+    return static_cast<uint32_t>(clockMicros / 1000);
+}
+
+unsigned long micros()
+{
+    return static_cast<uint32_t>(clockMicros);
+}
+
+void delay(unsigned long ms)
+{
+    host::advanceTo(clockMicros + ms * 1000ull);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    host::advanceTo(clockMicros + us);
+}
+
+void yield() {}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < PIN_COUNT)
+    {
+        pinLevels[pin] = value ? HIGH : LOW;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return (pin < PIN_COUNT) ? pinLevels[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode)
+{
+    if (pin < PIN_COUNT)
+    {
+        pinInterrupts[pin] = isr;
+        pinInterruptModes[pin] = mode;
+    }
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    if (pin < PIN_COUNT)
+    {
+        pinInterrupts[pin] = nullptr;
+    }
+}
+
+void timer1_isr_init() {}
+
+void timer1_enable(uint8_t, uint8_t, uint8_t reload)
+{
+    timerEnabled = true;
+    timerLoop = (reload == TIM_LOOP);
+}
+
+void timer1_disable()
+{
+    timerEnabled = false;
+}
+
+void timer1_attachInterrupt(timercallback callback)
+{
+    timerCallback = callback;
+}
+
+void timer1_detachInterrupt()
+{
+    timerCallback = nullptr;
+}
+
+void timer1_write(uint32_t ticks)
+{
+    timerTicks = ticks;
+    timerDue = clockMicros + max<uint64_t>((ticks * 5ull) / 16, 1);
+}
+
+// xorshift32: the firmware only needs it to be repeatable.
+static uint32_t nextRandom()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+long random(long max)
+{
+    return (max > 0) ? static_cast<long>(nextRandom() % max) : 0;
+}
+
+long random(long min, long max)
+{
+    return (max > min) ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+    host::seed(seed);
+}
+
+void EspClass::restart()
+{
+    restartFlag = true;
+}
+
+uint32_t EspClass::random()
+{
+    return nextRandom();
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    return (len > 0) ? write(buffer, min<size_t>(len, sizeof(buffer) - 1)) : 0;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    if (serialOutput)
+    {
+        fwrite(buffer, 1, size, serialOutput);
+    }
+
+    return size;
+}
+
+bool system_update_cpu_freq(uint8_t freq)
+{
+    cpuFrequency = freq;
+    return true;
+}
+
+uint8_t system_get_cpu_freq()
+{
+    return cpuFrequency;
+}
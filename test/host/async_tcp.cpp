@@ -0,0 +1,236 @@
+#include "ESPAsyncTCP.h"
+
+#include "host.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// What lwIP would buffer for a connection.
+static const size_t SEND_BUFFER_SIZE = 2920;
+
+// Constructed on first use, as the clients are globals themselves.
+static std::vector<AsyncClient *> &clients()
+{
+    static std::vector<AsyncClient *> all;
+    return all;
+}
+
+namespace host
+{
+    void pollNetwork()
+    {
+        for (size_t i = 0; i < clients().size(); i++)
+        {
+            clients()[i]->poll();
+        }
+    }
+}
+
+AsyncClient::AsyncClient()
+{
+    clients().push_back(this);
+}
+
+AsyncClient::~AsyncClient()
+{
+    clients().erase(std::find(clients().begin(), clients().end(), this));
+
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+bool AsyncClient::connect(const char *host, uint16_t port)
+{
+    if (!host::networking())
+    {
+        return false;
+    }
+
+    // The host resolves names at once, which the SDK would do in the background.
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+
+    if ((getaddrinfo(host, nullptr, &hints, &result) != 0) || (result == nullptr))
+    {
+        return false;
+    }
+
+    const IPAddress ip(reinterpret_cast<sockaddr_in *>(result->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(result);
+
+    return connect(ip, port);
+}
+
+bool AsyncClient::connect(IPAddress ip, uint16_t port)
+{
+    if (!host::networking() || (fd >= 0))
+    {
+        return false;
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = static_cast<uint32_t>(WiFi.localAddress);
+    bind(fd, reinterpret_cast<const sockaddr *>(&local), sizeof(local));
+
+    sockaddr_in remote = {};
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(port);
+    remote.sin_addr.s_addr = static_cast<uint32_t>(ip);
+
+    if ((::connect(fd, reinterpret_cast<const sockaddr *>(&remote), sizeof(remote)) < 0) && (errno != EINPROGRESS))
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    isConnected = false;
+    out.clear();
+
+    return true;
+}
+
+void AsyncClient::close(bool)
+{
+    if (fd < 0)
+    {
+        return;
+    }
+
+    ::close(fd);
+    fd = -1;
+    isConnected = false;
+    out.clear();
+
+    if (disconnectHandler)
+    {
+        disconnectHandler(disconnectArg, this);
+    }
+}
+
+size_t AsyncClient::space() const
+{
+    return connected() ? SEND_BUFFER_SIZE - std::min(out.size(), SEND_BUFFER_SIZE) : 0;
+}
+
+size_t AsyncClient::add(const char *data, size_t size, uint8_t)
+{
+    size = std::min(size, space());
+    out.insert(out.end(), data, data + size);
+
+    return size;
+}
+
+bool AsyncClient::send()
+{
+    if (!connected())
+    {
+        return false;
+    }
+
+    while (!out.empty())
+    {
+        const ssize_t sent = ::send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+
+        if (sent <= 0)
+        {
+            // What didn't fit goes out on a later poll.
+            return (sent < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK));
+        }
+
+        out.erase(out.begin(), out.begin() + sent);
+    }
+
+    return true;
+}
+
+void AsyncClient::fail(int8_t error)
+{
+    if (errorHandler)
+    {
+        errorHandler(errorArg, this, error);
+    }
+
+    close(true);
+}
+
+void AsyncClient::poll()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+
+    if (isConnected)
+    {
+        send();
+    }
+
+    pollfd events = {fd, static_cast<short>(isConnected ? POLLIN : POLLOUT), 0};
+
+    if (::poll(&events, 1, 0) <= 0)
+    {
+        return;
+    }
+
+    if (!isConnected)
+    {
+        int error = 0;
+        socklen_t size = sizeof(error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size);
+
+        if (error != 0)
+        {
+            // lwIP's ERR_CONN.
+            fail(-11);
+            return;
+        }
+
+        isConnected = true;
+
+        if (connectHandler)
+        {
+            connectHandler(connectArg, this);
+        }
+
+        return;
+    }
+
+    uint8_t buffer[1460];
+    const ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+
+    if (len > 0)
+    {
+        if (dataHandler)
+        {
+            dataHandler(dataArg, this, buffer, len);
+        }
+    }
+    else if ((len == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+    {
+        close(true);
+    }
+}
@@ -0,0 +1,240 @@
+#include "FastLED.h"
+
+#include "host.h"
+
+CFastLED FastLED;
+
+static host::ShowHandler showHandler;
+
+namespace host
+{
+    void setShowHandler(ShowHandler handler)
+    {
+        showHandler = handler;
+    }
+}
+
+CLEDController &CFastLED::add(CRGB *data, int count)
+{
+    CLEDController *controller = new CLEDController();
+    controller->setLeds(data, count);
+    controllers.push_back(controller);
+
+    return *controller;
+}
+
+void CFastLED::show()
+{
+    for (const CLEDController *controller : controllers)
+    {
+        if (showHandler)
+        {
+            showHandler(reinterpret_cast<const uint8_t *>(controller->leds), controller->size * sizeof(CRGB));
+        }
+    }
+}
+
+static uint16_t rand16seed = 1337;
+
+uint16_t random16()
+{
+    rand16seed = (rand16seed * 2053) + 13849;
+    return rand16seed;
+}
+
+uint8_t random8()
+{
+    rand16seed = (rand16seed * 2053) + 13849;
+    return static_cast<uint8_t>((rand16seed & 0xff) + (rand16seed >> 8));
+}
+
+uint8_t random8(uint8_t lim)
+{
+    return (random8() * lim) >> 8;
+}
+
+uint8_t random8(uint8_t min, uint8_t lim)
+{
+    return random8(lim - min) + min;
+}
+
+void random16_set_seed(uint16_t seed)
+{
+    rand16seed = seed;
+}
+
+uint8_t sin8(uint8_t theta)
+{
+    static const uint8_t b_m16_interleave[] = {0, 49, 49, 41, 90, 27, 117, 10};
+
+    uint8_t offset = theta;
+
+    if (theta & 0x40)
+    {
+        offset = 255 - offset;
+    }
+
+    offset &= 0x3f;
+
+    uint8_t secoffset = offset & 0x0f;
+
+    if (theta & 0x40)
+    {
+        secoffset++;
+    }
+
+    const uint8_t section = offset >> 4;
+    const uint8_t b = b_m16_interleave[section * 2];
+    const uint8_t m16 = b_m16_interleave[section * 2 + 1];
+    const uint8_t mx = (m16 * secoffset) >> 4;
+    int8_t y = mx + b;
+
+    if (theta & 0x80)
+    {
+        y = -y;
+    }
+
+    return y + 128;
+}
+
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb)
+{
+    const uint8_t hue = hsv.hue;
+    const uint8_t sat = hsv.sat;
+    uint8_t val = hsv.val;
+
+    const uint8_t offset8 = (hue & 0x1f) << 3;
+    const uint8_t third = scale8(offset8, 256 / 3);
+    const uint8_t twothirds = scale8(offset8, (256 * 2) / 3);
+    uint8_t r, g, b;
+
+    // The default "Y1" yellow boost, without scaling green down.
+    switch (hue >> 5)
+    {
+    case 0: // Red to orange.
+        r = 255 - third;
+        g = third;
+        b = 0;
+        break;
+    case 1: // Orange to yellow.
+        r = 171;
+        g = 85 + third;
+        b = 0;
+        break;
+    case 2: // Yellow to green.
+        r = 171 - twothirds;
+        g = 170 + third;
+        b = 0;
+        break;
+    case 3: // Green to aqua.
+        r = 0;
+        g = 255 - third;
+        b = third;
+        break;
+    case 4: // Aqua to blue.
+        r = 0;
+        g = 171 - twothirds;
+        b = 85 + twothirds;
+        break;
+    case 5: // Blue to purple.
+        r = third;
+        g = 0;
+        b = 255 - third;
+        break;
+    case 6: // Purple to pink.
+        r = 85 + third;
+        g = 0;
+        b = 171 - third;
+        break;
+    default: // Pink to red.
+        r = 170 + third;
+        g = 0;
+        b = 85 - third;
+        break;
+    }
+
+    if (sat != 255)
+    {
+        if (sat == 0)
+        {
+            r = 255;
+            g = 255;
+            b = 255;
+        }
+        else
+        {
+            const uint8_t desat = scale8_video(255 - sat, 255 - sat);
+            const uint8_t satscale = 255 - desat;
+
+            r = scale8(r, satscale) + desat;
+            g = scale8(g, satscale) + desat;
+            b = scale8(b, satscale) + desat;
+        }
+    }
+
+    if (val != 255)
+    {
+        val = scale8_video(val, val);
+
+        if (val == 0)
+        {
+            r = 0;
+            g = 0;
+            b = 0;
+        }
+        else
+        {
+            r = scale8(r, val);
+            g = scale8(g, val);
+            b = scale8(b, val);
+        }
+    }
+
+    rgb.r = r;
+    rgb.g = g;
+    rgb.b = b;
+}
+
+void fill_solid(CRGB *leds, int numToFill, const CRGB &color)
+{
+    for (int i = 0; i < numToFill; i++)
+    {
+        leds[i] = color;
+    }
+}
+
+const TProgmemRGBPalette16 HeatColors_p = {{
+    0x000000,
+    0x330000, 0x660000, 0x990000, 0xCC0000, 0xFF0000,
+    0xFF3300, 0xFF6600, 0xFF9900, 0xFFCC00, 0xFFFF00,
+    0xFFFF33, 0xFFFF66, 0xFFFF99, 0xFFFFCC, 0xFFFFFF,
+}};
+
+CRGB ColorFromPalette(const CRGBPalette16 &pal, uint8_t index, uint8_t brightness, TBlendType blendType)
+{
+    const uint8_t hi4 = index >> 4;
+    const uint8_t lo4 = index & 0x0f;
+    CRGB color = pal.entries[hi4];
+
+    if (lo4 && (blendType != NOBLEND))
+    {
+        const CRGB &next = pal.entries[(hi4 + 1) % 16];
+        const uint8_t f2 = lo4 << 4;
+        const uint8_t f1 = 255 - f2;
+
+        for (int i = 0; i < 3; i++)
+        {
+            color[i] = scale8(color[i], f1) + scale8(next[i], f2);
+        }
+    }
+
+    if (brightness != 255)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            color[i] = brightness ? scale8(color[i], brightness + 1) : 0;
+        }
+    }
+
+    return color;
+}
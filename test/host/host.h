@@ -0,0 +1,59 @@
+#pragma once
+
+// The test's side of the host shims: the virtual clock, the pins, the frames
+// sent to the leds and the requests to the web server.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+namespace host
+{
+    // The virtual time since boot, in microseconds.
+    uint64_t now();
+
+    // Move the clock forward to `time`, firing the timer interrupts that fall due on the way.
+    void advanceTo(uint64_t time);
+
+    // When the timer interrupt is due next, or `UINT64_MAX` if it is off.
+    uint64_t nextTimerInterrupt();
+
+    // Drive an input pin, which fires its interrupt if the level changed. Pins start high.
+    void setPin(uint8_t pin, int level);
+
+    // Seeds `ESP.random()` and `random()`.
+    void seed(uint32_t seed);
+
+    // Where `Serial` writes, or `nullptr` to drop the output.
+    void setSerialOutput(FILE *out);
+
+    // Called by `FastLED.show()`, with each controller's pixels.
+    typedef std::function<void(const uint8_t *pixels, size_t size)> ShowHandler;
+    void setShowHandler(ShowHandler handler);
+
+    // Give `WiFiUDP` real sockets, at `WiFi.localAddress` on the loopback interface.
+    // Off by default, so that a replay only depends on its scenario.
+    void setNetworking(bool enabled);
+    bool networking();
+
+    // Run the callbacks of the TCP connections, as the SDK does whenever the sketch yields.
+    // `advanceTo()` does, after the timer interrupts.
+    void pollNetwork();
+
+    // Whether the firmware called `ESP.restart()`.
+    bool restartRequested();
+
+    struct HttpResponse
+    {
+        int code = 0;
+        std::string contentType;
+        std::string body;
+    };
+
+    typedef std::function<void(const HttpResponse &response)> HttpResponseHandler;
+
+    // Queue a request for the web server, which handles it on its next `handleClient()`.
+    void httpRequest(const std::string &method, const std::string &uri, const std::string &body, const std::string &contentType, HttpResponseHandler handler);
+}
@@ -0,0 +1,610 @@
+#include "ArduinoJson.h"
+
+JsonNodePtr JsonNode::member(const char *key) const
+{
+    for (const auto &pair : members)
+    {
+        if (pair.first == key)
+        {
+            return pair.second;
+        }
+    }
+
+    return nullptr;
+}
+
+JsonNodePtr &JsonNode::addMember(const char *key)
+{
+    for (auto &pair : members)
+    {
+        if (pair.first == key)
+        {
+            return pair.second;
+        }
+    }
+
+    members.emplace_back(key, std::make_shared<JsonNode>());
+
+    return members.back().second;
+}
+
+JsonNode &JsonVariant::resolve()
+{
+    if (!node)
+    {
+        // Without a parent, the value is detached and assigning it does nothing.
+        node = parent ? parent->addMember(key.c_str()) : std::make_shared<JsonNode>();
+    }
+
+    return *node;
+}
+
+JsonNodePtr JsonVariant::objectNode()
+{
+    JsonNode &n = resolve();
+
+    if (n.type == JsonNode::Null)
+    {
+        n.type = JsonNode::Object;
+    }
+
+    return (n.type == JsonNode::Object) ? node : nullptr;
+}
+
+JsonVariant &JsonVariant::operator=(const char *value)
+{
+    JsonNode &n = resolve();
+    n = JsonNode();
+
+    if (value)
+    {
+        n.type = JsonNode::Text;
+        n.text = value;
+    }
+
+    return *this;
+}
+
+JsonObject JsonVariant::createNestedObject(const char *key)
+{
+    const JsonNodePtr object = objectNode();
+
+    if (!object)
+    {
+        return JsonObject();
+    }
+
+    JsonNodePtr &child = object->addMember(key);
+    child = std::make_shared<JsonNode>();
+    child->type = JsonNode::Object;
+
+    return JsonObject(child);
+}
+
+JsonObject JsonArray::createNestedObject()
+{
+    if (!node || (node->type != JsonNode::Array))
+    {
+        return JsonObject();
+    }
+
+    JsonNodePtr child = std::make_shared<JsonNode>();
+    child->type = JsonNode::Object;
+    node->elements.push_back(child);
+
+    return JsonObject(child);
+}
+
+const char *DeserializationError::c_str() const
+{
+    static const char *const names[] = {"Ok", "EmptyInput", "IncompleteInput", "InvalidInput", "NoMemory", "TooDeep"};
+
+    return names[errorCode];
+}
+
+// A recursive descent parser, as strict as ArduinoJson's but for comments, which it doesn't take.
+class JsonParser
+{
+public:
+    JsonParser(const char *input, size_t size) : p(input), end(input + size) {}
+
+    DeserializationError parse(JsonNode &node)
+    {
+        skipSpaces();
+
+        if (p == end)
+        {
+            return DeserializationError::EmptyInput;
+        }
+
+        return parseValue(node, 0);
+    }
+
+private:
+    static const int MAX_DEPTH = 10;
+
+    void skipSpaces()
+    {
+        while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n')))
+        {
+            p++;
+        }
+    }
+
+    DeserializationError parseValue(JsonNode &node, int depth)
+    {
+        if (depth > MAX_DEPTH)
+        {
+            return DeserializationError::TooDeep;
+        }
+
+        skipSpaces();
+
+        if (p == end)
+        {
+            return DeserializationError::IncompleteInput;
+        }
+
+        switch (*p)
+        {
+        case '{':
+            return parseObject(node, depth);
+        case '[':
+            return parseArray(node, depth);
+        case '"':
+        case '\'':
+            node.type = JsonNode::Text;
+            return parseString(node.text);
+        default:
+            return parseLiteral(node);
+        }
+    }
+
+    DeserializationError parseObject(JsonNode &node, int depth)
+    {
+        node.type = JsonNode::Object;
+        p++;
+        skipSpaces();
+
+        if ((p < end) && (*p == '}'))
+        {
+            p++;
+            return DeserializationError::Ok;
+        }
+
+        for (;;)
+        {
+            skipSpaces();
+
+            if (p == end)
+            {
+                return DeserializationError::IncompleteInput;
+            }
+
+            if ((*p != '"') && (*p != '\''))
+            {
+                return DeserializationError::InvalidInput;
+            }
+
+            std::string key;
+            DeserializationError error = parseString(key);
+
+            if (error)
+            {
+                return error;
+            }
+
+            skipSpaces();
+
+            if (p == end)
+            {
+                return DeserializationError::IncompleteInput;
+            }
+
+            if (*p++ != ':')
+            {
+                return DeserializationError::InvalidInput;
+            }
+
+            JsonNodePtr &value = node.addMember(key.c_str());
+            value = std::make_shared<JsonNode>();
+            error = parseValue(*value, depth + 1);
+
+            if (error)
+            {
+                return error;
+            }
+
+            skipSpaces();
+
+            if (p == end)
+            {
+                return DeserializationError::IncompleteInput;
+            }
+
+            const char c = *p++;
+
+            if (c == '}')
+            {
+                return DeserializationError::Ok;
+            }
+
+            if (c != ',')
+            {
+                return DeserializationError::InvalidInput;
+            }
+        }
+    }
+
+    DeserializationError parseArray(JsonNode &node, int depth)
+    {
+        node.type = JsonNode::Array;
+        p++;
+        skipSpaces();
+
+        if ((p < end) && (*p == ']'))
+        {
+            p++;
+            return DeserializationError::Ok;
+        }
+
+        for (;;)
+        {
+            JsonNodePtr value = std::make_shared<JsonNode>();
+            DeserializationError error = parseValue(*value, depth + 1);
+
+            if (error)
+            {
+                return error;
+            }
+
+            node.elements.push_back(value);
+            skipSpaces();
+
+            if (p == end)
+            {
+                return DeserializationError::IncompleteInput;
+            }
+
+            const char c = *p++;
+
+            if (c == ']')
+            {
+                return DeserializationError::Ok;
+            }
+
+            if (c != ',')
+            {
+                return DeserializationError::InvalidInput;
+            }
+        }
+    }
+
+    static void appendUtf8(std::string &out, uint32_t codepoint)
+    {
+        if (codepoint < 0x80)
+        {
+            out += static_cast<char>(codepoint);
+        }
+        else if (codepoint < 0x800)
+        {
+            out += static_cast<char>(0xc0 | (codepoint >> 6));
+            out += static_cast<char>(0x80 | (codepoint & 0x3f));
+        }
+        else
+        {
+            out += static_cast<char>(0xe0 | (codepoint >> 12));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (codepoint & 0x3f));
+        }
+    }
+
+    DeserializationError parseString(std::string &out)
+    {
+        const char quote = *p++;
+
+        while (p < end)
+        {
+            const char c = *p++;
+
+            if (c == quote)
+            {
+                return DeserializationError::Ok;
+            }
+
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+
+            if (p == end)
+            {
+                return DeserializationError::IncompleteInput;
+            }
+
+            const char escaped = *p++;
+
+            switch (escaped)
+            {
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+            {
+                if (end - p < 4)
+                {
+                    return DeserializationError::IncompleteInput;
+                }
+
+                uint32_t codepoint = 0;
+
+                for (int i = 0; i < 4; i++)
+                {
+                    const char h = *p++;
+                    codepoint <<= 4;
+
+                    if ((h >= '0') && (h <= '9'))
+                    {
+                        codepoint |= h - '0';
+                    }
+                    else if ((h >= 'a') && (h <= 'f'))
+                    {
+                        codepoint |= h - 'a' + 10;
+                    }
+                    else if ((h >= 'A') && (h <= 'F'))
+                    {
+                        codepoint |= h - 'A' + 10;
+                    }
+                    else
+                    {
+                        return DeserializationError::InvalidInput;
+                    }
+                }
+
+                appendUtf8(out, codepoint);
+                break;
+            }
+            default:
+                out += escaped;
+                break;
+            }
+        }
+
+        return DeserializationError::IncompleteInput;
+    }
+
+    DeserializationError parseLiteral(JsonNode &node)
+    {
+        const char *start = p;
+
+        while ((p < end) && (strchr(" \t\r\n,:]}", *p) == nullptr))
+        {
+            p++;
+        }
+
+        const std::string token(start, p);
+
+        if (token == "true" || token == "false")
+        {
+            node.type = JsonNode::Boolean;
+            node.boolean = (token == "true");
+            return DeserializationError::Ok;
+        }
+
+        if (token == "null")
+        {
+            node.type = JsonNode::Null;
+            return DeserializationError::Ok;
+        }
+
+        if (token.empty() || (strchr("-0123456789", token[0]) == nullptr))
+        {
+            return DeserializationError::InvalidInput;
+        }
+
+        const bool negative = (token[0] == '-');
+        const size_t digits = negative ? 1 : 0;
+
+        if ((token.size() > digits) && (token.find_first_not_of("0123456789", digits) == std::string::npos))
+        {
+            errno = 0;
+            const uint64_t magnitude = strtoull(token.c_str() + digits, nullptr, 10);
+
+            if (errno == 0)
+            {
+                node.type = JsonNode::Integer;
+                node.negative = negative && (magnitude != 0);
+                node.integer = magnitude;
+                return DeserializationError::Ok;
+            }
+        }
+
+        char *parsed = nullptr;
+        node.type = JsonNode::Float;
+        node.real = strtod(token.c_str(), &parsed);
+
+        return (*parsed == '\0') ? DeserializationError::Ok : DeserializationError::InvalidInput;
+    }
+
+    const char *p;
+    const char *end;
+};
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input, size_t size)
+{
+    doc.clear();
+
+    JsonParser parser(input, size);
+    const DeserializationError error = parser.parse(*doc.root);
+
+    if (error)
+    {
+        doc.clear();
+    }
+
+    return error;
+}
+
+static void writeString(std::string &out, const std::string &s)
+{
+    out += '"';
+
+    for (const char c : s)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            out += c;
+            break;
+        }
+    }
+
+    out += '"';
+}
+
+// `indent` is 0 for the compact form, or the number of spaces per level.
+static void writeNode(std::string &out, const JsonNode &node, int indent, int depth)
+{
+    const std::string newline = indent ? "\r\n" : "";
+    const std::string inner = indent ? newline + std::string((depth + 1) * indent, ' ') : "";
+    const std::string outer = indent ? newline + std::string(depth * indent, ' ') : "";
+
+    switch (node.type)
+    {
+    case JsonNode::Null:
+        out += "null";
+        break;
+    case JsonNode::Boolean:
+        out += node.boolean ? "true" : "false";
+        break;
+    case JsonNode::Integer:
+        out += node.negative ? "-" : "";
+        out += std::to_string(node.integer);
+        break;
+    case JsonNode::Float:
+    {
+        char tmp[32];
+        snprintf(tmp, sizeof(tmp), "%.9g", node.real);
+        out += tmp;
+        break;
+    }
+    case JsonNode::Text:
+        writeString(out, node.text);
+        break;
+    case JsonNode::Object:
+        out += '{';
+
+        for (size_t i = 0; i < node.members.size(); i++)
+        {
+            out += (i > 0) ? "," : "";
+            out += inner;
+            writeString(out, node.members[i].first);
+            out += indent ? ": " : ":";
+            writeNode(out, *node.members[i].second, indent, depth + 1);
+        }
+
+        out += node.members.empty() ? "" : outer;
+        out += '}';
+        break;
+    case JsonNode::Array:
+        out += '[';
+
+        for (size_t i = 0; i < node.elements.size(); i++)
+        {
+            out += (i > 0) ? "," : "";
+            out += inner;
+            writeNode(out, *node.elements[i], indent, depth + 1);
+        }
+
+        out += node.elements.empty() ? "" : outer;
+        out += ']';
+        break;
+    }
+}
+
+size_t serializeJson(const JsonDocument &doc, char *output, size_t size)
+{
+    std::string out;
+    writeNode(out, *doc.root, 0, 0);
+
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    const size_t len = min(out.size(), size - 1);
+    memcpy(output, out.data(), len);
+    output[len] = '\0';
+
+    return len;
+}
+
+size_t serializeJson(const JsonDocument &doc, String &output)
+{
+    std::string out;
+    writeNode(out, *doc.root, 0, 0);
+    output = String(out);
+
+    return out.size();
+}
+
+size_t serializeJsonPretty(const JsonDocument &doc, String &output)
+{
+    std::string out;
+    writeNode(out, *doc.root, 2, 0);
+    output = String(out);
+
+    return out.size();
+}
+
+String JsonVariant::convert(String *) const
+{
+    if (!node)
+    {
+        return "null";
+    }
+
+    if (node->type == JsonNode::Text)
+    {
+        return String(node->text);
+    }
+
+    std::string out;
+    writeNode(out, *node, 0, 0);
+
+    return String(out);
+}
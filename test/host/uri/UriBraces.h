@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <string>
+
+class Uri
+{
+public:
+    Uri(const char *uri) : uri(uri) {}
+    virtual ~Uri() = default;
+
+    std::string uri;
+};
+
+// Each "{}" matches a path segment, which the handler gets through `pathArg()`.
+class UriBraces : public Uri
+{
+public:
+    UriBraces(const char *uri) : Uri(uri) {}
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+// The ESP8266 SDK, for the host tests.
+
+#include <cstdint>
+
+#define SYS_CPU_80MHZ 80
+#define SYS_CPU_160MHZ 160
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    bool system_update_cpu_freq(uint8_t freq);
+    uint8_t system_get_cpu_freq(void);
+
+#ifdef __cplusplus
+}
+#endif
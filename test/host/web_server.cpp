@@ -0,0 +1,356 @@
+#include "ESP8266WebServer.h"
+
+#include "host.h"
+
+#include <ESP8266mDNS.h>
+#include <ESP_EEPROM.h>
+#include <LittleFS.h>
+#include <Updater.h>
+
+#include <deque>
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+EEPROMClass EEPROM;
+FS LittleFS;
+UpdaterClass Update;
+
+struct PendingRequest
+{
+    std::string method;
+    std::string uri;
+    std::string body;
+    std::string contentType;
+    host::HttpResponseHandler handler;
+};
+
+static std::deque<PendingRequest> pendingRequests;
+
+namespace host
+{
+    void httpRequest(const std::string &method, const std::string &uri, const std::string &body, const std::string &contentType, HttpResponseHandler handler)
+    {
+        pendingRequests.push_back({method, uri, body, contentType, handler});
+    }
+}
+
+struct ESP8266WebServer::Response
+{
+    host::HttpResponse response;
+    bool sent = false;
+};
+
+static HTTPMethod methodFromString(const std::string &method)
+{
+    static const std::pair<const char *, HTTPMethod> methods[] = {
+        {"GET", HTTP_GET},
+        {"HEAD", HTTP_HEAD},
+        {"POST", HTTP_POST},
+        {"PUT", HTTP_PUT},
+        {"PATCH", HTTP_PATCH},
+        {"DELETE", HTTP_DELETE},
+        {"OPTIONS", HTTP_OPTIONS},
+    };
+
+    for (const auto &m : methods)
+    {
+        if (strcasecmp(method.c_str(), m.first) == 0)
+        {
+            return m.second;
+        }
+    }
+
+    return HTTP_ANY;
+}
+
+static int hexValue(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return c - '0';
+    }
+
+    if ((c >= 'a') && (c <= 'f'))
+    {
+        return c - 'a' + 10;
+    }
+
+    if ((c >= 'A') && (c <= 'F'))
+    {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static std::string urlDecode(const std::string &s)
+{
+    std::string out;
+
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if ((s[i] == '%') && (i + 2 < s.size()) && (hexValue(s[i + 1]) >= 0) && (hexValue(s[i + 2]) >= 0))
+        {
+            out += static_cast<char>((hexValue(s[i + 1]) << 4) | hexValue(s[i + 2]));
+            i += 2;
+        }
+        else
+        {
+            out += (s[i] == '+') ? ' ' : s[i];
+        }
+    }
+
+    return out;
+}
+
+static void parseArgs(const std::string &query, std::vector<std::pair<std::string, std::string>> &args)
+{
+    size_t start = 0;
+
+    while (start < query.size())
+    {
+        size_t end = query.find('&', start);
+        end = (end == std::string::npos) ? query.size() : end;
+
+        const std::string pair = query.substr(start, end - start);
+        const size_t equals = pair.find('=');
+
+        if (!pair.empty())
+        {
+            args.emplace_back(urlDecode(pair.substr(0, equals)), (equals == std::string::npos) ? "" : urlDecode(pair.substr(equals + 1)));
+        }
+
+        start = end + 1;
+    }
+}
+
+static std::string base64Encode(const std::string &s)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+
+    for (size_t i = 0; i < s.size(); i += 3)
+    {
+        const uint32_t n = (static_cast<uint8_t>(s[i]) << 16) |
+                           ((i + 1 < s.size()) ? static_cast<uint8_t>(s[i + 1]) << 8 : 0) |
+                           ((i + 2 < s.size()) ? static_cast<uint8_t>(s[i + 2]) : 0);
+
+        out += alphabet[(n >> 18) & 0x3f];
+        out += alphabet[(n >> 12) & 0x3f];
+        out += (i + 1 < s.size()) ? alphabet[(n >> 6) & 0x3f] : '=';
+        out += (i + 2 < s.size()) ? alphabet[n & 0x3f] : '=';
+    }
+
+    return out;
+}
+
+void ESP8266WebServer::on(const Uri &uri, HTTPMethod method, THandlerFunction handler, THandlerFunction)
+{
+    routes.push_back({uri.uri, dynamic_cast<const UriBraces *>(&uri) != nullptr, method, handler});
+}
+
+void ESP8266WebServer::onNotFound(THandlerFunction handler)
+{
+    notFoundHandler = handler;
+}
+
+void ESP8266WebServer::addHook(HookFunction hook)
+{
+    hooks.push_back(hook);
+}
+
+bool ESP8266WebServer::match(const Route &route, const std::string &path)
+{
+    pathArgs.clear();
+
+    if (!route.braces)
+    {
+        return route.uri == path;
+    }
+
+    size_t u = 0;
+    size_t p = 0;
+
+    while ((u < route.uri.size()) && (p <= path.size()))
+    {
+        if (route.uri.compare(u, 2, "{}") == 0)
+        {
+            const size_t end = path.find('/', p);
+            pathArgs.push_back(path.substr(p, (end == std::string::npos) ? std::string::npos : end - p));
+            p = (end == std::string::npos) ? path.size() : end;
+            u += 2;
+        }
+        else if ((p < path.size()) && (route.uri[u] == path[p]))
+        {
+            u++;
+            p++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return (u == route.uri.size()) && (p == path.size());
+}
+
+void ESP8266WebServer::handleClient()
+{
+    while (!pendingRequests.empty())
+    {
+        const PendingRequest request = pendingRequests.front();
+        pendingRequests.pop_front();
+
+        const size_t question = request.uri.find('?');
+        const std::string path = request.uri.substr(0, question);
+        const HTTPMethod method = methodFromString(request.method);
+
+        args.clear();
+        headers.clear();
+        currentUpload = HTTPUpload();
+        contentLength = CONTENT_LENGTH_UNKNOWN;
+        response = std::make_shared<Response>();
+
+        if (question != std::string::npos)
+        {
+            parseArgs(request.uri.substr(question + 1), args);
+        }
+
+        if (request.contentType == "application/x-www-form-urlencoded")
+        {
+            parseArgs(request.body, args);
+        }
+
+        args.emplace_back("plain", request.body);
+
+        if (!request.contentType.empty())
+        {
+            headers.emplace_back("content-type", request.contentType);
+        }
+
+        for (const HookFunction &hook : hooks)
+        {
+            hook(String(request.method), String(path), nullptr, [](const String &) { return String("application/octet-stream"); });
+        }
+
+        THandlerFunction handler = notFoundHandler;
+
+        for (const Route &route : routes)
+        {
+            if (((route.method == HTTP_ANY) || (route.method == method)) && match(route, path))
+            {
+                handler = route.handler;
+                break;
+            }
+        }
+
+        if (handler)
+        {
+            handler();
+        }
+
+        if (request.handler)
+        {
+            request.handler(response->response);
+        }
+
+        response.reset();
+    }
+}
+
+bool ESP8266WebServer::hasArg(const String &name) const
+{
+    for (const auto &a : args)
+    {
+        if (a.first == name.value)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+String ESP8266WebServer::arg(const String &name) const
+{
+    for (const auto &a : args)
+    {
+        if (a.first == name.value)
+        {
+            return String(a.second);
+        }
+    }
+
+    return String();
+}
+
+String ESP8266WebServer::pathArg(unsigned int i) const
+{
+    return (i < pathArgs.size()) ? String(pathArgs[i]) : String();
+}
+
+String ESP8266WebServer::header(const String &name) const
+{
+    for (const auto &h : headers)
+    {
+        if (strcasecmp(h.first.c_str(), name.c_str()) == 0)
+        {
+            return String(h.second);
+        }
+    }
+
+    return String();
+}
+
+bool ESP8266WebServer::authenticate(const char *username, const char *password)
+{
+    const std::string expected = "Basic " + base64Encode(std::string(username) + ":" + password);
+
+    return header("authorization").value == expected;
+}
+
+void ESP8266WebServer::requestAuthentication()
+{
+    send(401, "text/plain", "");
+}
+
+WiFiClient ESP8266WebServer::client()
+{
+    WiFiClient c;
+    c.sink = response ? &response->response.body : nullptr;
+
+    return c;
+}
+
+void ESP8266WebServer::sendHeader(const String &, const String &, bool) {}
+
+void ESP8266WebServer::send(int code, const char *contentType, const String &content)
+{
+    send(code, contentType, content.c_str());
+}
+
+void ESP8266WebServer::send(int code, const char *contentType, const char *content)
+{
+    if (!response || response->sent)
+    {
+        return;
+    }
+
+    response->sent = true;
+    response->response.code = code;
+    response->response.contentType = contentType;
+    response->response.body = content;
+}
+
+void ESP8266WebServer::sendContent(const String &content)
+{
+    sendContent(content.c_str(), content.length());
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t size)
+{
+    if (response)
+    {
+        response->response.body.append(content, size);
+    }
+}
@@ -0,0 +1,200 @@
+#include "WiFiUdp.h"
+
+#include "host.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static bool networkingEnabled = false;
+
+namespace host
+{
+    void setNetworking(bool enabled)
+    {
+        networkingEnabled = enabled;
+    }
+
+    bool networking()
+    {
+        return networkingEnabled;
+    }
+}
+
+static sockaddr_in socketAddress(IPAddress ip, uint16_t port)
+{
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    // Both are in network byte order.
+    address.sin_addr.s_addr = static_cast<uint32_t>(ip);
+
+    return address;
+}
+
+// A non-blocking datagram socket bound to `ip:port`, or -1.
+static int openSocket(IPAddress ip, uint16_t port, bool shared)
+{
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    const int one = 1;
+
+    if (shared)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+
+    const sockaddr_in address = socketAddress(ip, port);
+
+    if ((bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) || (fcntl(fd, F_SETFL, O_NONBLOCK) < 0))
+    {
+        close(fd);
+        return -1;
+    }
+
+    // Multicast goes out of the controller's own address, and loops back to the other controllers on this host.
+    const in_addr interfaceAddress = {static_cast<uint32_t>(WiFi.localAddress)};
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddress, sizeof(interfaceAddress));
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+
+    return fd;
+}
+
+WiFiUDP::~WiFiUDP()
+{
+    stop();
+}
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+    stop();
+
+    if (!networkingEnabled)
+    {
+        return 1;
+    }
+
+    unicastSocket = openSocket(WiFi.localAddress, port, false);
+
+    return unicastSocket >= 0;
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress interfaceAddress, IPAddress multicast, uint16_t port)
+{
+    if (!begin(port))
+    {
+        return 0;
+    }
+
+    if (!networkingEnabled)
+    {
+        return 1;
+    }
+
+    multicastSocket = openSocket(multicast, port, true);
+
+    ip_mreq membership = {};
+    membership.imr_multiaddr.s_addr = static_cast<uint32_t>(multicast);
+    membership.imr_interface.s_addr = static_cast<uint32_t>(interfaceAddress);
+
+    if ((multicastSocket < 0) || (setsockopt(multicastSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0))
+    {
+        stop();
+        return 0;
+    }
+
+    return 1;
+}
+
+void WiFiUDP::stop()
+{
+    for (int *fd : {&unicastSocket, &multicastSocket})
+    {
+        if (*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+
+    in.clear();
+    inPosition = 0;
+}
+
+int WiFiUDP::parsePacket()
+{
+    in.clear();
+    inPosition = 0;
+
+    for (int fd : {multicastSocket, unicastSocket})
+    {
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        uint8_t buffer[1500];
+        sockaddr_in from = {};
+        socklen_t fromSize = sizeof(from);
+        const ssize_t len = recvfrom(fd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&from), &fromSize);
+
+        if (len >= 0)
+        {
+            in.assign(buffer, buffer + len);
+            remoteAddress = IPAddress(from.sin_addr.s_addr);
+            remotePortNumber = ntohs(from.sin_port);
+            return len;
+        }
+    }
+
+    return 0;
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t size)
+{
+    const size_t len = min(size, in.size() - inPosition);
+    memcpy(buffer, in.data() + inPosition, len);
+    inPosition += len;
+
+    return len;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+    out.clear();
+    destination = ip;
+    destinationPort = port;
+
+    return 1;
+}
+
+int WiFiUDP::beginPacketMulticast(IPAddress multicast, uint16_t port, IPAddress, int)
+{
+    return beginPacket(multicast, port);
+}
+
+int WiFiUDP::endPacket()
+{
+    if (!networkingEnabled)
+    {
+        return 1;
+    }
+
+    // Like the core, a socket that didn't `begin()` sends from any port.
+    if (unicastSocket < 0)
+    {
+        unicastSocket = openSocket(WiFi.localAddress, 0, false);
+    }
+
+    const sockaddr_in address = socketAddress(destination, destinationPort);
+    const ssize_t sent = sendto(unicastSocket, out.data(), out.size(), 0, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+
+    return sent == static_cast<ssize_t>(out.size());
+}
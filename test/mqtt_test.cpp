@@ -0,0 +1,554 @@
+// Runs the controller against a local mosquitto, and checks that the MQTT
+// client mirrors the state without ever holding up the frames.
+//
+// The whole firmware runs in this process, with real sockets on the loopback
+// interface and its virtual clock following the wall clock. The test talks to
+// the broker as another client would. It goes through a broker that accepts
+// the connection but never answers, a working one, the broker going away and
+// coming back, and measures how many broker messages a state change costs.
+//
+// Without `mosquitto` in the PATH, the test is skipped.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "host.h"
+
+#include "config.h"
+#include "mqtt.h"
+#include "state.h"
+
+#include <arpa/inet.h>
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <functional>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+void loop();
+
+static const char *TOPIC = "ohm-led/mqtt-test";
+// The frames come at the configured rate: a gap longer than this means something held up the loop.
+static const uint64_t MAX_FRAME_GAP_US = 50000;
+
+static bool verbose = false;
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "mqtt: %s\n", what);
+        failures++;
+    }
+}
+
+static uint64_t wallClock()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+}
+
+static std::string findInPath(const char *name)
+{
+    const char *path = getenv("PATH");
+    std::string dirs = path ? path : "";
+
+    for (size_t start = 0; start <= dirs.size();)
+    {
+        size_t end = dirs.find(':', start);
+        end = (end == std::string::npos) ? dirs.size() : end;
+
+        const std::string candidate = dirs.substr(start, end - start) + "/" + name;
+
+        if (access(candidate.c_str(), X_OK) == 0)
+        {
+            return candidate;
+        }
+
+        start = end + 1;
+    }
+
+    return "";
+}
+
+static int connectTo(uint16_t port)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return fd;
+}
+
+// A mosquitto process listening on `port`, or a socket that accepts connections and never answers.
+class Broker
+{
+public:
+    static Broker mosquitto(const std::string &path, uint16_t port)
+    {
+        Broker broker;
+        broker.pid = fork();
+
+        if (broker.pid == 0)
+        {
+            if (!verbose)
+            {
+                const int null = open("/dev/null", O_WRONLY);
+                dup2(null, STDOUT_FILENO);
+                dup2(null, STDERR_FILENO);
+            }
+
+            const std::string portArg = std::to_string(port);
+            execl(path.c_str(), path.c_str(), "-p", portArg.c_str(), static_cast<char *>(nullptr));
+            _exit(127);
+        }
+
+        broker.port = port;
+
+        return broker;
+    }
+
+    // Whether the broker accepts connections yet. It is started in the background, as the controller keeps running.
+    bool accepting()
+    {
+        // Probe every 10ms at most.
+        if (wallClock() - lastProbe < 10000)
+        {
+            return false;
+        }
+
+        lastProbe = wallClock();
+        const int fd = connectTo(port);
+
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        close(fd);
+        return true;
+    }
+
+    static Broker silent(uint16_t port)
+    {
+        Broker broker;
+        broker.listener = socket(AF_INET, SOCK_STREAM, 0);
+
+        const int one = 1;
+        setsockopt(broker.listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if ((bind(broker.listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) || (listen(broker.listener, 4) < 0))
+        {
+            broker.stop();
+        }
+
+        return broker;
+    }
+
+    bool running() const
+    {
+        return (pid > 0) || (listener >= 0);
+    }
+
+    void stop()
+    {
+        if (pid > 0)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            pid = -1;
+        }
+
+        if (listener >= 0)
+        {
+            close(listener);
+            listener = -1;
+        }
+    }
+
+private:
+    pid_t pid = -1;
+    int listener = -1;
+    uint16_t port = 0;
+    uint64_t lastProbe = 0;
+};
+
+// The test's own connection to the broker, as the building automation would have.
+class Client
+{
+public:
+    struct Message
+    {
+        std::string topic;
+        std::string payload;
+    };
+
+    bool connect(uint16_t port)
+    {
+        fd = connectTo(port);
+
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        std::string body;
+        appendString(body, "MQTT");
+        // MQTT 3.1.1, a clean session, and a keep-alive long enough for the test.
+        body += '\x04';
+        body += '\x02';
+        body += '\x00';
+        body += '\x3c';
+        appendString(body, "mqtt-test-client");
+        sendPacket(0x10, body);
+
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        return true;
+    }
+
+    void subscribe(const std::string &topic)
+    {
+        std::string body = {'\x00', '\x01'};
+        appendString(body, topic);
+        body += '\x00';
+        sendPacket(0x82, body);
+    }
+
+    void publish(const std::string &topic, const std::string &payload)
+    {
+        std::string body;
+        appendString(body, topic);
+        body += payload;
+        sendPacket(0x30, body);
+    }
+
+    // The messages received since the last call.
+    std::vector<Message> receive()
+    {
+        char buffer[4096];
+        ssize_t len;
+
+        while ((len = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        {
+            in.append(buffer, len);
+        }
+
+        std::vector<Message> messages;
+
+        for (;;)
+        {
+            size_t length = 0;
+            size_t headerSize = 1;
+            bool complete = false;
+
+            for (int shift = 0; (headerSize < in.size()) && (shift < 28); shift += 7)
+            {
+                const uint8_t byte = in[headerSize++];
+                length |= static_cast<size_t>(byte & 0x7F) << shift;
+
+                if (!(byte & 0x80))
+                {
+                    complete = true;
+                    break;
+                }
+            }
+
+            if (!complete || (in.size() < headerSize + length))
+            {
+                break;
+            }
+
+            const std::string body = in.substr(headerSize, length);
+            const uint8_t type = in[0];
+            in.erase(0, headerSize + length);
+
+            if ((type >> 4) == 3)
+            {
+                const size_t topicLength = (static_cast<uint8_t>(body[0]) << 8) | static_cast<uint8_t>(body[1]);
+                const size_t offset = 2 + topicLength + ((type & 0x06) ? 2 : 0);
+                messages.push_back({body.substr(2, topicLength), body.substr(offset)});
+            }
+        }
+
+        return messages;
+    }
+
+    ~Client()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+private:
+    static void appendString(std::string &out, const std::string &s)
+    {
+        out += static_cast<char>(s.size() >> 8);
+        out += static_cast<char>(s.size() & 0xFF);
+        out += s;
+    }
+
+    void sendPacket(uint8_t header, const std::string &body)
+    {
+        std::string packet(1, static_cast<char>(header));
+        size_t remaining = body.size();
+
+        do
+        {
+            packet += static_cast<char>((remaining % 128) | ((remaining >= 128) ? 0x80 : 0));
+            remaining /= 128;
+        } while (remaining > 0);
+
+        packet += body;
+
+        if (send(fd, packet.data(), packet.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(packet.size()))
+        {
+            check(false, "the test client couldn't write to the broker");
+        }
+    }
+
+    int fd = -1;
+    std::string in;
+};
+
+// The firmware, driven in real time.
+class Controller
+{
+public:
+    Controller()
+    {
+        host::setShowHandler([this](const uint8_t *, size_t)
+                             {
+                                 const uint64_t now = host::now();
+
+                                 if (lastFrame != 0)
+                                 {
+                                     maxFrameGap = max(maxFrameGap, now - lastFrame);
+                                 }
+
+                                 lastFrame = now; });
+    }
+
+    void start()
+    {
+        setup();
+
+        // Something that renders every frame, so that any hold-up shows.
+        StateUpdate update;
+        update.fields = StateField_Mode;
+        update.mode = StateMode_Rainbow;
+        state.submit(update);
+
+        start_ = wallClock() - host::now();
+        lastFrame = 0;
+        maxFrameGap = 0;
+    }
+
+    // Run the loop for `duration`, or until `done` returns true. Returns whether it did.
+    bool run(uint64_t duration, const std::function<bool()> &done = nullptr)
+    {
+        const uint64_t deadline = wallClock() + duration;
+
+        while (wallClock() < deadline)
+        {
+            const uint64_t before = wallClock();
+            loop();
+            maxLoopTime = max(maxLoopTime, wallClock() - before);
+
+            if (done && done())
+            {
+                return true;
+            }
+
+            const uint64_t next = host::now() + 1000;
+            const uint64_t wall = wallClock() - start_;
+
+            if (wall < next)
+            {
+                usleep(next - wall);
+            }
+
+            host::advanceTo(max(next, wallClock() - start_));
+        }
+
+        return !done;
+    }
+
+    uint64_t maxFrameGap = 0;
+    uint64_t maxLoopTime = 0;
+
+private:
+    uint64_t start_ = 0;
+    uint64_t lastFrame = 0;
+};
+
+static bool contains(const std::vector<Client::Message> &messages, const std::string &topic, const std::string &needle)
+{
+    for (const Client::Message &message : messages)
+    {
+        if ((message.topic == topic) && (message.payload.find(needle) != std::string::npos))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc > 1) && (strcmp(argv[1], "-v") == 0))
+    {
+        verbose = true;
+        host::setSerialOutput(stderr);
+    }
+
+    const std::string mosquitto = findInPath("mosquitto");
+
+    if (mosquitto.empty())
+    {
+        printf("mqtt: skipped, mosquitto is not installed\n");
+        return 0;
+    }
+
+    const uint16_t port = 40000 + getpid() % 20000;
+    const std::string stateTopic = std::string(TOPIC) + "/state";
+    const std::string availableTopic = std::string(TOPIC) + "/available";
+
+    host::setNetworking(true);
+    strncpy(config.ssid, "mqtt", sizeof(config.ssid) - 1);
+    strncpy(config.mqtt_host, "127.0.0.1", sizeof(config.mqtt_host) - 1);
+    strncpy(config.mqtt_topic, TOPIC, sizeof(config.mqtt_topic) - 1);
+    config.mqtt_port = port;
+    config.Save();
+
+    Controller controller;
+
+    // A broker that takes the connection and never answers: the controller keeps rendering, then gives up.
+    Broker broker = Broker::silent(port);
+    check(broker.running(), "couldn't listen for the silent broker");
+
+    controller.start();
+    controller.run(6500000);
+    check(!mqttStats().connected, "connected to a broker that never answered");
+    broker.stop();
+
+    // A real broker: the controller connects, announces itself and publishes its state.
+    broker = Broker::mosquitto(mosquitto, port);
+    check(controller.run(5000000, [&]()
+                         { return broker.accepting(); }),
+          "mosquitto didn't start");
+
+    Client client;
+    check(client.connect(port), "the test client couldn't connect to mosquitto");
+    client.subscribe(availableTopic);
+    client.subscribe(stateTopic);
+
+    std::vector<Client::Message> messages;
+    const auto collect = [&]()
+    {
+        const std::vector<Client::Message> received = client.receive();
+        messages.insert(messages.end(), received.begin(), received.end());
+    };
+
+    check(controller.run(5000000, [&]()
+                         { collect(); return contains(messages, stateTopic, "\"rainbow\""); }),
+          "the controller didn't publish its state");
+    check(contains(messages, availableTopic, "online"), "the controller didn't announce itself");
+
+    // Commands come in on the set topic.
+    client.publish(std::string(TOPIC) + "/set", "{\"hue\":42}");
+    check(controller.run(2000000, [&]()
+                         { collect(); return state.snapshot().hue == 42; }),
+          "the controller didn't apply a command");
+
+    // How many broker messages a state change costs, at the pace of a person, then of a dragged slider.
+    controller.run(500000);
+    const MqttStats before = mqttStats();
+
+    for (int i = 0; i < 10; i++)
+    {
+        client.publish(std::string(TOPIC) + "/set", "{\"hue\":" + std::to_string(100 + i) + "}");
+        controller.run(300000);
+    }
+
+    const MqttStats paced = mqttStats();
+
+    for (int i = 0; i < 50; i++)
+    {
+        client.publish(std::string(TOPIC) + "/set", "{\"hue\":" + std::to_string(150 + i) + "}");
+        controller.run(10000);
+    }
+
+    controller.run(500000);
+    const MqttStats dragged = mqttStats();
+
+    check(paced.published - before.published == paced.state_changes - before.state_changes, "a paced state change wasn't published exactly once");
+    check(dragged.published - paced.published < dragged.state_changes - paced.state_changes, "quick state changes weren't coalesced");
+
+    // The broker goes away and comes back: the controller reconnects and publishes its state again.
+    broker.stop();
+    controller.run(2500000);
+    check(!mqttStats().connected, "didn't notice the broker going away");
+
+    broker = Broker::mosquitto(mosquitto, port);
+    check(controller.run(5000000, [&]()
+                         { return broker.accepting(); }),
+          "mosquitto didn't start again");
+
+    const uint32_t connections = mqttStats().connections;
+    check(controller.run(10000000, [&]()
+                         { return mqttStats().connections > connections; }),
+          "didn't reconnect to the broker");
+
+    broker.stop();
+
+    if (controller.maxFrameGap > MAX_FRAME_GAP_US)
+    {
+        fprintf(stderr, "mqtt: the frames were held up, for %.1fms\n", controller.maxFrameGap / 1000.0);
+        failures++;
+    }
+
+    if (failures != 0)
+    {
+        return 1;
+    }
+
+    printf("mqtt: %u state change(s) at a person's pace cost %u message(s), %u quick ones cost %u, "
+           "frames at most %.1fms apart, a loop took at most %.1fms\n",
+           static_cast<unsigned>(paced.state_changes - before.state_changes), static_cast<unsigned>(paced.published - before.published),
+           static_cast<unsigned>(dragged.state_changes - paced.state_changes), static_cast<unsigned>(dragged.published - paced.published),
+           controller.maxFrameGap / 1000.0, controller.maxLoopTime / 1000.0);
+
+    return 0;
+}
@@ -0,0 +1,585 @@
+// Replays a scenario through the firmware, on a virtual clock, and records
+// every frame sent to the leds in a trace, to compare with a golden one.
+//
+// The whole sketch runs, with the Arduino core, FastLED, ArduinoJson and the
+// network replaced by the shims in host/. A scenario is a text file:
+//
+//     # A comment.
+//     seed 42
+//     0 put /v1/state/ {"mode":"fire"}
+//     1500 press
+//     1600 release
+//     60000 end
+//
+// Times are in milliseconds since the end of `setup()`. `seed` seeds FastLED's
+// and the core's RNGs before `setup()`. `press` and `release` drive the button
+// pin, `get`, `put`, `post` and `delete` send a request to the web server, with
+// an optional JSON body, and `end` stops the replay. A request that doesn't
+// succeed fails the replay, as does anything that restarts the controller.
+//
+// The trace starts with "OLRT", a version byte and 3 reserved bytes, followed
+// by records, which start with their type and hold unsigned LEB128 varints:
+//
+//     0x01 FRAME: dt, spans, then for each span: skip, length, the bytes.
+//     0x02 SIZE: the frame size in bytes, which applies to the frames after it.
+//     0x03 REPEAT: dt, count.
+//
+// `dt` is the time since the previous frame, in milliseconds. A frame only
+// holds the byte spans that changed since the previous frame, each `skip`
+// bytes after the end of the previous span. REPEAT stands for `count` frames,
+// each `dt` after the previous one, which didn't change anything.
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "host.h"
+
+#include "config.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+static const uint8_t TRACE_VERSION = 1;
+
+enum TraceRecord
+{
+    TraceRecord_Frame = 1,
+    TraceRecord_Size = 2,
+    TraceRecord_Repeat = 3,
+};
+
+// Unchanged runs shorter than this don't end a span, as a new span costs more.
+static const size_t SPAN_GAP = 3;
+
+struct Frame
+{
+    uint32_t time;
+    std::vector<uint8_t> pixels;
+};
+
+class TraceWriter
+{
+public:
+    TraceWriter()
+    {
+        out = {'O', 'L', 'R', 'T', TRACE_VERSION, 0, 0, 0};
+    }
+
+    void add(uint32_t time, const uint8_t *pixels, size_t size)
+    {
+        const uint32_t dt = time - lastTime;
+        const bool sameSize = (size == previous.size());
+        lastTime = time;
+        frames++;
+
+        if (sameSize && std::equal(pixels, pixels + size, previous.begin()) && ((repeatCount == 0) || (dt == repeatDt)))
+        {
+            repeatDt = dt;
+            repeatCount++;
+            return;
+        }
+
+        flushRepeat();
+
+        if (!sameSize)
+        {
+            out.push_back(TraceRecord_Size);
+            writeVarint(size);
+            previous.assign(size, 0);
+        }
+
+        std::vector<std::pair<size_t, size_t>> spans;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            if (pixels[i] == previous[i])
+            {
+                continue;
+            }
+
+            if (!spans.empty() && (i - spans.back().second <= SPAN_GAP))
+            {
+                spans.back().second = i + 1;
+            }
+            else
+            {
+                spans.emplace_back(i, i + 1);
+            }
+        }
+
+        out.push_back(TraceRecord_Frame);
+        writeVarint(dt);
+        writeVarint(spans.size());
+
+        size_t end = 0;
+
+        for (const auto &span : spans)
+        {
+            writeVarint(span.first - end);
+            writeVarint(span.second - span.first);
+            out.insert(out.end(), pixels + span.first, pixels + span.second);
+            end = span.second;
+        }
+
+        previous.assign(pixels, pixels + size);
+    }
+
+    const std::vector<uint8_t> &finish()
+    {
+        flushRepeat();
+        return out;
+    }
+
+    size_t frames = 0;
+
+private:
+    void flushRepeat()
+    {
+        if (repeatCount > 0)
+        {
+            out.push_back(TraceRecord_Repeat);
+            writeVarint(repeatDt);
+            writeVarint(repeatCount);
+            repeatCount = 0;
+        }
+    }
+
+    void writeVarint(uint64_t value)
+    {
+        do
+        {
+            const uint8_t byte = value & 0x7f;
+            value >>= 7;
+            out.push_back(byte | (value ? 0x80 : 0));
+        } while (value);
+    }
+
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> previous;
+    uint32_t lastTime = 0;
+    uint32_t repeatDt = 0;
+    uint32_t repeatCount = 0;
+};
+
+// Calls `onFrame` with each frame of `trace`, and returns false if it is malformed.
+template <typename F>
+static bool readTrace(const std::vector<uint8_t> &trace, F onFrame)
+{
+    static const uint8_t MAGIC[] = {'O', 'L', 'R', 'T'};
+
+    if ((trace.size() < 8) || !std::equal(MAGIC, MAGIC + 4, trace.begin()) || (trace[4] != TRACE_VERSION))
+    {
+        return false;
+    }
+
+    size_t p = 8;
+    bool ok = true;
+
+    const auto readVarint = [&]() -> uint64_t
+    {
+        uint64_t value = 0;
+
+        for (int shift = 0; ok; shift += 7)
+        {
+            if ((p >= trace.size()) || (shift > 63))
+            {
+                ok = false;
+                break;
+            }
+
+            const uint8_t byte = trace[p++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+
+        return value;
+    };
+
+    Frame frame = {0, {}};
+
+    while (ok && (p < trace.size()))
+    {
+        switch (trace[p++])
+        {
+        case TraceRecord_Frame:
+        {
+            frame.time += readVarint();
+            const uint64_t spans = readVarint();
+            size_t offset = 0;
+
+            for (uint64_t i = 0; ok && (i < spans); i++)
+            {
+                offset += readVarint();
+                const uint64_t len = readVarint();
+
+                if (!ok || (offset + len > frame.pixels.size()) || (p + len > trace.size()))
+                {
+                    return false;
+                }
+
+                std::copy(trace.begin() + p, trace.begin() + p + len, frame.pixels.begin() + offset);
+                offset += len;
+                p += len;
+            }
+
+            if (ok)
+            {
+                onFrame(frame);
+            }
+
+            break;
+        }
+
+        case TraceRecord_Size:
+            frame.pixels.assign(readVarint(), 0);
+            break;
+
+        case TraceRecord_Repeat:
+        {
+            const uint64_t dt = readVarint();
+            const uint64_t count = readVarint();
+
+            for (uint64_t i = 0; ok && (i < count); i++)
+            {
+                frame.time += dt;
+                onFrame(frame);
+            }
+
+            break;
+        }
+
+        default:
+            return false;
+        }
+    }
+
+    return ok;
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> &data)
+{
+    std::ifstream in(path, std::ios::binary);
+
+    if (!in)
+    {
+        return false;
+    }
+
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+    return true;
+}
+
+static bool writeFile(const std::string &path, const std::vector<uint8_t> &data)
+{
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+    return static_cast<bool>(out);
+}
+
+// Reports the first difference between the two traces, if any.
+static bool compareTraces(const std::vector<uint8_t> &expected, const std::vector<uint8_t> &actual)
+{
+    std::vector<Frame> expectedFrames;
+
+    if (!readTrace(expected, [&](const Frame &frame) { expectedFrames.push_back(frame); }))
+    {
+        fprintf(stderr, "The golden trace is malformed.\n");
+        return false;
+    }
+
+    size_t index = 0;
+    bool same = true;
+
+    readTrace(actual, [&](const Frame &frame)
+              {
+                  if (!same || (index >= expectedFrames.size()))
+                  {
+                      index++;
+                      return;
+                  }
+
+                  const Frame &golden = expectedFrames[index];
+
+                  if (frame.time != golden.time)
+                  {
+                      fprintf(stderr, "Frame %zu was shown at %u ms instead of %u ms.\n", index, frame.time, golden.time);
+                      same = false;
+                  }
+                  else if (frame.pixels.size() != golden.pixels.size())
+                  {
+                      fprintf(stderr, "Frame %zu, at %u ms, has %zu leds instead of %zu.\n", index, frame.time, frame.pixels.size() / 3, golden.pixels.size() / 3);
+                      same = false;
+                  }
+                  else
+                  {
+                      for (size_t i = 0; i + 2 < frame.pixels.size(); i += 3)
+                      {
+                          if (!std::equal(frame.pixels.begin() + i, frame.pixels.begin() + i + 3, golden.pixels.begin() + i))
+                          {
+                              fprintf(stderr, "Frame %zu, at %u ms: led %zu is #%02x%02x%02x instead of #%02x%02x%02x.\n", index, frame.time, i / 3,
+                                      frame.pixels[i], frame.pixels[i + 1], frame.pixels[i + 2], golden.pixels[i], golden.pixels[i + 1], golden.pixels[i + 2]);
+                              same = false;
+                              break;
+                          }
+                      }
+                  }
+
+                  index++;
+              });
+
+    if (same && (index != expectedFrames.size()))
+    {
+        fprintf(stderr, "%zu frames were shown instead of %zu.\n", index, expectedFrames.size());
+        same = false;
+    }
+
+    return same;
+}
+
+struct Event
+{
+    uint32_t time;
+    std::string action;
+    std::string uri;
+    std::string body;
+    int line;
+};
+
+static bool parseScenario(const std::string &path, uint32_t &seed, std::vector<Event> &events)
+{
+    std::ifstream in(path);
+
+    if (!in)
+    {
+        fprintf(stderr, "%s: cannot open the scenario.\n", path.c_str());
+        return false;
+    }
+
+    std::string text;
+    int lineNumber = 0;
+
+    while (std::getline(in, text))
+    {
+        lineNumber++;
+
+        std::istringstream line(text);
+        std::string first;
+
+        if (!(line >> first) || (first[0] == '#'))
+        {
+            continue;
+        }
+
+        if (first == "seed")
+        {
+            line >> seed;
+            continue;
+        }
+
+        Event event = {0, "", "", "", lineNumber};
+        char *end = nullptr;
+        event.time = strtoul(first.c_str(), &end, 10);
+        line >> event.action;
+
+        if ((*end != '\0') || (!events.empty() && (event.time < events.back().time)))
+        {
+            fprintf(stderr, "%s:%d: expected a time after the previous event's.\n", path.c_str(), lineNumber);
+            return false;
+        }
+
+        if ((event.action == "get") || (event.action == "put") || (event.action == "post") || (event.action == "delete"))
+        {
+            line >> event.uri;
+            std::getline(line >> std::ws, event.body);
+        }
+        else if ((event.action != "press") && (event.action != "release") && (event.action != "end"))
+        {
+            fprintf(stderr, "%s:%d: unknown action \"%s\".\n", path.c_str(), lineNumber, event.action.c_str());
+            return false;
+        }
+
+        events.push_back(event);
+    }
+
+    if (events.empty() || (events.back().action != "end"))
+    {
+        fprintf(stderr, "%s: the scenario must finish with \"end\".\n", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: replay [-v] [-o trace] [-g golden] scenario\n"
+                    "  -o  write the trace of the replay\n"
+                    "  -g  compare the replay with a golden trace\n"
+                    "  -v  show the serial output\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::string outputPath;
+    std::string goldenPath;
+    std::string scenarioPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+
+        if (((arg == "-o") || (arg == "-g")) && (i + 1 < argc))
+        {
+            ((arg == "-o") ? outputPath : goldenPath) = argv[++i];
+        }
+        else if (arg == "-v")
+        {
+            host::setSerialOutput(stderr);
+        }
+        else if (scenarioPath.empty() && (arg[0] != '-'))
+        {
+            scenarioPath = arg;
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (scenarioPath.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    uint32_t seed = 1337;
+    std::vector<Event> events;
+
+    if (!parseScenario(scenarioPath, seed, events))
+    {
+        return 2;
+    }
+
+    // A configured station, so that the controller doesn't start as an access point.
+    strncpy(config.ssid, "replay", sizeof(config.ssid) - 1);
+    config.Save();
+
+    random16_set_seed(seed);
+    host::seed(seed);
+
+    TraceWriter trace;
+    uint32_t start = 0;
+
+    host::setShowHandler([&](const uint8_t *pixels, size_t size)
+                         { trace.add(millis() - start, pixels, size); });
+
+    const auto began = std::chrono::steady_clock::now();
+
+    setup();
+    start = millis();
+
+    bool failed = false;
+    size_t next = 0;
+
+    while (!failed)
+    {
+        const uint64_t now = host::now();
+
+        while ((next < events.size()) && (start + events[next].time) * 1000ull <= now)
+        {
+            const Event &event = events[next++];
+
+            if (event.action == "end")
+            {
+                break;
+            }
+
+            if ((event.action == "press") || (event.action == "release"))
+            {
+                host::setPin(BUTTON_PIN, (event.action == "press") ? LOW : HIGH);
+                continue;
+            }
+
+            std::string method = event.action;
+            std::transform(method.begin(), method.end(), method.begin(), ::toupper);
+
+            host::httpRequest(method, event.uri, event.body, event.body.empty() ? "" : "application/json",
+                              [&, event](const host::HttpResponse &response)
+                              {
+                                  if ((response.code < 200) || (response.code >= 300))
+                                  {
+                                      fprintf(stderr, "%s:%d: %s %s answered %d: %s", scenarioPath.c_str(), event.line, event.action.c_str(), event.uri.c_str(),
+                                              response.code, response.body.c_str());
+                                      failed = true;
+                                  }
+                              });
+        }
+
+        if ((next == events.size()) && (events.back().action == "end"))
+        {
+            break;
+        }
+
+        loop();
+
+        if (host::restartRequested())
+        {
+            fprintf(stderr, "%s: the controller restarted at %lu ms.\n", scenarioPath.c_str(), millis() - start);
+            failed = true;
+        }
+
+        // The loop spins on the real hardware: a millisecond apart is as fine as the firmware's clock gets.
+        const uint64_t due = (next < events.size()) ? (start + events[next].time) * 1000ull : UINT64_MAX;
+        host::advanceTo(std::min({(host::now() / 1000 + 1) * 1000, due, host::nextTimerInterrupt()}));
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+    const std::vector<uint8_t> &data = trace.finish();
+
+    printf("%s: %zu frames over %lu ms in %.2f s (%.0f frames/s), %zu bytes of trace.\n", scenarioPath.c_str(), trace.frames,
+           millis() - start, elapsed, trace.frames / elapsed, data.size());
+    fflush(stdout);
+
+    if (failed)
+    {
+        return 1;
+    }
+
+    if (!outputPath.empty() && !writeFile(outputPath, data))
+    {
+        fprintf(stderr, "%s: cannot write the trace.\n", outputPath.c_str());
+        return 1;
+    }
+
+    if (!goldenPath.empty())
+    {
+        std::vector<uint8_t> golden;
+
+        if (!readFile(goldenPath, golden))
+        {
+            fprintf(stderr, "%s: cannot read the golden trace.\n", goldenPath.c_str());
+            return 1;
+        }
+
+        if (!compareTraces(golden, data))
+        {
+            fprintf(stderr, "%s: the replay differs from %s.\n", scenarioPath.c_str(), goldenPath.c_str());
+            return 1;
+        }
+    }
+
+    return 0;
+}
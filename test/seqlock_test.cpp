@@ -0,0 +1,130 @@
+// One writer publishes values whose words all hold the same counter, while
+// readers check that every copy they get is whole and that versions never go
+// backwards. Built with ThreadSanitizer by the Makefile.
+#include "seqlock.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Large enough for writes to get preempted even on a single core, and not a
+// multiple of a word.
+struct Value
+{
+    uint32_t counter;
+    uint32_t words[253];
+    uint8_t tail[3];
+};
+
+// The writer goes on until every reader copied that many values.
+static const uint64_t READS = 25000;
+static const size_t READERS = 4;
+
+static Value makeValue(uint32_t counter)
+{
+    Value value;
+    value.counter = counter;
+
+    for (uint32_t &word : value.words)
+    {
+        word = counter * 2654435761u;
+    }
+
+    for (uint8_t &byte : value.tail)
+    {
+        byte = static_cast<uint8_t>(counter);
+    }
+
+    return value;
+}
+
+static bool isWhole(const Value &value)
+{
+    const Value expected = makeValue(value.counter);
+
+    return memcmp(&value, &expected, sizeof(Value)) == 0;
+}
+
+int main()
+{
+    SeqLock<Value> lock;
+    lock.write(makeValue(0));
+
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> failures{0};
+    std::vector<std::thread> readers;
+    std::atomic<uint64_t> reads[READERS] = {};
+
+    for (size_t i = 0; i < READERS; i++)
+    {
+        readers.emplace_back([&, i]() {
+            uint32_t lastVersion = 0;
+            uint32_t lastCounter = 0;
+
+            while (!done.load(std::memory_order_relaxed))
+            {
+                Value value;
+                const uint32_t version = lock.read(value);
+
+                if (!isWhole(value))
+                {
+                    fprintf(stderr, "reader %zu: torn value at version %u\n", i, version);
+                    failures++;
+                }
+                else if ((version < lastVersion) || (value.counter < lastCounter))
+                {
+                    fprintf(stderr, "reader %zu: went back from %u to %u\n", i, lastCounter, value.counter);
+                    failures++;
+                }
+
+                lastVersion = version;
+                lastCounter = value.counter;
+                reads[i].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    uint32_t writes = 0;
+
+    for (;;)
+    {
+        bool enough = true;
+
+        for (const std::atomic<uint64_t> &count : reads)
+        {
+            enough = enough && (count.load(std::memory_order_relaxed) >= READS);
+        }
+
+        if (enough)
+        {
+            break;
+        }
+
+        lock.write(makeValue(++writes));
+    }
+
+    done = true;
+
+    for (std::thread &reader : readers)
+    {
+        reader.join();
+    }
+
+    if (lock.read().counter != writes)
+    {
+        fprintf(stderr, "last value is %u, expected %u\n", lock.read().counter, writes);
+        failures++;
+    }
+
+    uint64_t total = 0;
+
+    for (const std::atomic<uint64_t> &count : reads)
+    {
+        total += count;
+    }
+
+    printf("seqlock: %u writes, %llu reads, %u failures\n", writes, static_cast<unsigned long long>(total), failures.load());
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Record, fetch and compare ohm-led render journals.
+
+See ohm-led/journal.h for the record format.
+
+Examples:
+
+    ohm-led-journal.py ohm-led.local start --seed 42
+    ohm-led-journal.py ohm-led.local stop
+    ohm-led-journal.py ohm-led.local fetch fire.olj
+    ohm-led-journal.py - dump fire.olj
+    ohm-led-journal.py - compare golden/fire.olj fire.olj
+"""
+
+import argparse
+import json
+import struct
+import sys
+import urllib.request
+
+MAGIC = 0x314A4C4F
+
+HEADER = struct.Struct("<IIII")
+RECORD = struct.Struct("<IBBHII")
+
+TYPE_START = 1
+TYPE_FRAME = 2
+TYPE_BUTTON = 3
+TYPE_STATE = 4
+TYPE_STATE_TIMING = 5
+
+FLAG_RECORDING = 1 << 0
+FLAG_TRUNCATED = 1 << 1
+
+# Must match `StateMode` in ohm-led/state.h.
+MODES = [
+    "off",
+    "on",
+    "pulse",
+    "colorloop",
+    "rainbow",
+    "knight-rider",
+    "fire",
+    "plasma",
+    "fire-2d",
+    "diagonal-rainbow",
+    "comet",
+    "multi-ball",
+]
+
+
+def mode_name(mode):
+    return MODES[mode] if mode < len(MODES) else str(mode)
+
+
+def parse(data):
+    """Returns (flags, records), where each record is a (time, type, a, b, c, d) tuple."""
+    if len(data) < HEADER.size:
+        raise ValueError("journal is too short")
+
+    magic, count, flags, record_size = HEADER.unpack_from(data)
+
+    if magic != MAGIC or record_size != RECORD.size:
+        raise ValueError("not an ohm-led journal")
+
+    if len(data) < HEADER.size + count * RECORD.size:
+        raise ValueError("journal is truncated")
+
+    records = [RECORD.unpack_from(data, HEADER.size + i * RECORD.size) for i in range(count)]
+
+    return flags, records
+
+
+def describe(record):
+    time, record_type, a, b, c, d = record
+
+    if record_type == TYPE_START:
+        return f"{time:>10} start     seed {c}, {b} led(s) at {d} fps"
+    if record_type == TYPE_FRAME:
+        return f"{time:>10} frame     #{c} {mode_name(a)}, {b} led(s), checksum {d:08x}"
+    if record_type == TYPE_BUTTON:
+        return f"{time:>10} button    {'pressed' if a else 'released'}"
+    if record_type == TYPE_STATE:
+        hsv = f"{c & 0xFF:02x}{(c >> 8) & 0xFF:02x}{(c >> 16) & 0xFF:02x}"
+        return f"{time:>10} state     {mode_name(a)}, HSV {hsv}, easing {b}, cooling {d & 0xFF}, sparking {(d >> 8) & 0xFF}"
+    if record_type == TYPE_STATE_TIMING:
+        return f"{time:>10} timing    revision {b}, period {c}ms, transition {d}ms"
+
+    return f"{time:>10} unknown   type {record_type}"
+
+
+def load(path):
+    with open(path, "rb") as f:
+        return parse(f.read())
+
+
+def frames(records):
+    return {r[4]: r for r in records if r[1] == TYPE_FRAME}
+
+
+def inputs(records):
+    """The records that drive the renderer, without their timestamps."""
+    return [r[1:] for r in records if r[1] in (TYPE_START, TYPE_BUTTON, TYPE_STATE, TYPE_STATE_TIMING)]
+
+
+def compare(golden_path, actual_path):
+    _, golden = load(golden_path)
+    _, actual = load(actual_path)
+
+    if inputs(golden) != inputs(actual):
+        print("Inputs differ: the journals are not recordings of the same scenario.", file=sys.stderr)
+        return 2
+
+    golden_frames = frames(golden)
+    actual_frames = frames(actual)
+    common = sorted(set(golden_frames) & set(actual_frames))
+
+    for index in common:
+        if golden_frames[index][5] != actual_frames[index][5]:
+            print(f"First divergence at frame #{index}:")
+            print(f"  golden: {describe(golden_frames[index])}")
+            print(f"  actual: {describe(actual_frames[index])}")
+            return 1
+
+    print(f"{len(common)} frame(s) match.")
+
+    return 0
+
+
+def request(host, method, body=None):
+    data = json.dumps(body).encode() if body is not None else None
+    req = urllib.request.Request(f"http://{host}/v1/journal/", data=data, method=method)
+
+    if data is not None:
+        req.add_header("Content-Type", "application/json")
+
+    with urllib.request.urlopen(req, timeout=10) as response:
+        return response.read()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="the controller, or '-' for offline commands")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    start_parser = commands.add_parser("start", help="start a recording")
+    start_parser.add_argument("--seed", type=int, default=1337)
+    start_parser.add_argument("--frame-interval", type=int, default=1, help="record a checksum every N frames")
+
+    commands.add_parser("stop", help="stop the recording")
+
+    fetch_parser = commands.add_parser("fetch", help="download the journal")
+    fetch_parser.add_argument("output")
+
+    dump_parser = commands.add_parser("dump", help="print a journal file")
+    dump_parser.add_argument("journal")
+
+    compare_parser = commands.add_parser("compare", help="compare the frames of a journal against a golden one")
+    compare_parser.add_argument("golden")
+    compare_parser.add_argument("actual")
+
+    args = parser.parse_args()
+
+    if args.command == "start":
+        request(args.host, "POST", {"seed": args.seed, "frame-interval": args.frame_interval})
+    elif args.command == "stop":
+        request(args.host, "DELETE")
+    elif args.command == "fetch":
+        data = request(args.host, "GET")
+        flags, records = parse(data)
+
+        with open(args.output, "wb") as f:
+            f.write(data)
+
+        print(f"{len(records)} record(s){', still recording' if flags & FLAG_RECORDING else ''}"
+              f"{', truncated' if flags & FLAG_TRUNCATED else ''}.")
+    elif args.command == "dump":
+        flags, records = load(args.journal)
+
+        for record in records:
+            print(describe(record))
+
+        if flags & FLAG_TRUNCATED:
+            print("(journal was full, recording stopped early)")
+    else:
+        return compare(args.golden, args.actual)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
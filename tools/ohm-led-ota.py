@@ -0,0 +1,425 @@
+#!/usr/bin/env python3
+"""Build, check and push ohm-led firmware deltas.
+
+A delta rebuilds a new firmware image from the one running on the controller,
+so only what changed goes over the air. See ohm-led/ota.h for the format.
+
+Examples:
+
+    ohm-led-ota.py diff old.bin new.bin update.old
+    ohm-led-ota.py verify old.bin new.bin update.old
+    ohm-led-ota.py apply old.bin update.old rebuilt.bin
+    ohm-led-ota.py push --password secret ohm-led.local update.old
+
+The controller only accepts updates once an update password is configured.
+"""
+
+import argparse
+import base64
+import hashlib
+import json
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+import uuid
+
+MAGIC = b"OLD1"
+
+HEADER = struct.Struct("<4sI16sI16s")
+
+OP_COPY = 0
+OP_ADD = 1
+OP_INSERT = 2
+
+OP_MASK = 0x03
+# A seek follows the length.
+OP_SEEK = 0x04
+# Lengths up to this fit in the opcode byte.
+OP_MAX_INLINE_LENGTH = 31
+
+# Matches are looked up by blocks of this many bytes.
+BLOCK = 8
+
+# How many positions of the old image are kept per block, for repetitive data.
+MAX_CANDIDATES = 8
+
+# An aligned region keeps going through mismatches until it is this much worse than at its best.
+MISMATCH_SLACK = 16
+
+# Zero runs shorter than this stay inside an add operation rather than becoming a copy.
+MIN_COPY = 4
+
+
+def write_varint(out, value):
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+
+    while True:
+        if pos >= len(data):
+            raise ValueError("delta is truncated")
+
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+
+        if not byte & 0x80:
+            return value, pos
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def match_length(old, old_pos, new, new_pos):
+    """The length of the exact match between `old` at `old_pos` and `new` at `new_pos`."""
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    length = 0
+    step = 64
+
+    # Compare slices, which is much faster than bytes one by one.
+    while length < limit:
+        n = min(step, limit - length)
+
+        if old[old_pos + length:old_pos + length + n] == new[new_pos + length:new_pos + length + n]:
+            length += n
+            step *= 2
+        elif n == 1:
+            break
+        else:
+            step = max(1, n // 2)
+
+    return length
+
+
+def extend(old, new, old_pos, new_pos):
+    """The length worth encoding against `old_pos`, going through small mismatches."""
+    score = 0
+    best_score = 0
+    best_length = 0
+    length = 0
+
+    while new_pos + length < len(new) and old_pos + length < len(old):
+        exact = match_length(old, old_pos + length, new, new_pos + length)
+
+        if exact:
+            length += exact
+            score += exact
+        else:
+            length += 1
+            score -= 1
+
+        if score > best_score:
+            best_score = score
+            best_length = length
+        elif score < best_score - MISMATCH_SLACK:
+            break
+
+    return best_length
+
+
+def index(old):
+    blocks = {}
+
+    for pos in range(len(old) - BLOCK + 1):
+        candidates = blocks.setdefault(old[pos:pos + BLOCK], [])
+
+        if len(candidates) < MAX_CANDIDATES:
+            candidates.append(pos)
+
+    return blocks
+
+
+def segments(old, new):
+    """Split `new` into (new_pos, length, old_pos) regions, with `old_pos` None for literals."""
+    blocks = index(old)
+    pos = 0
+    literal = 0
+    # Keep the alignment of the last region as a candidate: code that moved by a few bytes keeps matching there.
+    offset = 0
+
+    while pos < len(new):
+        candidates = list(blocks.get(new[pos:pos + BLOCK], ()))
+
+        if 0 <= pos + offset < len(old):
+            candidates.append(pos + offset)
+
+        best_pos = None
+        best_length = 0
+
+        for candidate in candidates:
+            length = match_length(old, candidate, new, pos)
+
+            if length > best_length:
+                best_pos = candidate
+                best_length = length
+
+        if best_length < BLOCK:
+            pos += 1
+            continue
+
+        if literal < pos:
+            yield literal, pos - literal, None
+
+        length = extend(old, new, best_pos, pos)
+        yield pos, length, best_pos
+
+        offset = best_pos - pos
+        pos += length
+        literal = pos
+
+    if literal < len(new):
+        yield literal, len(new) - literal, None
+
+
+def diff(old, new):
+    out = bytearray(HEADER.pack(MAGIC, len(old), hashlib.md5(old).digest(), len(new), hashlib.md5(new).digest()))
+    cursor = 0
+
+    def emit(op, length, old_pos=None, payload=b""):
+        nonlocal cursor
+        seek = 0 if op == OP_INSERT else old_pos - cursor
+        inline = length if length <= OP_MAX_INLINE_LENGTH else 0
+        out.append(op | (OP_SEEK if seek else 0) | (inline << 3))
+
+        if not inline:
+            write_varint(out, length)
+
+        if seek:
+            write_varint(out, zigzag(seek))
+
+        if op != OP_INSERT:
+            cursor = old_pos + length
+
+        out.extend(payload)
+
+    for new_pos, length, old_pos in segments(old, new):
+        if old_pos is None:
+            emit(OP_INSERT, length, payload=new[new_pos:new_pos + length])
+            continue
+
+        delta = bytes((new[new_pos + i] - old[old_pos + i]) & 0xFF for i in range(length))
+        start = 0
+
+        # Unchanged bytes are copied, the rest is added to the old bytes.
+        while start < length:
+            end = start
+
+            while end < length and delta[end] == 0:
+                end += 1
+
+            if end - start >= MIN_COPY or end == length:
+                if end > start:
+                    emit(OP_COPY, end - start, old_pos + start)
+
+                start = end
+
+            # Take changed bytes up to the next run of zeros worth a copy.
+            end = start
+            zeros = 0
+
+            while end < length and zeros < MIN_COPY:
+                zeros = zeros + 1 if delta[end] == 0 else 0
+                end += 1
+
+            if zeros >= MIN_COPY:
+                end -= zeros
+
+            if end > start:
+                emit(OP_ADD, end - start, old_pos + start, delta[start:end])
+
+            start = end
+
+    return bytes(out)
+
+
+def parse_header(delta):
+    if len(delta) < HEADER.size:
+        raise ValueError("delta is too short")
+
+    magic, source_size, source_md5, target_size, target_md5 = HEADER.unpack_from(delta)
+
+    if magic != MAGIC:
+        raise ValueError("not an ohm-led firmware delta")
+
+    return source_size, source_md5, target_size, target_md5
+
+
+def apply(old, delta):
+    """Rebuilds the new image like the controller does, checking the same things."""
+    source_size, source_md5, target_size, target_md5 = parse_header(delta)
+
+    if len(old) != source_size or hashlib.md5(old).digest() != source_md5:
+        raise ValueError("the delta is not for this image")
+
+    out = bytearray()
+    pos = HEADER.size
+    cursor = 0
+
+    while pos < len(delta):
+        op = delta[pos] & OP_MASK
+        has_seek = delta[pos] & OP_SEEK
+        length = delta[pos] >> 3
+        pos += 1
+
+        if not length:
+            length, pos = read_varint(delta, pos)
+
+        if op == OP_INSERT:
+            if pos + length > len(delta):
+                raise ValueError("delta is truncated")
+
+            out.extend(delta[pos:pos + length])
+            pos += length
+            continue
+
+        if op not in (OP_COPY, OP_ADD):
+            raise ValueError(f"unknown operation {op}")
+
+        if has_seek:
+            seek, pos = read_varint(delta, pos)
+            cursor += unzigzag(seek)
+
+        if cursor < 0 or cursor + length > len(old):
+            raise ValueError("the delta reads outside of the image")
+
+        if op == OP_COPY:
+            out.extend(old[cursor:cursor + length])
+        else:
+            if pos + length > len(delta):
+                raise ValueError("delta is truncated")
+
+            out.extend((old[cursor + i] + delta[pos + i]) & 0xFF for i in range(length))
+            pos += length
+
+        cursor += length
+
+    if len(out) != target_size or hashlib.md5(out).digest() != target_md5:
+        raise ValueError("the rebuilt image doesn't match its checksum")
+
+    return bytes(out)
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def info(host):
+    with urllib.request.urlopen(f"http://{host}/v1/info/", timeout=10) as response:
+        return json.load(response)
+
+
+def push(host, delta, password):
+    _, source_md5, _, _ = parse_header(delta)
+    running = info(host).get("firmware", {}).get("md5")
+
+    if running != source_md5.hex():
+        print(f"The controller runs {running}, the delta is for {source_md5.hex()}.", file=sys.stderr)
+        return 1
+
+    boundary = uuid.uuid4().hex
+    body = (f"--{boundary}\r\n"
+            f'Content-Disposition: form-data; name="delta"; filename="update.old"\r\n'
+            f"Content-Type: application/octet-stream\r\n\r\n").encode() + delta + f"\r\n--{boundary}--\r\n".encode()
+
+    req = urllib.request.Request(f"http://{host}/v1/firmware/", data=body, method="POST")
+    req.add_header("Content-Type", f"multipart/form-data; boundary={boundary}")
+    req.add_header("Authorization", "Basic " + base64.b64encode(f"ohm-led:{password}".encode()).decode())
+
+    start = time.monotonic()
+
+    try:
+        with urllib.request.urlopen(req, timeout=120) as response:
+            result = json.load(response)
+    except urllib.error.HTTPError as e:
+        print(f"Update refused ({e.code}): {e.read().decode().strip()}", file=sys.stderr)
+        return 1
+
+    elapsed = time.monotonic() - start
+    print(f"Sent {len(delta)} byte(s) for {result['written']} in {elapsed:.1f}s, the controller restarts.")
+
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    diff_parser = commands.add_parser("diff", help="build a delta from the old image to the new one")
+    diff_parser.add_argument("old")
+    diff_parser.add_argument("new")
+    diff_parser.add_argument("output")
+
+    verify_parser = commands.add_parser("verify", help="check that a delta rebuilds the new image")
+    verify_parser.add_argument("old")
+    verify_parser.add_argument("new")
+    verify_parser.add_argument("delta")
+
+    apply_parser = commands.add_parser("apply", help="rebuild the new image from the old one")
+    apply_parser.add_argument("old")
+    apply_parser.add_argument("delta")
+    apply_parser.add_argument("output")
+
+    push_parser = commands.add_parser("push", help="send a delta to a controller")
+    push_parser.add_argument("--password", required=True, help="the update password of the controller")
+    push_parser.add_argument("host")
+    push_parser.add_argument("delta")
+
+    args = parser.parse_args()
+
+    if args.command == "diff":
+        old = read(args.old)
+        new = read(args.new)
+        delta = diff(old, new)
+
+        # Never ship a delta that doesn't rebuild the image exactly.
+        if apply(old, delta) != new:
+            print("The delta doesn't rebuild the new image.", file=sys.stderr)
+            return 1
+
+        with open(args.output, "wb") as f:
+            f.write(delta)
+
+        print(f"{len(delta)} byte(s) for {len(new)}, {100 * len(delta) / len(new):.1f}% of the full image.")
+    elif args.command == "verify":
+        try:
+            rebuilt = apply(read(args.old), read(args.delta))
+        except ValueError as e:
+            print(f"Invalid delta: {e}.", file=sys.stderr)
+            return 1
+
+        if rebuilt != read(args.new):
+            print("The delta rebuilds another image.", file=sys.stderr)
+            return 1
+
+        print("The delta rebuilds the new image.")
+    elif args.command == "apply":
+        with open(args.output, "wb") as f:
+            f.write(apply(read(args.old), read(args.delta)))
+    else:
+        return push(args.host, read(args.delta), args.password)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
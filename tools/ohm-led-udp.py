@@ -0,0 +1,384 @@
+#!/usr/bin/env python3
+"""Host-side client for the ohm-led binary UDP control protocol.
+
+See ohm-led/udp.h for the wire format.
+
+Examples:
+
+    ohm-led-udp.py ohm-led.local set --mode rainbow --period 2000
+    ohm-led-udp.py ohm-led.local recall 3
+    ohm-led-udp.py ohm-led.local bench --count 1000
+    ohm-led-udp.py ohm-led.local rate --duration 10 --window 8
+    ohm-led-udp.py ohm-led.local group --count 100
+
+`make -C test` checks the group replication without hardware, on loopback.
+"""
+
+import argparse
+import random
+import socket
+import statistics
+import struct
+import sys
+import time
+
+PROTOCOL_VERSION = 1
+
+TYPE_SET_STATE = 1
+TYPE_RECALL_PRESET = 2
+TYPE_ACK = 3
+TYPE_GROUP_SET_STATE = 4
+TYPE_GROUP_ACK = 5
+
+FLAG_ACK = 1 << 0
+
+FIELD_REVISION = 1 << 0
+FIELD_MODE = 1 << 1
+FIELD_HUE = 1 << 2
+FIELD_SATURATION = 1 << 3
+FIELD_VALUE = 1 << 4
+FIELD_EASING = 1 << 5
+FIELD_PERIOD = 1 << 6
+FIELD_FIRE_COOLING = 1 << 7
+FIELD_FIRE_SPARKING = 1 << 8
+FIELD_TRANSITION = 1 << 9
+
+# Must match ohm-led/udp.h.
+GROUP_ACK_WINDOW = 0.25
+
+# Must match `StateMode` in ohm-led/state.h.
+MODES = [
+    "off",
+    "on",
+    "pulse",
+    "colorloop",
+    "rainbow",
+    "knight-rider",
+    "fire",
+    "plasma",
+    "fire-2d",
+    "diagonal-rainbow",
+    "comet",
+    "multi-ball",
+]
+
+# Must match `Easing` in ohm-led/easing.h.
+EASINGS = [
+    "linear",
+    "in-sine", "out-sine", "in-out-sine",
+    "in-quad", "out-quad", "in-out-quad",
+    "in-cubic", "out-cubic", "in-out-cubic",
+    "in-quart", "out-quart", "in-out-quart",
+    "in-quint", "out-quint", "in-out-quint",
+    "in-expo", "out-expo", "in-out-expo",
+    "in-circ", "out-circ", "in-out-circ",
+    "in-back", "out-back", "in-out-back",
+    "in-elastic", "out-elastic", "in-out-elastic",
+    "in-bounce", "out-bounce", "in-out-bounce",
+]
+
+RESULTS = ["success", "invalid-input", "outdated-input"]
+
+HEADER = struct.Struct("<2sBBBBH")
+SET_STATE = struct.Struct("<HQBBBBBIBBI")
+ACK = struct.Struct("<BQ")
+GROUP_ACK = struct.Struct("<BQHHHH")
+
+
+def header(message_type, flags, sequence):
+    return HEADER.pack(b"OL", PROTOCOL_VERSION, message_type, flags, 0, sequence)
+
+
+def set_state_packet(sequence, ack=True, revision=None, mode=None, hue=None, saturation=None, value=None,
+                     easing=None, period=None, fire_cooling=None, fire_sparking=None, transition=None):
+    fields = 0
+
+    for flag, field in [
+        (FIELD_REVISION, revision),
+        (FIELD_MODE, mode),
+        (FIELD_HUE, hue),
+        (FIELD_SATURATION, saturation),
+        (FIELD_VALUE, value),
+        (FIELD_EASING, easing),
+        (FIELD_PERIOD, period),
+        (FIELD_FIRE_COOLING, fire_cooling),
+        (FIELD_FIRE_SPARKING, fire_sparking),
+        (FIELD_TRANSITION, transition),
+    ]:
+        if field is not None:
+            fields |= flag
+
+    payload = SET_STATE.pack(
+        fields,
+        revision or 0,
+        MODES.index(mode) if mode is not None else 0,
+        hue or 0,
+        saturation or 0,
+        value or 0,
+        EASINGS.index(easing) if easing is not None else 0,
+        period or 0,
+        fire_cooling or 0,
+        fire_sparking or 0,
+        transition or 0,
+    )
+
+    return header(TYPE_SET_STATE, FLAG_ACK if ack else 0, sequence) + payload
+
+
+def recall_preset_packet(sequence, preset, ack=True):
+    return header(TYPE_RECALL_PRESET, FLAG_ACK if ack else 0, sequence) + struct.pack("<B", preset)
+
+
+def parse(data, message_type, payload):
+    """Returns (sequence, flags, fields...) if `data` is a `message_type` message, or None."""
+    if len(data) < HEADER.size + payload.size:
+        return None
+
+    magic, version, actual_type, flags, _, sequence = HEADER.unpack_from(data)
+
+    if magic != b"OL" or version != PROTOCOL_VERSION or actual_type != message_type:
+        return None
+
+    return (sequence, flags) + payload.unpack_from(data, HEADER.size)
+
+
+def parse_ack(data):
+    ack = parse(data, TYPE_ACK, ACK)
+
+    return (ack[0],) + ack[2:] if ack else None
+
+
+def exchange(sock, address, packet, sequence, timeout):
+    """Send a packet and wait for its acknowledgement. Returns (result, revision, seconds) or None."""
+    sock.settimeout(timeout)
+    start = time.perf_counter()
+    sock.sendto(packet, address)
+
+    while True:
+        try:
+            data, _ = sock.recvfrom(64)
+        except socket.timeout:
+            return None
+
+        ack = parse_ack(data)
+
+        if ack and ack[0] == sequence:
+            return ack[1], ack[2], time.perf_counter() - start
+
+
+def print_ack(ack):
+    if ack is None:
+        print("No acknowledgement received.", file=sys.stderr)
+        return 1
+
+    result, revision, elapsed = ack
+    print(f"{RESULTS[result] if result < len(RESULTS) else result}, revision {revision}, in {elapsed * 1000:.2f}ms")
+
+    return 0 if result == 0 else 1
+
+
+def bench(sock, address, count, timeout):
+    latencies = []
+    lost = 0
+
+    for i in range(count):
+        sequence = i & 0xFFFF
+        packet = set_state_packet(sequence, hue=random.randrange(256))
+        ack = exchange(sock, address, packet, sequence, timeout)
+
+        if ack is None:
+            lost += 1
+        else:
+            latencies.append(ack[2] * 1000)
+
+    if not latencies:
+        print("No acknowledgement received.", file=sys.stderr)
+        return 1
+
+    latencies.sort()
+    print(f"{len(latencies)}/{count} acknowledged, {lost} lost")
+    print(f"min {latencies[0]:.2f}ms")
+    print(f"median {statistics.median(latencies):.2f}ms")
+    print(f"p95 {latencies[int(len(latencies) * 0.95) - 1]:.2f}ms")
+    print(f"max {latencies[-1]:.2f}ms")
+
+    return 0
+
+
+def rate(sock, address, duration, window, timeout):
+    """Stream hue updates for `duration` seconds, with up to `window` of them awaiting their acknowledgement.
+
+    The controller coalesces the updates it receives between two frames, so the
+    acknowledged revisions advance at most once per frame however fast we send.
+    """
+    sock.settimeout(timeout)
+    in_flight = {}
+    acked = 0
+    lost = 0
+    revisions = set()
+    sequence = 0
+    start = time.perf_counter()
+    deadline = start + duration
+
+    while time.perf_counter() < deadline or in_flight:
+        while len(in_flight) < window and time.perf_counter() < deadline:
+            sequence = (sequence + 1) & 0xFFFF
+            sock.sendto(set_state_packet(sequence, hue=sequence & 0xFF), address)
+            in_flight[sequence] = time.perf_counter()
+
+        try:
+            data, _ = sock.recvfrom(64)
+        except socket.timeout:
+            # Whatever is still in flight is lost.
+            lost += len(in_flight)
+            in_flight.clear()
+            continue
+
+        ack = parse_ack(data)
+
+        if ack and in_flight.pop(ack[0], None) is not None:
+            acked += 1
+            revisions.add(ack[2])
+
+    elapsed = time.perf_counter() - start
+
+    print(f"{acked} update(s) acknowledged in {elapsed:.2f}s, {lost} lost")
+    print(f"{acked / elapsed:.1f} updates/s")
+    print(f"{len(revisions) / elapsed:.1f} revisions/s")
+
+    return 0 if acked else 1
+
+
+def percentiles(name, values):
+    values = sorted(values)
+    print(f"{name}: min {values[0]:.2f}ms, median {statistics.median(values):.2f}ms, "
+          f"p95 {values[max(0, int(len(values) * 0.95) - 1)]:.2f}ms, max {values[-1]:.2f}ms")
+
+
+def group(sock, address, count, timeout):
+    """Write to one member, and let it report how the rest of the group followed."""
+    round_trips = []
+    latencies = []
+    members = []
+    failed = 0
+    conflicts = 0
+    lost = 0
+
+    for i in range(count):
+        sequence = i & 0xFFFF
+        sock.settimeout(timeout + GROUP_ACK_WINDOW)
+        start = time.perf_counter()
+        sock.sendto(set_state_packet(sequence, hue=random.randrange(256)), address)
+        report = None
+
+        while report is None:
+            try:
+                data, _ = sock.recvfrom(64)
+            except socket.timeout:
+                break
+
+            ack = parse_ack(data)
+
+            if ack and ack[0] == sequence:
+                round_trips.append((time.perf_counter() - start) * 1000)
+
+            report = parse(data, TYPE_GROUP_ACK, GROUP_ACK)
+
+            if report and report[0] != sequence:
+                report = None
+
+        if report is None:
+            lost += 1
+            continue
+
+        _, _, _, _, acked, rejected, latency, outdated = report
+        members.append(acked)
+        failed += rejected
+        conflicts += outdated
+        latencies.append(latency)
+
+    if not members:
+        print("No group acknowledgement received: is the controller in a group?", file=sys.stderr)
+        return 1
+
+    print(f"{len(members)}/{count} write(s) reported, {lost} lost")
+    print(f"members applying each write: min {min(members)}, max {max(members)}, {failed} rejection(s), {conflicts} as outdated")
+    percentiles("write to the receiving member", round_trips)
+    percentiles("slowest member", latencies)
+
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=4210)
+    parser.add_argument("--timeout", type=float, default=0.5, help="seconds to wait for an acknowledgement")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    set_parser = commands.add_parser("set", help="change the state")
+    set_parser.add_argument("--revision", type=int)
+    set_parser.add_argument("--mode", choices=MODES)
+    set_parser.add_argument("--hue", type=int)
+    set_parser.add_argument("--saturation", type=int)
+    set_parser.add_argument("--value", type=int)
+    set_parser.add_argument("--easing", choices=EASINGS)
+    set_parser.add_argument("--period", type=int)
+    set_parser.add_argument("--fire-cooling", type=int)
+    set_parser.add_argument("--fire-sparking", type=int)
+    set_parser.add_argument("--transition", type=int)
+    set_parser.add_argument("--no-ack", action="store_true")
+
+    recall_parser = commands.add_parser("recall", help="recall a preset")
+    recall_parser.add_argument("preset", type=int)
+    recall_parser.add_argument("--no-ack", action="store_true")
+
+    bench_parser = commands.add_parser("bench", help="measure the acknowledged control latency")
+    bench_parser.add_argument("--count", type=int, default=500)
+
+    rate_parser = commands.add_parser("rate", help="measure the sustained acknowledged update rate")
+    rate_parser.add_argument("--duration", type=float, default=10)
+    rate_parser.add_argument("--window", type=int, default=8, help="updates awaiting acknowledgement at once")
+
+    group_parser = commands.add_parser("group", help="measure how fast a group follows a write")
+    group_parser.add_argument("--count", type=int, default=100)
+
+    args = parser.parse_args()
+
+    address = (socket.gethostbyname(args.host), args.port)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sequence = random.randrange(0x10000)
+
+    if args.command == "set":
+        packet = set_state_packet(
+            sequence,
+            ack=not args.no_ack,
+            revision=args.revision,
+            mode=args.mode,
+            hue=args.hue,
+            saturation=args.saturation,
+            value=args.value,
+            easing=args.easing,
+            period=args.period,
+            fire_cooling=args.fire_cooling,
+            fire_sparking=args.fire_sparking,
+            transition=args.transition,
+        )
+    elif args.command == "recall":
+        packet = recall_preset_packet(sequence, args.preset, ack=not args.no_ack)
+    elif args.command == "rate":
+        return rate(sock, address, args.duration, args.window, args.timeout)
+    elif args.command == "group":
+        return group(sock, address, args.count, args.timeout)
+    else:
+        return bench(sock, address, args.count, args.timeout)
+
+    if args.no_ack:
+        sock.sendto(packet, address)
+        return 0
+
+    return print_ack(exchange(sock, address, packet, sequence, args.timeout))
+
+
+if __name__ == "__main__":
+    sys.exit(main())